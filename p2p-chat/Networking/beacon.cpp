@@ -0,0 +1,55 @@
+#include "beacon.h"
+
+#include <QtEndian>
+#include <cstring>
+
+namespace p2pnetworking {
+
+static const char Magic[4] = {'P', '2', 'P', 'B'};
+
+QByteArray Beacon::encode() const {
+  // never split a multi-byte character, continuation bytes are 10xxxxxx
+  int nameSize = qMin(name.size(), MaxNameSize);
+  while (nameSize < name.size() && nameSize > 0 && (uchar(name.at(nameSize)) & 0xc0) == 0x80)
+    --nameSize;
+
+  QByteArray datagram(HeaderSize + nameSize, Qt::Uninitialized);
+  uchar *out = reinterpret_cast<uchar *>(datagram.data());
+  std::memcpy(out, Magic, sizeof(Magic));
+  out[4] = version;
+  out[5] = flags;
+  qToBigEndian(port, out + 6);
+  std::memcpy(out + 8, peerId.toRfc4122().constData(), 16);
+  qToBigEndian(state, out + 24);
+  qToBigEndian(ipv4, out + AddressOffset);
+  out[32] = 0; // reserved
+  out[33] = 0;
+  out[34] = 0;
+  out[35] = uchar(nameSize);
+  std::memcpy(out + HeaderSize, name.constData(), size_t(nameSize));
+  return datagram;
+}
+
+bool Beacon::decode(const QByteArray &datagram, Beacon *beacon) {
+  if (datagram.size() < HeaderSize || std::memcmp(datagram.constData(), Magic, sizeof(Magic)) != 0)
+    return false;
+  const uchar *in = reinterpret_cast<const uchar *>(datagram.constData());
+  const int nameSize = in[35];
+  if (in[4] < 1 || datagram.size() < HeaderSize + nameSize)
+    return false;
+
+  beacon->version = in[4];
+  beacon->flags = in[5];
+  beacon->port = qFromBigEndian<quint16>(in + 6);
+  beacon->peerId = QUuid::fromRfc4122(QByteArray::fromRawData(datagram.constData() + 8, 16));
+  beacon->state = qFromBigEndian<quint32>(in + 24);
+  beacon->ipv4 = qFromBigEndian<quint32>(in + AddressOffset);
+  beacon->name = datagram.mid(HeaderSize, nameSize);
+  return true;
+}
+
+void Beacon::setAddress(QByteArray *datagram, quint32 ipv4) {
+  qToBigEndian(ipv4, reinterpret_cast<uchar *>(datagram->data()) + AddressOffset);
+}
+
+} // namespace p2pnetworking
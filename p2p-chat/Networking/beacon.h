@@ -0,0 +1,58 @@
+#ifndef BEACON_H
+#define BEACON_H
+
+#include <QByteArray>
+#include <QUuid>
+
+namespace p2pnetworking {
+
+/**
+ * @brief The Beacon struct a discovery announcement. On the wire it is a fixed 36 byte header
+ * followed by the UTF-8 user name, all integers big endian:
+ *
+ *   magic "P2PB" | version (1) | flags (1) | port (2) | peer id (16) | state (4) | ipv4 (4) |
+ *   reserved (3) | name length (1) | name
+ *
+ * A newer version may only append fields, so a reader accepts any version from 1 up and ignores
+ * whatever follows the name. Anything that is not a beacon, such as the old "name|port|ip" text
+ * announcements, fails to decode and is left to the caller.
+ */
+struct Beacon {
+  /** the format written by encode() */
+  static const quint8 Version = 1;
+  /** the size of the header before the name */
+  static const int HeaderSize = 36;
+  /** longer names are cut, at a character boundary */
+  static const int MaxNameSize = 255;
+  /** where encode() puts the address, so it can be patched for each interface */
+  static const int AddressOffset = 28;
+
+  quint8 version = Version;
+  quint8 flags = 0;  /**< none are defined yet, must be 0 */
+  quint16 port = 0;  /**< the sender's chat server port */
+  QUuid peerId;      /**< identifies the sender whatever its name and addresses */
+  quint32 state = 0; /**< bumped by the sender whenever anything else in the beacon changes */
+  quint32 ipv4 = 0;  /**< the address of the interface the beacon was sent from */
+  QByteArray name;
+
+  QByteArray encode() const;
+
+  /**
+   * @brief decode parse a datagram.
+   * @param datagram the received bytes.
+   * @param beacon filled in on success.
+   * @return false if the datagram is not a beacon.
+   */
+  static bool decode(const QByteArray &datagram, Beacon *beacon);
+
+  /**
+   * @brief setAddress overwrite the address of an encoded beacon.
+   * @param datagram the output of encode().
+   * @param ipv4 the new address.
+   */
+  static void setAddress(QByteArray *datagram, quint32 ipv4);
+};
+
+} // namespace p2pnetworking
+
+#endif
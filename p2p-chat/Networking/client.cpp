@@ -51,123 +51,638 @@
 #include <QtNetwork>
 
 #include "client.h"
+#include "compression.h"
 #include "connection.h"
+#include "filetransfer.h"
+#include "filetransfermessage.h"
 #include "message.h"
 #include "peermanager.h"
+#include <limits>
 
 namespace p2pnetworking {
 
-Client::Client() {
+// Decoding is spread over at most this many connection threads; past a few the network thread,
+// which fans every message out, becomes the limit instead.
+static const int MaxConnectionThreads = 4;
+// A second path to a peer is compared with the first once both had time for a couple of pings.
+static const int PathSettleDelay = 12 * 1000;
+// The peer may close the connection it replaces with a crossed duplicate, see prefers(), before the
+// duplicate is ready here; the participant only leaves if no connection took over by then.
+static const int ReplaceGrace = 2 * 1000;
+// In the relay overlay a node dials this many peers, and accepts connections up to the maximum, so
+// a message costs its sender the same upload however large the room.
+static const int OverlayDegree = 8;
+static const int OverlayMaxDegree = 24;
+
+Client::Client()
+    : peerManager(nullptr), fileTransfers(nullptr), server(nullptr), overlay(false),
+      presenceTimer(nullptr), multicast(nullptr), multicastEnabled(false), nextConnectionThread(0) {
+  qRegisterMetaType<QSharedPointer<Message>>();
+
+  const int threadCount = qBound(1, QThread::idealThreadCount() - 1, MaxConnectionThreads);
+  for (int i = 0; i < threadCount; ++i) {
+    QThread *thread = new QThread;
+    thread->setObjectName(QStringLiteral("p2p-connections-%1").arg(i));
+    QObject *context = new QObject;
+    context->moveToThread(thread);
+    thread->start();
+    connectionThreads << thread;
+    connectionContexts << context;
+  }
+
+  networkThread = new QThread;
+  networkThread->setObjectName(QStringLiteral("p2p-network"));
+  moveToThread(networkThread);
+  networkThread->start();
+  // the server and peer manager are created on the network thread so they never change threads
+  QMetaObject::invokeMethod(this, "initialize", Qt::QueuedConnection);
+}
+
+Client::~Client() {
+  if (networkThread->isRunning()) {
+    QMetaObject::invokeMethod(this, "shutdown", Qt::BlockingQueuedConnection);
+    networkThread->quit();
+    networkThread->wait();
+  }
+  delete networkThread;
+
+  foreach (QThread *thread, connectionThreads) {
+    thread->quit();
+    thread->wait();
+  }
+  qDeleteAll(connectionContexts);
+  qDeleteAll(connectionThreads);
+}
+
+void Client::initialize() {
+  server = new Server(this);
   peerManager = new PeerManager(this);
-  peerManager->setServerPort(server.serverPort());
+  peerManager->setServerPort(server->serverPort());
+  fileTransfers = new FileTransferManager(this);
+  multicast = new MulticastTransport(peerManager->peerId(), this);
+  presenceClock.start();
+  presenceTimer = new QTimer(this);
+  presenceTimer->setInterval(Relay::PresenceInterval);
+  presenceTimer->start();
+
+  QObject::connect(fileTransfers, &FileTransferManager::fileReceived, this, &Client::newMessage);
+  QObject::connect(server, &Server::incomingSocket, this, &Client::incomingSocket);
+  QObject::connect(presenceTimer, &QTimer::timeout, this, &Client::announcePresence);
+  QObject::connect(multicast, &MulticastTransport::messageReceived, this, &Client::newMessage);
+  QObject::connect(multicast, &MulticastTransport::frameForPeer, this,
+                   [this](const QUuid &peer, const QByteArray &frame) {
+                     if (PeerConnection *connection = connections.value(participants.value(peer)))
+                       connection->sendFrame(frame, OutboundQueue::ControlLane);
+                   });
+}
+
+void Client::shutdown() {
+  stop();
+
+  {
+    QMutexLocker locker(&connectionsMutex);
+    connections.clear();
+  }
+  participants.clear();
+  standbyPaths.clear();
+  leaving.clear();
+  relayedParticipants.clear();
+  // Close every connection on its own thread while this one waits, so no connection is left to
+  // signal us, then drop the signals that were already queued by connections that are now gone.
+  foreach (QObject *context, connectionContexts) {
+    QMetaObject::invokeMethod(context, [context]() {
+      const QObjectList connections = context->children();
+      qDeleteAll(connections);
+    }, Qt::BlockingQueuedConnection);
+  }
+  QCoreApplication::removePostedEvents(nullptr, QEvent::MetaCall);
+
+  delete presenceTimer;
+  presenceTimer = nullptr;
+  delete multicast;
+  multicast = nullptr;
+  delete fileTransfers;
+  fileTransfers = nullptr;
+  delete peerManager;
+  peerManager = nullptr;
+  delete server;
+  server = nullptr;
+}
 
-  QObject::connect(peerManager, SIGNAL(newConnection(PeerConnection *)), this,
-                   SLOT(newConnection(PeerConnection *)));
-  QObject::connect(&server, SIGNAL(newConnection(PeerConnection *)), this,
-                   SLOT(newConnection(PeerConnection *)));
+bool Client::isNetworkThread() const {
+  return QThread::currentThread() == thread();
 }
 
 QString Client::nickName() const {
-  return QString::fromUtf8(peerManager->userName()) + '@' + QHostInfo::localHostName();
+  QMutexLocker locker(&nameMutex);
+  return userName + '@' + QHostInfo::localHostName();
 }
 
 bool Client::hasConnection(quint32 peer, const QString &nickName) const {
-  QList<PeerConnection *> conns = peers.values(peer);
-  if (conns.empty()) {
-    return false;
-  }
-  foreach (PeerConnection *con, conns) {
-    if (con->name() == nickName) {
-      return true;
+  PeerConnection *connection = connections.value(nickName);
+  return connection && connection->address().toIPv4Address() == peer;
+}
+
+bool Client::hasPeer(const QUuid &id) const {
+  return !id.isNull() && participants.contains(id);
+}
+
+int Client::dialBudget() const {
+  if (!overlay)
+    return std::numeric_limits<int>::max();
+  return qMax(0, OverlayDegree - connections.size());
+}
+
+QString Client::participantOf(const PeerConnection *connection) const {
+  const QUuid id = connection->peerId();
+  return id.isNull() ? connection->name() : participants.value(id, connection->name());
+}
+
+QList<PeerConnection *> Client::connectionsFor(const QStringList &nicks) const {
+  QList<PeerConnection *> targets;
+  QSet<QString> seen;
+  foreach (const QString &nick, nicks) {
+    PeerConnection *connection = connections.value(nick);
+    if (connection && !seen.contains(nick)) {
+      seen.insert(nick);
+      targets << connection;
     }
   }
-  return false;
+  return targets;
 }
 
 void Client::setUserName(const QString &name) {
+  {
+    QMutexLocker locker(&nameMutex);
+    userName = name;
+  }
+  if (!isNetworkThread()) {
+    QMetaObject::invokeMethod(this, [this, name]() { setUserName(name); }, Qt::QueuedConnection);
+    return;
+  }
   peerManager->setUserName(name.toUtf8());
 }
 
 void Client::start() {
-  server.start();
-  peerManager->setServerPort(server.serverPort());
+  if (!isNetworkThread()) {
+    QMetaObject::invokeMethod(this, "start", Qt::QueuedConnection);
+    return;
+  }
+  server->start(peerManager->preferredServerPort());
+  peerManager->setServerPort(server->serverPort());
   peerManager->start();
+  if (multicastEnabled && !multicast->start(multicastGroup))
+    qWarning() << "cannot join the multicast group for text, sending it over TCP";
 }
 
 void Client::stop() {
-  server.stop();
+  if (!isNetworkThread()) {
+    QMetaObject::invokeMethod(this, "stop", Qt::QueuedConnection);
+    return;
+  }
+  server->stop();
   peerManager->stop();
+  multicast->stop();
+}
+
+void Client::setDiscovery(DiscoveryMode mode, const QHostAddress &group) {
+  if (!isNetworkThread()) {
+    QMetaObject::invokeMethod(this, [this, mode, group]() { setDiscovery(mode, group); },
+                              Qt::QueuedConnection);
+    return;
+  }
+  peerManager->setDiscovery(mode, group);
+}
+
+void Client::setRendezvousUrl(const QUrl &url) {
+  if (!isNetworkThread()) {
+    QMetaObject::invokeMethod(this, [this, url]() { setRendezvousUrl(url); }, Qt::QueuedConnection);
+    return;
+  }
+  peerManager->setRendezvousUrl(url);
+}
+
+void Client::setRelayOverlay(bool enabled) {
+  if (!isNetworkThread()) {
+    QMetaObject::invokeMethod(this, [this, enabled]() { setRelayOverlay(enabled); },
+                              Qt::QueuedConnection);
+    return;
+  }
+  overlay = enabled;
+}
+
+void Client::setMulticastText(bool enabled, const QHostAddress &group) {
+  if (!isNetworkThread()) {
+    QMetaObject::invokeMethod(this, [this, enabled, group]() { setMulticastText(enabled, group); },
+                              Qt::QueuedConnection);
+    return;
+  }
+  multicastEnabled = enabled;
+  multicastGroup = group;
 }
 
 void Client::sendMessage(QSharedPointer<Message> message) {
-  if (message.isNull() || message->isEmpty())
+  if (!isNetworkThread()) {
+    QMetaObject::invokeMethod(this, [this, message]() { sendMessage(message); },
+                              Qt::QueuedConnection);
+    return;
+  }
+  if (message.isNull() || message->isEmpty() || connections.isEmpty())
     return;
 
-  QList<PeerConnection *> connections = peers.values();
+  // Serialize (and compress) once; every connection writes the same implicitly shared frame.
+  MessageFrames frames(*message);
+  // Peers from before avatar hashes get the inline form, and so do relayed copies, which may reach
+  // such peers further along.
+  const QSharedPointer<Message> inlined = message->inlineForm();
+  QScopedPointer<MessageFrames> inlineFrames(inlined ? new MessageFrames(*inlined) : nullptr);
+  MessageFrames &legacy = inlineFrames ? *inlineFrames : frames;
+  QByteArray relay; // built for the first overlay neighbour, forwarded by every node once
+  qint64 bytes = 0;
+  // public text goes to the group once, and over TCP only to the peers that do not hear it there
+  static const QByteArray textPrefix = QByteArray::number(Message::TextMessage) + Message::Separator;
+  bool multicastSent = false;
+  if (!overlay && multicast->isRunning() && frames.content().startsWith(textPrefix)) {
+    const qint64 written = multicast->send(frames.content());
+    multicastSent = written >= 0;
+    bytes += qMax<qint64>(0, written);
+  }
   foreach (PeerConnection *connection, connections) {
-    connection->sendMessage(message);
+    if (multicastSent && multicast->covers(connection->peerId()))
+      continue;
+    QByteArray frame;
+    if (connection->acceptsRelay()) {
+      if (relay.isNull()) {
+        const QByteArray id = Relay::newId();
+        Relay::firstSighting(id);
+        relay = Relay::frame(id, QByteArray(), legacy.frameFor(true));
+      }
+      frame = relay;
+    } else {
+      MessageFrames &direct = connection->acceptsAvatarHashes() ? frames : legacy;
+      frame = direct.frameFor(connection->acceptsCompression());
+    }
+    connection->sendFrame(frame, frames.lane());
+    bytes += frame.size();
   }
+  Relay::recordOriginated(bytes);
 }
 
 void Client::sendMessage(QSharedPointer<Message> message, QString nick) {
-  if (message.isNull() || message->isEmpty())
+  sendMessage(message, QStringList(nick));
+}
+
+void Client::sendMessage(QSharedPointer<Message> message, const QStringList &nicks) {
+  if (!isNetworkThread()) {
+    QMetaObject::invokeMethod(this, [this, message, nicks]() { sendMessage(message, nicks); },
+                              Qt::QueuedConnection);
+    return;
+  }
+  if (message.isNull() || message->isEmpty() || nicks.isEmpty())
     return;
 
-  QList<PeerConnection *> connections = peers.values();
-  foreach (PeerConnection *connection, connections) {
-    if (connection->name() == nick) {
-      connection->sendMessage(message);
-    }
+  // nothing is serialized unless at least one recipient is connected
+  MessageFrames frames(*message);
+  const QSharedPointer<Message> inlined = message->inlineForm();
+  QScopedPointer<MessageFrames> inlineFrames(inlined ? new MessageFrames(*inlined) : nullptr);
+  foreach (PeerConnection *connection, connectionsFor(nicks)) {
+    connection->sendFrames(connection->acceptsAvatarHashes() || !inlineFrames ? frames : *inlineFrames);
+  }
+}
+
+void Client::sendFile(QSharedPointer<FileMessage> file) {
+  if (!isNetworkThread()) {
+    QMetaObject::invokeMethod(this, [this, file]() { sendFile(file); }, Qt::QueuedConnection);
+    return;
   }
+  fileTransfers->startTransfer(file, nickName(), connections.values());
 }
 
-void Client::newConnection(PeerConnection *connection) {
-  connection->setGreetingMessage(peerManager->userName());
+void Client::sendFile(QSharedPointer<FileMessage> file, const QStringList &nicks) {
+  if (!isNetworkThread()) {
+    QMetaObject::invokeMethod(this, [this, file, nicks]() { sendFile(file, nicks); },
+                              Qt::QueuedConnection);
+    return;
+  }
+  fileTransfers->startTransfer(file, nickName(), connectionsFor(nicks));
+}
+
+void Client::connectToPeer(const QHostAddress &address, quint16 port) {
+  spawnConnection([address, port](PeerConnection *connection) {
+    connection->dial(address, port);
+  });
+}
 
-  connect(connection, SIGNAL(error(QAbstractSocket::SocketError)), this,
-          SLOT(connectionError(QAbstractSocket::SocketError)));
-  connect(connection, SIGNAL(disconnected()), this, SLOT(disconnected()));
-  connect(connection, SIGNAL(readyForUse()), this, SLOT(readyForUse()));
+void Client::incomingSocket(qintptr socketDescriptor) {
+  spawnConnection([socketDescriptor](PeerConnection *connection) {
+    if (!connection->setSocketDescriptor(socketDescriptor))
+      delete connection;
+  });
+}
+
+void Client::spawnConnection(const std::function<void(PeerConnection *)> &start) {
+  QObject *context = connectionContexts.at(nextConnectionThread);
+  nextConnectionThread = (nextConnectionThread + 1) % connectionContexts.size();
+
+  const QString greeting = QString::fromUtf8(peerManager->userName());
+  const QUuid id = peerManager->peerId();
+  const bool relay = overlay;
+  const bool multicastText = multicastEnabled;
+  QMetaObject::invokeMethod(context, [this, context, greeting, id, relay, multicastText, start]() {
+    // Created on its connection thread, and wired up before any data can arrive. Every signal
+    // reaches the client through a queued connection, in the order it was emitted, and closed()
+    // is always the last one, so the client only deletes a connection once it has handled it.
+    PeerConnection *connection = new PeerConnection(context);
+    connection->setGreetingMessage(greeting);
+    connection->setLocalId(id);
+    connection->setRelayEnabled(relay);
+    connection->setMulticastEnabled(multicastText);
+    connect(connection, SIGNAL(closed()), this, SLOT(connectionClosed()));
+    connect(connection, SIGNAL(readyForUse()), this, SLOT(readyForUse()));
+    connect(connection, &PeerConnection::newMessage, this, &Client::connectionMessage);
+    connect(connection, &PeerConnection::relayedMessage, this, &Client::relayedMessage);
+    connect(connection, &PeerConnection::relayedPresence, this, &Client::relayedPresence);
+    connect(connection, &PeerConnection::multicastFrame, this, &Client::multicastFrame);
+    start(connection);
+  }, Qt::QueuedConnection);
 }
 
 void Client::readyForUse() {
   PeerConnection *connection = qobject_cast<PeerConnection *>(sender());
-  if (!connection || hasConnection(connection->peerAddress().toIPv4Address(), connection->name())) {
-    connection->deleteLater();
+  if (!connection)
+    return;
+  // the socket belongs to its connection thread, closed() brings it back here for deletion
+  auto abort = [](PeerConnection *rejected) {
+    QMetaObject::invokeMethod(rejected, [rejected]() { rejected->abort(); }, Qt::QueuedConnection);
+  };
+  const QUuid id = connection->peerId();
+  if (id == peerManager->peerId()) {
+    abort(connection); // we dialled ourselves
+    return;
+  }
+  if (leaving.remove(id)) {
+    // the connection it replaces closed first, the participant stays as it is
+    QMutexLocker locker(&connectionsMutex);
+    connections.insert(participants.value(id), connection);
     return;
   }
 
-  connect(connection, &PeerConnection::newMessage, this, &Client::newMessage);
+  PeerConnection *existing = nullptr;
+  if (hasPeer(id))
+    existing = connections.value(participants.value(id));
+  else if (hasConnection(connection->address().toIPv4Address(), connection->name()))
+    existing = connections.value(connection->name());
+  if (existing) {
+    if (existing->address() != connection->address()) {
+      // another path to the same peer, e.g. over a second interface
+      standbyPaths.insert(id, connection);
+      if (peerManager->peerId() < id)
+        QTimer::singleShot(PathSettleDelay, this, [this, id]() { choosePath(id); });
+      return;
+    }
+    if (!prefers(connection, existing)) {
+      abort(connection);
+      return;
+    }
+    // the participant stays, only its connection changes: once out of the table the replaced
+    // connection closes without a participantLeft
+    {
+      QMutexLocker locker(&connectionsMutex);
+      connections.insert(participantOf(existing), connection);
+    }
+    abort(existing);
+    return;
+  }
 
-  peers.insert(connection->peerAddress().toIPv4Address(), connection);
+  if (overlay && connections.size() >= OverlayMaxDegree) {
+    abort(connection); // it finds other neighbours, the overlay stays bounded
+    return;
+  }
+  {
+    QMutexLocker locker(&connectionsMutex);
+    connections.insert(connection->name(), connection);
+  }
+  if (!id.isNull()) {
+    participants.insert(id, connection->name());
+    if (connection->acceptsMulticast())
+      multicast->peerJoined(id, connection->name());
+  }
+  // a new neighbour spreads the news of this node at once, instead of at the next announcement
+  if (connection->acceptsRelay())
+    connection->sendFrame(Relay::presenceFrame(), OutboundQueue::InteractiveLane);
   QString nick = connection->name();
-  if (!nick.isEmpty())
+  // a participant heard of through the overlay is already listed
+  if (!nick.isEmpty() && !relayedParticipants.remove(nick))
     emit newParticipant(nick);
 }
 
-void Client::disconnected() {
-  if (PeerConnection *connection = qobject_cast<PeerConnection *>(sender()))
-    removeConnection(connection);
+void Client::choosePath(const QUuid &id) {
+  const QString nick = participants.value(id);
+  PeerConnection *current = connections.value(nick);
+  QList<PeerConnection *> paths = standbyPaths.values(id);
+  if (!current || paths.isEmpty())
+    return;
+
+  // paths without a round trip sample yet rank last
+  auto cost = [](const PeerConnection *path) {
+    const RttStats stats = path->rttStats();
+    return stats.count() ? stats.mean() : std::numeric_limits<qint64>::max();
+  };
+  PeerConnection *best = current;
+  foreach (PeerConnection *path, paths) {
+    if (cost(path) < cost(best))
+      best = path;
+  }
+  if (best != current) {
+    standbyPaths.remove(id, best);
+    standbyPaths.insert(id, current);
+    QMutexLocker locker(&connectionsMutex);
+    connections.insert(nick, best);
+  }
+  // the others leave standbyPaths when they close
+  foreach (PeerConnection *path, standbyPaths.values(id)) {
+    QMetaObject::invokeMethod(path, [path]() { path->abort(); }, Qt::QueuedConnection);
+  }
+}
+
+bool Client::prefers(const PeerConnection *candidate, const PeerConnection *existing) const {
+  const QUuid remote = candidate->peerId();
+  if (remote.isNull() || remote != existing->peerId()
+      || candidate->isOutbound() == existing->isOutbound())
+    return false;
+  const bool weDial = peerManager->peerId() < remote;
+  return candidate->isOutbound() == weDial;
+}
+
+void Client::connectionMessage(QSharedPointer<Message> message) {
+  PeerConnection *connection = qobject_cast<PeerConnection *>(sender());
+  // messages from a connection rejected as a duplicate are still in flight, ignore them
+  if (!connection)
+    return;
+  const QString nick = participantOf(connection);
+  if (connections.value(nick) != connection
+      && !standbyPaths.contains(connection->peerId(), connection))
+    return;
+  // a standby path, and one that took over from a closed path, names the peer "name@address"
+  // after its own address; the participant keeps the name it joined under
+  if (message->sender() != nick)
+    message->setSender(nick);
+
+  if (QSharedPointer<FileTransferMessage> transfer = qSharedPointerDynamicCast<FileTransferMessage>(message)) {
+    // chunks are written to disk here; the UI only hears about the completed file
+    fileTransfers->handleMessage(connection, transfer);
+    return;
+  }
+  emit newMessage(message);
+}
+
+void Client::relayedMessage(QSharedPointer<Message> message, const QByteArray &frame) {
+  PeerConnection *source = qobject_cast<PeerConnection *>(sender());
+  // Unlike direct messages, a relayed one is kept even from a connection rejected as a duplicate:
+  // its id is marked seen, so the copy on the connection that is kept would be dropped.
+  if (!source)
+    return;
+  // the first hop names the sender after the connection, which may be a path other than the one
+  // its participant is known by, see connectionMessage()
+  QByteArray forward = frame;
+  const QString nick = participantOf(source);
+  if (message->sender() == source->name() && nick != source->name()) {
+    message->setSender(nick);
+    forward = Relay::withOrigin(frame, nick.toUtf8());
+  }
+  forwardRelayed(source, forward,
+                 message->isBulk() ? OutboundQueue::BulkLane : OutboundQueue::InteractiveLane);
+  heardOf(message->sender());
+  emit newMessage(message);
 }
 
-void Client::connectionError(QAbstractSocket::SocketError /* socketError */) {
+void Client::relayedPresence(const QString &origin, const QByteArray &frame) {
+  PeerConnection *source = qobject_cast<PeerConnection *>(sender());
+  if (!source)
+    return;
+  // named like the first hop of a relayed message, see relayedMessage()
+  QString nick = origin;
+  QByteArray forward = frame;
+  if (origin == source->name() && participantOf(source) != origin) {
+    nick = participantOf(source);
+    forward = Relay::withOrigin(frame, nick.toUtf8());
+  }
+  forwardRelayed(source, forward, OutboundQueue::InteractiveLane);
+  heardOf(nick);
+}
+
+void Client::forwardRelayed(PeerConnection *source, const QByteArray &frame,
+                            OutboundQueue::Lane lane) {
+  if (!overlay)
+    return;
+  foreach (PeerConnection *connection, connections) {
+    if (connection != source && connection->acceptsRelay()) {
+      connection->sendFrame(frame, lane);
+      Relay::recordForwarded(frame.size());
+    }
+  }
+}
+
+void Client::heardOf(const QString &nick) {
+  // a participant with a connection comes and goes with it, also while it may be taken over
+  if (nick.isEmpty() || connections.contains(nick))
+    return;
+  if (!leaving.isEmpty() && leaving.contains(participants.key(nick)))
+    return;
+  if (!relayedParticipants.contains(nick))
+    emit newParticipant(nick);
+  relayedParticipants.insert(nick, presenceClock.elapsed());
+}
+
+void Client::announcePresence() {
+  const qint64 now = presenceClock.elapsed();
+  for (auto participant = relayedParticipants.begin(); participant != relayedParticipants.end();) {
+    if (now - participant.value() > Relay::PresenceTimeout) {
+      const QString nick = participant.key();
+      participant = relayedParticipants.erase(participant);
+      emit participantLeft(nick);
+    } else {
+      ++participant;
+    }
+  }
+
+  if (!overlay)
+    return;
+  const QByteArray frame = Relay::presenceFrame();
+  foreach (PeerConnection *connection, connections) {
+    if (connection->acceptsRelay())
+      connection->sendFrame(frame, OutboundQueue::InteractiveLane);
+  }
+}
+
+void Client::multicastFrame(const QByteArray &payload) {
+  PeerConnection *connection = qobject_cast<PeerConnection *>(sender());
+  if (connection && hasPeer(connection->peerId()))
+    multicast->handleFrame(connection->peerId(), payload);
+}
+
+void Client::connectionClosed() {
   if (PeerConnection *connection = qobject_cast<PeerConnection *>(sender()))
     removeConnection(connection);
 }
 
 void Client::removeConnection(PeerConnection *connection) {
-  QList<PeerConnection *> conns = peers.values(connection->peerAddress().toIPv4Address());
-  foreach (PeerConnection *con, conns) {
-    if (con->name() == connection->name()) {
-      peers.remove(connection->peerAddress().toIPv4Address(), con);
-      emit participantLeft(connection->name());
+  fileTransfers->connectionClosed(connection);
+  const QUuid id = connection->peerId();
+  const QString nick = participantOf(connection);
+  // a rejected duplicate carries the same name as the connection that is kept, so match exactly
+  if (connections.value(nick) == connection) {
+    // the peer is still reachable over another path, it takes over without the participant leaving
+    PeerConnection *standby = id.isNull() ? nullptr : standbyPaths.take(id);
+    {
+      QMutexLocker locker(&connectionsMutex);
+      if (standby)
+        connections.insert(nick, standby);
+      else
+        connections.remove(nick);
+    }
+    if (!standby && !id.isNull()) {
+      leaving.insert(id);
+      QTimer::singleShot(ReplaceGrace, this, [this, id, nick]() {
+        if (!leaving.remove(id))
+          return; // another connection took over
+        participants.remove(id);
+        multicast->peerLeft(id);
+        emit participantLeft(nick);
+      });
+    } else if (!standby) {
+      emit participantLeft(nick);
     }
+  } else if (!id.isNull()) {
+    standbyPaths.remove(id, connection);
   }
   connection->deleteLater();
 }
 
+CompressionStats Client::compressionStats() const {
+  return Compression::stats();
+}
+
+RelayStats Client::relayStats() const {
+  return Relay::stats();
+}
+
+RttStats Client::rttStats(const QString &nick) const {
+  QMutexLocker locker(&connectionsMutex);
+  PeerConnection *connection = connections.value(nick);
+  return connection ? connection->rttStats() : RttStats();
+}
+
+QHash<QString, RttStats> Client::rttStats() const {
+  QMutexLocker locker(&connectionsMutex);
+  QHash<QString, RttStats> stats;
+  for (auto it = connections.constBegin(); it != connections.constEnd(); ++it)
+    stats.insert(it.key(), it.value()->rttStats());
+  return stats;
+}
+
 quint16 Client::serverPort() const {
-  return server.serverPort();
+  return server->serverPort();
 }
 
 } // namespace p2pnetworking
@@ -51,44 +51,109 @@
 #ifndef CLIENT_H
 #define CLIENT_H
 
+#include "compression.h"
+#include "filemessage.h"
 #include "message.h"
+#include "multicasttransport.h"
+#include "peermanager.h"
+#include "relay.h"
+#include "rttstats.h"
 #include "server.h"
 #include <QAbstractSocket>
+#include <QElapsedTimer>
 #include <QHash>
 #include <QHostAddress>
+#include <QList>
+#include <QMutex>
+#include <QSet>
 #include <QSharedData>
+#include <QStringList>
+#include <QTimer>
+#include <functional>
+
+class QThread;
 
 namespace p2pnetworking {
 
-class PeerManager;
+class FileTransferManager;
 
 /**
  * @brief The Client class a complete peer to peer chat client. IPv4 only.
+ *
+ * The client, its server and peer discovery live on a dedicated network thread, and peer
+ * connections are spread over a small pool of connection threads where their frames are read and
+ * their messages decoded. The public slots may be called from any thread, and signals reach
+ * receivers on other threads through queued connections.
  */
 class Client : public QObject {
   Q_OBJECT
 
 public:
   Client();
+  /**
+   * @brief ~Client stops networking and joins the network threads. Must not be destroyed from the
+   * network thread itself.
+   */
+  ~Client() override;
 
   /**
-   * @brief nickName retrieve the local nickname
+   * @brief nickName retrieve the local nickname, safe to call from any thread.
    * @return the local user's nickname
    */
   QString nickName() const;
   /**
-   * @brief hasConnection check if a peer is already connected.
+   * @brief hasConnection check if a peer is already connected. Network thread only.
    * @param peer the IPv4 address of the peer.
    * @param nickName the nickname of the user on the peer.
    * @return true if a connection from the user on the given peer exists.
    */
   bool hasConnection(quint32 peer, const QString &nickName) const;
+  /**
+   * @brief hasPeer check if a peer is connected over any of its addresses. Network thread only.
+   * @param id the id the peer sent in its greeting, a null id is never connected.
+   */
+  bool hasPeer(const QUuid &id) const;
+  /**
+   * @brief dialBudget how many more peers discovery should dial, unlimited unless the relay
+   * overlay keeps the number of connections down. Network thread only.
+   */
+  int dialBudget() const;
   /**
    * @brief setUserName set the user's alias/name/handle - does not include the host IP.
    * @param name any name.
    */
   void setUserName(const QString &name);
+  /**
+   * @brief serverPort the port peers connect to. Network thread only.
+   */
   quint16 serverPort() const;
+  /**
+   * @brief compressionStats the traffic saved by compressing frames, safe to call from any thread.
+   */
+  CompressionStats compressionStats() const;
+  /**
+   * @brief relayStats the sender's upload per public message and the relay overlay's traffic,
+   * safe to call from any thread.
+   */
+  RelayStats relayStats() const;
+  /**
+   * @brief rttStats round trip statistics of one participant's connection, safe from any thread.
+   * @param nick the unique identifier of the participant.
+   * @return the statistics, without samples if the participant is not connected.
+   */
+  RttStats rttStats(const QString &nick) const;
+  /**
+   * @brief rttStats round trip statistics of every connected participant, safe from any thread.
+   * @return the statistics by participant.
+   */
+  QHash<QString, RttStats> rttStats() const;
+  /**
+   * @brief connectToPeer open a connection to a discovered peer on one of the connection threads.
+   * Network thread only.
+   * @param address the peer's address.
+   * @param port the peer's server port.
+   */
+  void connectToPeer(const QHostAddress &address, quint16 port);
 
 signals:
   /**
@@ -116,6 +181,36 @@ public slots:
    * @brief stop stops all network processing and disconnects.
    */
   void stop();
+  /**
+   * @brief setDiscovery choose how peers are discovered on the local network, broadcast unless
+   * set. May be called before or after start().
+   * @param mode broadcast or multicast.
+   * @param group the IPv4 multicast group, PeerManager::DefaultMulticastGroup if null.
+   */
+  void setDiscovery(DiscoveryMode mode, const QHostAddress &group = QHostAddress());
+  /**
+   * @brief setRendezvousUrl choose the central rendezvous server that finds peers beyond the local
+   * network. May be called before or after start().
+   * @param url its base url, PeerManager::DefaultRendezvousUrl if empty.
+   */
+  void setRendezvousUrl(const QUrl &url);
+  /**
+   * @brief setRelayOverlay join the relay overlay meant for rooms of hundreds: only a few peers
+   * are connected and public messages are forwarded from neighbour to neighbour, see Relay.
+   * Private messages and files still need a direct connection. Takes effect on the connections
+   * made after it, so call it before start().
+   * @param enabled true to join the overlay.
+   */
+  void setRelayOverlay(bool enabled);
+  /**
+   * @brief setMulticastText send public text to a multicast group once instead of to every peer,
+   * see MulticastTransport. Peers that cannot hear the group, or lack the transport, still get it
+   * over TCP; the relay overlay takes precedence. Takes effect on the connections made after it,
+   * so call it before start().
+   * @param enabled true to use the transport.
+   * @param group the IPv4 multicast group, MulticastTransport::DefaultGroup if null.
+   */
+  void setMulticastText(bool enabled, const QHostAddress &group = QHostAddress());
   /**
    * @brief sendMessage send a message to all peers.
    * @param message the message to send.
@@ -127,21 +222,115 @@ public slots:
    * @param nick the unique identifer of the user to send to.
    */
   void sendMessage(QSharedPointer<Message> message, QString nick);
+  /**
+   * @brief sendMessage send a message to a group of recipients. The message is serialized once and
+   * the same frame is written to every recipient's connection.
+   * @param message the message to send
+   * @param nicks the unique identifiers of the users to send to.
+   */
+  void sendMessage(QSharedPointer<Message> message, const QStringList &nicks);
+  /**
+   * @brief sendFile stream a file stored on disk to all peers, in chunks, without loading it.
+   * @param file the file to send, see FileMessage::isOnDisk().
+   */
+  void sendFile(QSharedPointer<FileMessage> file);
+  /**
+   * @brief sendFile stream a file stored on disk to a group of recipients.
+   * @param file the file to send, see FileMessage::isOnDisk().
+   * @param nicks the unique identifiers of the users to send to.
+   */
+  void sendFile(QSharedPointer<FileMessage> file, const QStringList &nicks);
 
   /* ALL IMPLEMENTATION BELOW THIS POINT IS PRIVATE TO THE NETWORK AND MAY CHANGE AT ANY TIME! */
 
 private slots:
-  void newConnection(PeerConnection *connection);
-  void connectionError(QAbstractSocket::SocketError socketError);
-  void disconnected();
+  void initialize();
+  void shutdown();
+  void incomingSocket(qintptr socketDescriptor);
+  void connectionClosed();
   void readyForUse();
+  void connectionMessage(QSharedPointer<Message> message);
+  void relayedMessage(QSharedPointer<Message> message, const QByteArray &frame);
+  void relayedPresence(const QString &origin, const QByteArray &frame);
+  void multicastFrame(const QByteArray &payload);
+  /**
+   * @brief announcePresence tell the overlay this node is here, and let the participants that
+   * stopped announcing themselves leave.
+   */
+  void announcePresence();
 
 private:
+  bool isNetworkThread() const;
+  QList<PeerConnection *> connectionsFor(const QStringList &nicks) const;
+  void spawnConnection(const std::function<void(PeerConnection *)> &start);
   void removeConnection(PeerConnection *connection);
+  /**
+   * @brief forwardRelayed pass a relayed frame on to the other overlay neighbours.
+   * @param source the neighbour it came from.
+   * @param frame the RELY frame.
+   * @param lane the lane to queue it in.
+   */
+  void forwardRelayed(PeerConnection *source, const QByteArray &frame, OutboundQueue::Lane lane);
+  /**
+   * @brief heardOf record that a participant without a connection is still in the overlay.
+   * @param nick its name, as the relayed frames give it.
+   */
+  void heardOf(const QString &nick);
+  /**
+   * @brief participantOf the name a connection's participant is known by, which for a peer with
+   * several paths is the name of the first one.
+   */
+  QString participantOf(const PeerConnection *connection) const;
+  /**
+   * @brief choosePath keep the path to a peer with the lowest round trip time and close the
+   * others. Only the peer with the lower id chooses, the other one follows its closes.
+   * @param id the peer.
+   */
+  void choosePath(const QUuid &id);
+  /**
+   * @brief prefers decide which of two connections to the same peer to keep when both peers
+   * dialled each other. Both ends keep the one dialled by the peer with the lower id, so they
+   * agree without another round trip; without the peer's id the first connection is kept.
+   * @param candidate the connection that just became ready.
+   * @param existing the connection already in use.
+   * @return true to replace existing with candidate.
+   */
+  bool prefers(const PeerConnection *candidate, const PeerConnection *existing) const;
 
   PeerManager *peerManager;
-  Server server;
-  QMultiHash<quint32, PeerConnection *> peers;
+  FileTransferManager *fileTransfers;
+  Server *server;
+  /** the connections in use, by their unique name (nick@ip). Only changed on the network thread,
+   * under connectionsMutex so other threads may read it; a connection is only deleted after it was
+   * removed here */
+  QHash<QString, PeerConnection *> connections;
+  mutable QMutex connectionsMutex;
+  /** the participant name of each peer that sent an id. Network thread only */
+  QHash<QUuid, QString> participants;
+  /** the other paths to such a peer, e.g. over a second interface, until one is chosen. A standby
+   * takes over when the connection in use closes. Network thread only */
+  QMultiHash<QUuid, PeerConnection *> standbyPaths;
+  /** the peers whose last connection closed less than ReplaceGrace ago. Their participants stay,
+   * in case a crossed duplicate that is not ready yet takes over. Network thread only */
+  QSet<QUuid> leaving;
+  bool overlay; /**< in the relay overlay. Network thread only */
+  /** the participants only reached through the overlay, with the presenceClock time they were last
+   * heard of. Network thread only */
+  QHash<QString, qint64> relayedParticipants;
+  QElapsedTimer presenceClock;
+  QTimer *presenceTimer;
+  MulticastTransport *multicast;
+  bool multicastEnabled; /**< Network thread only, like multicastGroup */
+  QHostAddress multicastGroup;
+
+  QThread *networkThread;
+  QList<QThread *> connectionThreads;
+  /** one parent object per connection thread, connections are created as its children */
+  QList<QObject *> connectionContexts;
+  int nextConnectionThread;
+
+  mutable QMutex nameMutex;
+  QString userName; /**< guarded by nameMutex */
 };
 
 } // namespace p2pnetworking
@@ -0,0 +1,97 @@
+#include "compression.h"
+
+#include <QAtomicInteger>
+#include <QtEndian>
+#include <cstring>
+
+namespace p2pnetworking {
+
+const char *const Compression::Capability = "zlib";
+
+// qCompress() prefixes the stream with the uncompressed size as a 32 bit big endian integer.
+static const int SizePrefix = 4;
+// Speed matters more than ratio, the link rarely has time to wait for the higher levels.
+static const int CompressionLevel = 3;
+
+static QAtomicInteger<quint64> rawBytesSent;
+static QAtomicInteger<quint64> wireBytesSent;
+static QAtomicInteger<quint64> rawBytesReceived;
+static QAtomicInteger<quint64> wireBytesReceived;
+
+struct Signature {
+  int offset;
+  int size;
+  const char *bytes;
+};
+
+static const Signature signatures[] = {
+    {0, 2, "\x1f\x8b"},                 // gzip
+    {0, 4, "PK\x03\x04"},               // zip, jar, docx, ...
+    {0, 3, "BZh"},                      // bzip2
+    {0, 6, "\xfd" "7zXZ\x00"},          // xz
+    {0, 4, "\x28\xb5\x2f\xfd"},         // zstd
+    {0, 6, "7z\xbc\xaf\x27\x1c"},       // 7z
+    {0, 8, "\x89PNG\r\n\x1a\n"},        // PNG
+    {0, 3, "\xff\xd8\xff"},             // JPEG
+    {0, 4, "GIF8"},                     // GIF
+    {8, 4, "WEBP"},                     // WebP, after the RIFF header
+};
+
+quint64 CompressionStats::bytesSaved() const {
+  return (rawBytesSent - wireBytesSent) + (rawBytesReceived - wireBytesReceived);
+}
+
+bool Compression::looksCompressed(const QByteArray &data) {
+  for (const Signature &signature : signatures) {
+    if (data.size() >= signature.offset + signature.size
+        && std::memcmp(data.constData() + signature.offset, signature.bytes,
+                       size_t(signature.size)) == 0)
+      return true;
+  }
+  return false;
+}
+
+QByteArray Compression::compress(const QByteArray &data) {
+  if (data.size() < MinimumSize)
+    return QByteArray();
+  QByteArray compressed = qCompress(data, CompressionLevel);
+  if (compressed.size() > data.size() - data.size() / 8)
+    return QByteArray();
+  return compressed;
+}
+
+QByteArray Compression::uncompress(const QByteArray &data, int maxSize) {
+  // qUncompress() sizes its buffer from the prefix, so refuse a prefix above the limit up front; a
+  // stream that expands past its prefix is caught afterwards
+  if (data.size() <= SizePrefix)
+    return QByteArray();
+  const quint32 size = qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(data.constData()));
+  if (size == 0 || size > quint32(maxSize))
+    return QByteArray();
+
+  QByteArray uncompressed = qUncompress(data);
+  if (uncompressed.size() != int(size))
+    return QByteArray();
+  return uncompressed;
+}
+
+void Compression::recordSent(qint64 rawSize, qint64 wireSize) {
+  rawBytesSent.fetchAndAddRelaxed(quint64(rawSize));
+  wireBytesSent.fetchAndAddRelaxed(quint64(wireSize));
+}
+
+void Compression::recordReceived(qint64 rawSize, qint64 wireSize) {
+  rawBytesReceived.fetchAndAddRelaxed(quint64(rawSize));
+  wireBytesReceived.fetchAndAddRelaxed(quint64(wireSize));
+}
+
+CompressionStats Compression::stats() {
+  CompressionStats stats;
+  stats.rawBytesSent = rawBytesSent.loadAcquire();
+  stats.wireBytesSent = wireBytesSent.loadAcquire();
+  stats.rawBytesReceived = rawBytesReceived.loadAcquire();
+  stats.wireBytesReceived = wireBytesReceived.loadAcquire();
+  return stats;
+}
+
+} // namespace p2pnetworking
@@ -0,0 +1,68 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <QByteArray>
+
+namespace p2pnetworking {
+
+/**
+ * @brief The CompressionStats struct totals for compressed frames since the process started. Raw
+ * sizes are the payload sizes before compression, wire sizes what was actually transferred.
+ */
+struct CompressionStats {
+  quint64 rawBytesSent = 0;
+  quint64 wireBytesSent = 0;
+  quint64 rawBytesReceived = 0;
+  quint64 wireBytesReceived = 0;
+
+  /**
+   * @brief bytesSaved the traffic avoided by compression, in both directions.
+   */
+  quint64 bytesSaved() const;
+};
+
+/**
+ * @brief The Compression class zlib compression of frame payloads, offered during the greeting as
+ * the "zlib" capability. Payloads are only compressed when they are large enough and shrink enough
+ * to be worth the receiver's time.
+ */
+class Compression {
+public:
+  /** the capability token advertised in the greeting */
+  static const char *const Capability;
+  /** payloads smaller than this are always sent as they are */
+  static const int MinimumSize = 512;
+
+  /**
+   * @brief looksCompressed test for the signature of a common compressed format (gzip, zip, bzip2,
+   * xz, zstd, 7z, PNG, JPEG, GIF, WebP).
+   * @param data the first bytes of the data, at least 8 for a reliable answer.
+   */
+  static bool looksCompressed(const QByteArray &data);
+
+  /**
+   * @brief compress compress a payload.
+   * @param data the payload.
+   * @return the compressed payload, or a null array if it would not save at least an eighth.
+   */
+  static QByteArray compress(const QByteArray &data);
+
+  /**
+   * @brief uncompress restore a payload produced by compress().
+   * @param data the compressed payload.
+   * @param maxSize the largest payload accepted, checked before anything is allocated.
+   * @return the payload, or a null array if it is corrupt or too large.
+   */
+  static QByteArray uncompress(const QByteArray &data, int maxSize);
+
+  static void recordSent(qint64 rawSize, qint64 wireSize);
+  static void recordReceived(qint64 rawSize, qint64 wireSize);
+  /**
+   * @brief stats the totals so far, safe to call from any thread.
+   */
+  static CompressionStats stats();
+};
+
+} // namespace p2pnetworking
+
+#endif
@@ -50,6 +50,9 @@
 
 #include "connection.h"
 
+#include "compression.h"
+#include "multicasttransport.h"
+#include "relay.h"
 #include <QtNetwork>
 
 namespace p2pnetworking {
@@ -58,225 +61,457 @@ static const int TransferTimeout = 30 * 1000;
 static const int PongTimeout = 15 * 1000;
 static const int PingInterval = 5 * 1000;
 static const int ConnectTimeout = 5 * 1000;
+static const int MaxPingPayload = 16;
+// A peer sends its capabilities right behind its greeting, older peers never do.
+static const int CapabilitiesTimeout = 2 * 1000;
+static const char CapabilitiesPrefix[] = "caps:";
 static const char SeparatorToken = Message::Separator;
-
-PeerConnection::PeerConnection(QObject *parent) : QTcpSocket(parent) {
+static const char IdCapability[] = "id=";
+static const char AvatarHashCapability[] = "avatar";
+// The peer takes files as a FileTransferMessage stream.
+static const char FileTransferCapability[] = "xfer";
+// The peer reassembles PART frames, so large bulk frames may be split for it.
+static const char PartCapability[] = "part";
+// Room for the "TYPE|length|" header of a frame reassembled from parts.
+static const int MaxFrameHeaderSize = 16;
+// Only this much is handed to the socket at a time, the rest waits in the outbound queue where
+// control and interactive frames can still overtake it.
+static const qint64 SocketWriteWatermark = 64 * 1024;
+static const int WriteSliceSize = 16 * 1024;
+// Backpressure thresholds for the outbound queue.
+static const qint64 OutboundHighWaterMark = 1024 * 1024;
+static const qint64 OutboundLowWaterMark = 256 * 1024;
+
+PeerConnection::PeerConnection(QObject *parent)
+    : QTcpSocket(parent), transferTimeout([this]() { abort(); }),
+      pingTimer([this]() { sendPing(); }), pongTimeout([this]() { abort(); }),
+      capabilitiesTimeout([this]() { becomeReady(); }),
+      decoder(MaxBufferSize, MaxBufferSize) {
   greetingMessage = tr("undefined");
   username = tr("unknown");
   state = WaitingForGreeting;
-  currentDataType = Undefined;
-  numBytesForCurrentDataType = -1;
-  transferTimerId = 0;
   isGreetingMessageSent = false;
-  pingTimer.setInterval(PingInterval);
-  transferTimerId = startTimer(ConnectTimeout);
+  compressionAccepted = false;
+  avatarHashesAccepted = false;
+  fileTransfersAccepted = false;
+  dialled = false;
+  relayEnabled = false;
+  relayAccepted = false;
+  multicastEnabled = false;
+  multicastAccepted = false;
+  pingSequence = 0;
+  pingSentAt = -1;
+  rttClock.start();
+  transferTimeout.start(ConnectTimeout);
 
   QObject::connect(this, SIGNAL(readyRead()), this, SLOT(processReadyRead()));
-  QObject::connect(this, SIGNAL(disconnected()), &pingTimer, SLOT(stop()));
-  QObject::connect(&pingTimer, SIGNAL(timeout()), this, SLOT(sendPing()));
   QObject::connect(this, SIGNAL(connected()), this, SLOT(sendGreetingMessage()));
+  QObject::connect(this, SIGNAL(bytesWritten(qint64)), this, SLOT(flushOutbound()));
+  QObject::connect(this, &QAbstractSocket::stateChanged, this,
+                   &PeerConnection::socketStateChanged);
+}
+
+PeerConnection::~PeerConnection() {
+  // nobody, this connection included, hears about the close of a connection being deleted
+  disconnect();
+  abort();
 }
 
 QString PeerConnection::name() const {
   return username;
 }
 
+QHostAddress PeerConnection::address() const {
+  return remoteAddress;
+}
+
 void PeerConnection::setGreetingMessage(const QString &message) {
   greetingMessage = message;
 }
 
+void PeerConnection::setLocalId(const QUuid &id) {
+  localId = id;
+}
+
+QUuid PeerConnection::peerId() const {
+  return remoteId;
+}
+
+void PeerConnection::dial(const QHostAddress &address, quint16 port) {
+  dialled = true;
+  connectToHost(address, port);
+}
+
+bool PeerConnection::isOutbound() const {
+  return dialled;
+}
+
+void PeerConnection::setRelayEnabled(bool enabled) {
+  relayEnabled = enabled;
+}
+
+bool PeerConnection::acceptsRelay() const {
+  return relayEnabled && relayAccepted;
+}
+
+void PeerConnection::setMulticastEnabled(bool enabled) {
+  multicastEnabled = enabled;
+}
+
+bool PeerConnection::acceptsMulticast() const {
+  return multicastEnabled && multicastAccepted;
+}
+
 bool PeerConnection::sendMessage(QSharedPointer<Message> message) {
   if (message->isEmpty())
     return false;
-  QByteArray messageContent = message->data();
-  QByteArray data = "MESG|" + QByteArray::number(messageContent.size()) + SeparatorToken + messageContent;
-  return write(data) == data.size();
+  MessageFrames frames(*message);
+  return sendFrames(frames);
 }
 
-void PeerConnection::timerEvent(QTimerEvent *timerEvent) {
-  if (timerEvent->timerId() == transferTimerId) {
-    abort();
-    killTimer(transferTimerId);
-    transferTimerId = 0;
+bool PeerConnection::sendFrames(MessageFrames &frames) {
+  // the receiver would drop the whole connection over it
+  if (frames.content().size() > MaxFrameSize) {
+    qWarning() << "Dropping a message of" << frames.content().size() << "bytes, the limit is"
+               << MaxFrameSize;
+    return !isCongested();
   }
+  return sendFrame(frames.frameFor(compressionAccepted), frames.lane());
 }
 
-void PeerConnection::processReadyRead() {
-  if (state == WaitingForGreeting) {
-    if (!readProtocolHeader())
-      return;
-    if (currentDataType != Greeting) {
-      abort();
-      return;
-    }
-    state = ReadingGreeting;
+bool PeerConnection::sendFrame(const QByteArray &frame, OutboundQueue::Lane lane) {
+  if (frame.isEmpty())
+    return !isCongested();
+
+  // Queue right away, so the caller sees backpressure immediately even when the socket itself
+  // can only be written on the connection's thread.
+  bool becameCongested = false;
+  {
+    QMutexLocker locker(&outboundMutex);
+    outbound.enqueue(frame, lane);
+    if (outbound.queuedBytes() > OutboundHighWaterMark)
+      becameCongested = congested.testAndSetOrdered(0, 1);
   }
+  if (becameCongested)
+    emit congestionChanged(true);
+
+  if (QThread::currentThread() == thread())
+    flushOutbound();
+  else if (flushScheduled.testAndSetOrdered(0, 1))
+    QMetaObject::invokeMethod(this, "flushOutbound", Qt::QueuedConnection);
+  return !isCongested();
+}
 
-  if (state == ReadingGreeting) {
-    if (!hasEnoughData())
-      return;
+bool PeerConnection::isCongested() const {
+  return congested.loadAcquire() != 0;
+}
 
-    buffer = read(numBytesForCurrentDataType);
-    if (buffer.size() != numBytesForCurrentDataType) {
-      abort();
-      return;
-    }
+bool PeerConnection::acceptsCompression() const {
+  return compressionAccepted;
+}
 
-    username = QString::fromUtf8(buffer) + '@' + peerAddress().toString();
-    currentDataType = Undefined;
-    numBytesForCurrentDataType = 0;
-    buffer.clear();
+bool PeerConnection::acceptsAvatarHashes() const {
+  return avatarHashesAccepted;
+}
 
-    if (!isValid()) {
+bool PeerConnection::acceptsFileTransfers() const {
+  return fileTransfersAccepted;
+}
+
+RttStats PeerConnection::rttStats() const {
+  QMutexLocker locker(&rttMutex);
+  return rtt;
+}
+
+QByteArray PeerConnection::messageFrame(const Message &message) {
+  return MessageFrames::frame("MESG", message.data());
+}
+
+void PeerConnection::processReadyRead() {
+  while (bytesAvailable() > 0) {
+    if (decoder.readFrom(this) < 0) {
       abort();
       return;
     }
 
-    if (!isGreetingMessageSent)
-      sendGreetingMessage();
-
-    pingTimer.start();
-    pongTime.start();
-    state = ReadyForUse;
-    emit readyForUse();
-  }
-
-  do {
-    if (currentDataType == Undefined) {
-      if (!readProtocolHeader())
+    FrameDecoder::Status status;
+    while ((status = decoder.next()) == FrameDecoder::FrameReady) {
+      if (!processFrame(decoder.type(), decoder.payload()))
         return;
     }
-    if (!hasEnoughData())
+    if (status == FrameDecoder::ProtocolError) {
+      abort();
       return;
-    processData();
-  } while (bytesAvailable() > 0);
+    }
+  }
+
+  // an in-memory relink on the thread's timer wheel, cheap enough to do on every read
+  if (decoder.hasPartialFrame())
+    transferTimeout.start(TransferTimeout);
+  else
+    transferTimeout.stop();
 }
 
 void PeerConnection::sendPing() {
-  if (pongTime.elapsed() > PongTimeout) {
-    abort();
-    return;
-  }
-
-  write("PING|1|p");
+  pingTimer.start(PingInterval);
+  // the peer echoes the sequence number, which matches the PONG to this PING
+  ++pingSequence;
+  pingSentAt = rttClock.nsecsElapsed() / 1000;
+  sendFrame(MessageFrames::frame("PING", QByteArray::number(pingSequence)),
+            OutboundQueue::ControlLane);
 }
 
 void PeerConnection::sendGreetingMessage() {
-  QByteArray greeting = greetingMessage.toUtf8();
-  QByteArray data = "GREE|" + QByteArray::number(greeting.size()) + '|' + greeting;
-  if (write(data) == data.size())
-    isGreetingMessageSent = true;
+  // The greeting carries the name alone, as it always did; the name may not contain the separator
+  // since it ends up in relay headers.
+  const QString name = QString(greetingMessage).replace(SeparatorToken, Message::SeparatorHTMLCode);
+  sendFrame(MessageFrames::frame("GREE", name.toUtf8()), OutboundQueue::ControlLane);
+
+  // "caps:capability;capability" right behind it tells the peer what it may send us. It goes in a
+  // PING, which older peers answer without looking at the payload.
+  QByteArray capabilities = CapabilitiesPrefix;
+  capabilities += Compression::Capability;
+  capabilities += ';' + QByteArray(AvatarHashCapability);
+  capabilities += ';' + QByteArray(FileTransferCapability);
+  capabilities += ';' + QByteArray(PartCapability);
+  if (!localId.isNull())
+    capabilities += ';' + QByteArray(IdCapability) + localId.toRfc4122().toHex();
+  if (relayEnabled)
+    capabilities += ';' + QByteArray(Relay::Capability);
+  if (multicastEnabled)
+    capabilities += ';' + QByteArray(MulticastTransport::Capability);
+  sendFrame(MessageFrames::frame("PING", capabilities), OutboundQueue::ControlLane);
+  isGreetingMessageSent = true;
 }
 
-int PeerConnection::readDataIntoBuffer(int maxSize) {
-  if (maxSize > MaxBufferSize)
-    return 0;
+void PeerConnection::flushOutbound() {
+  flushScheduled.storeRelease(0);
+  if (QTcpSocket::state() != QAbstractSocket::ConnectedState)
+    return;
 
-  int numBytesBeforeRead = buffer.size();
-  if (numBytesBeforeRead == MaxBufferSize) {
+  bool failed = false;
+  bool drained = false;
+  {
+    QMutexLocker locker(&outboundMutex);
+    while (bytesToWrite() < SocketWriteWatermark) {
+      int size = 0;
+      const char *slice = outbound.peek(WriteSliceSize, &size);
+      if (!slice)
+        break;
+      qint64 written = write(slice, size);
+      if (written <= 0) {
+        failed = true;
+        break;
+      }
+      outbound.consume(int(written));
+    }
+    if (outbound.queuedBytes() < OutboundLowWaterMark)
+      drained = congested.testAndSetOrdered(1, 0);
+  }
+  // signals and abort() run outside the lock, their slots may queue frames again
+  if (failed) {
     abort();
-    return 0;
+    return;
   }
+  if (drained)
+    emit congestionChanged(false);
+}
 
-  while (bytesAvailable() > 0 && buffer.size() < maxSize) {
-    buffer.append(read(1));
-    if (buffer.endsWith(SeparatorToken))
-      break;
+void PeerConnection::socketStateChanged(QAbstractSocket::SocketState socketState) {
+  if (socketState == QAbstractSocket::UnconnectedState) {
+    transferTimeout.stop();
+    pingTimer.stop();
+    pongTimeout.stop();
+    capabilitiesTimeout.stop();
+    emit closed();
   }
-  return buffer.size() - numBytesBeforeRead;
 }
 
-int PeerConnection::dataLengthForCurrentDataType() {
-  if (bytesAvailable() <= 0 || readDataIntoBuffer() <= 0 || !buffer.endsWith(SeparatorToken))
-    return 0;
+void PeerConnection::parseCapabilities(const QByteArray &capabilities) {
+  foreach (const QByteArray &capability, capabilities.split(';')) {
+    if (capability == Compression::Capability)
+      compressionAccepted = true;
+    else if (capability == AvatarHashCapability)
+      avatarHashesAccepted = true;
+    else if (capability == FileTransferCapability)
+      fileTransfersAccepted = true;
+    else if (capability == PartCapability) {
+      // a PONG then waits behind one part at most, not behind a whole inline image
+      QMutexLocker locker(&outboundMutex);
+      outbound.setPartSize(WriteSliceSize);
+    }
+    else if (capability == Relay::Capability)
+      relayAccepted = true;
+    else if (capability == MulticastTransport::Capability)
+      multicastAccepted = true;
+    else if (capability.startsWith(IdCapability))
+      remoteId = QUuid::fromRfc4122(QByteArray::fromHex(capability.mid(qstrlen(IdCapability))));
+  }
+}
 
-  buffer.chop(1);
-  int number = buffer.toInt();
-  buffer.clear();
-  return number;
+void PeerConnection::becomeReady() {
+  decoder.setMaxFrameSize(MaxFrameSize);
+  pingTimer.start(PingInterval);
+  pongTimeout.start(PongTimeout);
+  state = ReadyForUse;
+  emit readyForUse();
 }
 
-bool PeerConnection::readProtocolHeader() {
-  if (transferTimerId) {
-    killTimer(transferTimerId);
-    transferTimerId = 0;
-  }
+bool PeerConnection::processFrame(FrameDecoder::FrameType type, const QByteArray &payload) {
+  if (state == WaitingForGreeting) {
+    if (type != FrameDecoder::GreetingFrame) {
+      abort();
+      return false;
+    }
 
-  if (readDataIntoBuffer() <= 0) {
-    transferTimerId = startTimer(TransferTimeout);
-    return false;
+    remoteAddress = peerAddress();
+    username = QString::fromUtf8(payload) + '@' + remoteAddress.toString();
+    if (!isValid()) {
+      abort();
+      return false;
+    }
+
+    if (!isGreetingMessageSent)
+      sendGreetingMessage();
+
+    state = WaitingForCapabilities;
+    capabilitiesTimeout.start(CapabilitiesTimeout);
+    return true;
   }
 
-  if (buffer == "PING|") {
-    currentDataType = Ping;
-  } else if (buffer == "PONG|") {
-    currentDataType = Pong;
-  } else if (buffer == "MESG|") {
-    currentDataType = MessageType;
-  } else if (buffer == "GREE|") {
-    currentDataType = Greeting;
-  } else {
-    currentDataType = Undefined;
-    abort();
-    return false;
+  if (state == WaitingForCapabilities) {
+    capabilitiesTimeout.stop();
+    if (type == FrameDecoder::PingFrame && payload.startsWith(CapabilitiesPrefix)) {
+      parseCapabilities(payload.mid(qstrlen(CapabilitiesPrefix)));
+      becomeReady();
+      return true;
+    }
+    // the first frame of a peer from before capabilities, typically the PONG to ours, is handled
+    // as usual
+    becomeReady();
   }
 
-  buffer.clear();
-  numBytesForCurrentDataType = dataLengthForCurrentDataType();
+  switch (type) {
+  case FrameDecoder::MessageFrame:
+    processMessage(payload);
+    break;
+  case FrameDecoder::CompressedMessageFrame: {
+    const QByteArray content = Compression::uncompress(payload, MaxFrameSize);
+    if (content.isNull()) {
+      abort();
+      return false;
+    }
+    Compression::recordReceived(content.size(), payload.size());
+    processMessage(content);
+    break;
+  }
+  case FrameDecoder::RelayFrame:
+    processRelay(payload);
+    break;
+  case FrameDecoder::PartFrame:
+    return processPart(payload);
+  case FrameDecoder::MulticastFrame:
+    // the payload points into the decoder's buffer, the signal is queued
+    emit multicastFrame(QByteArray(payload.constData(), payload.size()));
+    break;
+  case FrameDecoder::PingFrame:
+    // echo the sequence number; anything unexpectedly large gets the old fixed reply
+    sendFrame(MessageFrames::frame("PONG", payload.size() <= MaxPingPayload ? payload : QByteArray("p")),
+              OutboundQueue::ControlLane);
+    break;
+  case FrameDecoder::PongFrame:
+    pongTimeout.start(PongTimeout);
+    // older peers always answer "p", which can only be the reply to the last PING
+    if (pingSentAt >= 0 && (payload == QByteArray::number(pingSequence) || payload == "p")) {
+      QMutexLocker locker(&rttMutex);
+      rtt.record(rttClock.nsecsElapsed() / 1000 - pingSentAt);
+      pingSentAt = -1;
+    }
+    break;
+  default:
+    break;
+  }
   return true;
 }
 
-bool PeerConnection::hasEnoughData() {
-  if (transferTimerId) {
-    QObject::killTimer(transferTimerId);
-    transferTimerId = 0;
-  }
+QSharedPointer<Message> PeerConnection::decodeMessage(const QByteArray &payload,
+                                                     const QString &sender) {
+  // Split message. The payload still points into the decoder's buffer; mid() hands the message
+  // its own copy of the body.
+  int pos = payload.indexOf(SeparatorToken);
+  if (pos < 0)
+    return QSharedPointer<Message>();
+  int type = payload.left(pos).toInt();
+  return messageFactory.create(sender, payload.mid(pos + 1), type);
+}
 
-  if (numBytesForCurrentDataType <= 0)
-    numBytesForCurrentDataType = dataLengthForCurrentDataType();
+void PeerConnection::processMessage(const QByteArray &payload) {
+  QSharedPointer<Message> message = decodeMessage(payload, username);
+  if (!message.isNull())
+    emit newMessage(message);
+}
 
-  if (bytesAvailable() < numBytesForCurrentDataType || numBytesForCurrentDataType <= 0) {
-    transferTimerId = startTimer(TransferTimeout);
+bool PeerConnection::processPart(const QByteArray &payload) {
+  if (payload.isEmpty() ||
+      partialFrame.size() + payload.size() - 1 > MaxFrameSize + MaxFrameHeaderSize) {
+    abort();
     return false;
   }
-
-  return true;
+  partialFrame.append(payload.constData() + 1, payload.size() - 1);
+  if (payload.at(0) != OutboundQueue::LastPartFlag)
+    return true;
+
+  // the reassembled frame is handled as if it had arrived whole
+  FrameDecoder whole(MaxFrameSize, MaxBufferSize);
+  whole.append(partialFrame.constData(), partialFrame.size());
+  partialFrame.clear();
+  if (whole.next() != FrameDecoder::FrameReady || whole.type() == FrameDecoder::PartFrame ||
+      whole.hasPartialFrame()) {
+    abort();
+    return false;
+  }
+  return processFrame(whole.type(), whole.payload());
 }
 
-void PeerConnection::processData() {
-  buffer = read(numBytesForCurrentDataType);
-  if (buffer.size() != numBytesForCurrentDataType) {
-    abort();
+void PeerConnection::processRelay(const QByteArray &payload) {
+  QByteArray id, origin, inner;
+  if (!Relay::parse(payload, &id, &origin, &inner))
+    return;
+  // the id is checked first, a duplicate costs no decoding at all
+  if (!Relay::firstSighting(id)) {
+    Relay::recordDuplicate();
     return;
   }
 
-  switch (currentDataType) {
-  case MessageType:
-    // Split message.
-    {
-      int pos = buffer.indexOf('|');
-      if (pos >= 0) {
-        int type = buffer.left(pos).toInt();
-        QSharedPointer<Message> message =
-            messageFactory.create(username, buffer.mid(pos + 1), type);
-
-        emit newMessage(message);
-      }
-    }
-    break;
-  case Ping:
-    write("PONG|1|p");
-    break;
-  case Pong:
-    pongTime.restart();
-    break;
-  default:
-    break;
+  FrameDecoder innerDecoder(MaxFrameSize, MaxBufferSize);
+  innerDecoder.append(inner.constData(), inner.size());
+  if (innerDecoder.next() != FrameDecoder::FrameReady)
+    return;
+  // the sender's neighbours name it as they see it, like any other participant
+  const bool firstHop = origin.isEmpty();
+  if (firstHop)
+    origin = username.toUtf8();
+  if (innerDecoder.type() == FrameDecoder::PresenceFrame) {
+    emit relayedPresence(QString::fromUtf8(origin), firstHop ? Relay::frame(id, origin, inner)
+                                                             : MessageFrames::frame("RELY", payload));
+    return;
   }
 
-  currentDataType = Undefined;
-  numBytesForCurrentDataType = 0;
-  buffer.clear();
+  QByteArray content = innerDecoder.payload();
+  if (innerDecoder.type() == FrameDecoder::CompressedMessageFrame) {
+    content = Compression::uncompress(content, MaxFrameSize);
+    if (content.isNull())
+      return;
+  } else if (innerDecoder.type() != FrameDecoder::MessageFrame) {
+    return;
+  }
+
+  QSharedPointer<Message> message = decodeMessage(content, QString::fromUtf8(origin));
+  if (message.isNull())
+    return;
+  Relay::recordDelivered();
+  emit relayedMessage(message, firstHop ? Relay::frame(id, origin, inner)
+                                        : MessageFrames::frame("RELY", payload));
 }
 
 } // namespace p2pnetworking
@@ -51,58 +51,206 @@
 #ifndef CONNECTION_H
 #define CONNECTION_H
 
+#include "framedecoder.h"
 #include "messagefactory.h"
+#include "messageframes.h"
+#include "outboundqueue.h"
+#include "rttstats.h"
+#include "timerwheel.h"
+#include <QAtomicInt>
+#include <QElapsedTimer>
 #include <QHostAddress>
+#include <QMutex>
 #include <QString>
 #include <QTcpSocket>
-#include <QTime>
-#include <QTimer>
+#include <QUuid>
 
 namespace p2pnetworking {
 
+// The most bytes read from a socket at once, and the largest frame accepted before the handshake
+// is complete, so an unauthenticated peer cannot make a connection buffer more.
 static const int MaxBufferSize = 1024000;
+// The largest message a peer may send once connected, well above inline images and files; a larger
+// frame is a corrupt stream, and a larger outgoing message is dropped instead of being sent.
+static const int MaxFrameSize = 64 * 1024 * 1024;
 
+/**
+ * @brief The PeerConnection class a framed connection to one peer. A connection lives on one of
+ * the client's connection threads; sendFrame() and isCongested() may be called from any thread,
+ * everything else only from the connection's own thread or once readyForUse() was delivered.
+ */
 class PeerConnection : public QTcpSocket {
   Q_OBJECT
 
 public:
-  enum ConnectionState { WaitingForGreeting, ReadingGreeting, ReadyForUse };
-  enum DataType { MessageType, Ping, Pong, Greeting, Undefined };
+  enum ConnectionState { WaitingForGreeting, WaitingForCapabilities, ReadyForUse };
   PeerConnection(QObject *parent = 0);
+  /**
+   * @brief ~PeerConnection closes the socket while the connection is still whole. ~QAbstractSocket
+   * would abort it too, but its stateChanged signal would then reach slots of a connection whose
+   * members are already destroyed.
+   */
+  ~PeerConnection() override;
 
   QString name() const;
+  /**
+   * @brief address the peer's address as seen when the greeting arrived. Unlike peerAddress() it
+   * is not cleared when the socket closes.
+   */
+  QHostAddress address() const;
   void setGreetingMessage(const QString &message);
+  /**
+   * @brief setLocalId set the id of this peer, sent in the greeting.
+   */
+  void setLocalId(const QUuid &id);
+  /**
+   * @brief peerId the id the peer sent in its greeting, null for peers from before ids.
+   */
+  QUuid peerId() const;
+  /**
+   * @brief dial connect to a peer's server, unlike a socket accepted by ours.
+   */
+  void dial(const QHostAddress &address, quint16 port);
+  /**
+   * @brief isOutbound test if this peer dialled the connection.
+   */
+  bool isOutbound() const;
+  /**
+   * @brief setRelayEnabled offer the relay overlay in the greeting, see Relay.
+   */
+  void setRelayEnabled(bool enabled);
+  /**
+   * @brief acceptsRelay test if both ends offered the relay overlay in their greetings.
+   */
+  bool acceptsRelay() const;
+  /**
+   * @brief setMulticastEnabled offer the multicast text transport in the greeting, see
+   * MulticastTransport.
+   */
+  void setMulticastEnabled(bool enabled);
+  /**
+   * @brief acceptsMulticast test if both ends offered the multicast text transport.
+   */
+  bool acceptsMulticast() const;
   bool sendMessage(QSharedPointer<Message> message);
+  /**
+   * @brief sendFrame queue a complete frame for writing, from any thread. The frame is always
+   * queued; a false return means the outbound queue is above its high-water mark and the caller
+   * should hold back further bulk data until congestionChanged(false).
+   * @param frame the frame to write.
+   * @param lane the priority lane to queue it in.
+   * @return false if the connection is congested.
+   */
+  bool sendFrame(const QByteArray &frame,
+                 OutboundQueue::Lane lane = OutboundQueue::InteractiveLane);
+  /**
+   * @brief sendFrames queue a message, compressed if this peer accepts it, see sendFrame().
+   * @param frames the frames of the message, shared by every recipient.
+   * @return false if the connection is congested.
+   */
+  bool sendFrames(MessageFrames &frames);
+  bool isCongested() const;
+  /**
+   * @brief acceptsCompression test if the peer advertised compression in its greeting.
+   */
+  bool acceptsCompression() const;
+  /**
+   * @brief acceptsAvatarHashes test if the peer advertised avatar hashes in its greeting, peers
+   * that did not get profiles with the avatar inline, see Message::inlineForm().
+   */
+  bool acceptsAvatarHashes() const;
+  /**
+   * @brief acceptsFileTransfers test if the peer advertised chunked file transfers in its greeting,
+   * peers that did not get each file whole in a FileMessage, see FileTransferManager.
+   */
+  bool acceptsFileTransfers() const;
+  /**
+   * @brief rttStats the round trip times measured with PING/PONG, safe to call from any thread.
+   */
+  RttStats rttStats() const;
+
+  static QByteArray messageFrame(const Message &message);
 
 signals:
   void readyForUse();
-  void newMessage(QSharedPointer<Message> &message);
-
-protected:
-  void timerEvent(QTimerEvent *timerEvent) override;
+  void newMessage(QSharedPointer<Message> message);
+  /**
+   * @brief relayedMessage emitted for a relayed message seen for the first time.
+   * @param message the message, its sender is the node it came from originally.
+   * @param frame the RELY frame to forward to the other neighbours.
+   */
+  void relayedMessage(QSharedPointer<Message> message, const QByteArray &frame);
+  /**
+   * @brief relayedPresence emitted for a relayed presence announcement seen for the first time.
+   * @param origin the node that announced itself.
+   * @param frame the RELY frame to forward to the other neighbours.
+   */
+  void relayedPresence(const QString &origin, const QByteArray &frame);
+  /**
+   * @brief multicastFrame emitted for an MCST frame, the multicast transport's control traffic.
+   */
+  void multicastFrame(const QByteArray &payload);
+  /**
+   * @brief closed emitted once when the socket becomes unconnected. It is the last signal the
+   * connection emits, after it the owner may delete it.
+   */
+  void closed();
+  /**
+   * @brief congestionChanged emitted when the outbound queue crosses its high-water mark
+   * (congested) or drains back below its low-water mark.
+   */
+  void congestionChanged(bool congested);
 
 private slots:
   void processReadyRead();
-  void sendPing();
   void sendGreetingMessage();
+  void flushOutbound();
+  void socketStateChanged(QAbstractSocket::SocketState socketState);
 
 private:
-  int readDataIntoBuffer(int maxSize = MaxBufferSize);
-  int dataLengthForCurrentDataType();
-  bool readProtocolHeader();
-  bool hasEnoughData();
-  void processData();
+  void sendPing();
+  void parseCapabilities(const QByteArray &capabilities);
+  void becomeReady();
+  bool processFrame(FrameDecoder::FrameType type, const QByteArray &payload);
+  QSharedPointer<Message> decodeMessage(const QByteArray &payload, const QString &sender);
+  void processMessage(const QByteArray &payload);
+  /**
+   * @brief processPart collect a PART frame, and handle the frame once its last part arrived.
+   * @return false if the connection was aborted.
+   */
+  bool processPart(const QByteArray &payload);
+  void processRelay(const QByteArray &payload);
 
   QString greetingMessage;
   QString username;
-  QTimer pingTimer;
-  QTime pongTime;
-  QByteArray buffer;
+  QHostAddress remoteAddress;
+  QUuid localId;
+  QUuid remoteId;
+  WheelTimer transferTimeout; /**< connect timeout, then armed while a frame is incomplete */
+  WheelTimer pingTimer;
+  WheelTimer pongTimeout;     /**< re-armed by every PONG */
+  WheelTimer capabilitiesTimeout; /**< a peer that sent none by then is from before them */
+  QElapsedTimer rttClock;
+  quint32 pingSequence;  /**< sequence number of the last PING sent */
+  qint64 pingSentAt;     /**< rttClock time of the last PING in microseconds, -1 once answered */
+  mutable QMutex rttMutex;
+  RttStats rtt;          /**< guarded by rttMutex */
+  FrameDecoder decoder;
+  QByteArray partialFrame; /**< the pieces of a split frame received so far */
+  QMutex outboundMutex;
+  OutboundQueue outbound; /**< guarded by outboundMutex */
   ConnectionState state;
-  DataType currentDataType;
-  int numBytesForCurrentDataType;
-  int transferTimerId;
   bool isGreetingMessageSent;
+  bool compressionAccepted;
+  bool avatarHashesAccepted;
+  bool fileTransfersAccepted;
+  bool dialled;   /**< this side opened the connection */
+  bool relayEnabled;
+  bool relayAccepted;
+  bool multicastEnabled;
+  bool multicastAccepted;
+  QAtomicInt congested;
+  QAtomicInt flushScheduled; /**< a flush was posted to the connection's thread */
 
   MessageFactory messageFactory;
 };
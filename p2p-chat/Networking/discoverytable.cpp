@@ -0,0 +1,115 @@
+#include "discoverytable.h"
+
+namespace p2pnetworking {
+
+DiscoveryTable::DiscoveryTable() {
+  clock.start();
+}
+
+bool DiscoveryTable::contains(const QByteArray &key) const {
+  return peers.contains(key);
+}
+
+bool DiscoveryTable::announced(const QByteArray &key, quint32 generation,
+                               const std::function<QString()> &nick,
+                               const std::function<bool(const QString &)> &isConnected) {
+  const qint64 now = clock.elapsed();
+  Peer &peer = peers[key];
+  peer.lastHeard = now;
+
+  // the name is only built when the announcement is new to us, the common case is a lookup
+  if (peer.nick.isEmpty() || peer.generation != generation) {
+    peer.generation = generation;
+    setNick(key, peer, nick());
+    if (isConnected(peer.nick)) {
+      setConnected(peer, now);
+      return false;
+    }
+    if (peer.state == Connected)
+      peer.state = Idle; // renamed, and the client has no connection under the new name
+  }
+
+  switch (peer.state) {
+  case Connected:
+    // a peer connected under another name leaves unnoticed, so that is checked now and then
+    if (now - peer.since < PendingTimeout)
+      return false;
+    if (isConnected(peer.nick)) {
+      peer.since = now;
+      return false;
+    }
+    break;
+  case Pending:
+    if (now - peer.since < PendingTimeout)
+      return false;
+    if (isConnected(peer.nick)) {
+      setConnected(peer, now); // under a name other than the one announced
+      return false;
+    }
+    ++peer.failures;
+    peer.state = Backoff;
+    peer.since = now + qMin(MaxBackoff, MinBackoff << qMin(peer.failures - 1, 6));
+    return false;
+  case Backoff:
+    if (now < peer.since)
+      return false;
+    if (isConnected(peer.nick)) {
+      setConnected(peer, now);
+      return false;
+    }
+    break;
+  case Idle:
+    break;
+  }
+  peer.state = Pending;
+  peer.since = now;
+  return true;
+}
+
+void DiscoveryTable::dialling(const QByteArray &key) {
+  Peer &peer = peers[key];
+  peer.state = Pending;
+  peer.since = clock.elapsed();
+  peer.lastHeard = peer.since;
+}
+
+void DiscoveryTable::connected(const QString &nick) {
+  auto it = peers.find(keysByNick.value(nick));
+  if (it != peers.end())
+    setConnected(*it, clock.elapsed());
+}
+
+void DiscoveryTable::disconnected(const QString &nick) {
+  auto it = peers.find(keysByNick.value(nick));
+  if (it != peers.end() && it->state == Connected)
+    it->state = Idle;
+}
+
+void DiscoveryTable::forget() {
+  const qint64 before = clock.elapsed() - ForgetAfter;
+  for (auto it = peers.begin(); it != peers.end();) {
+    if (it->lastHeard < before && (it->state == Idle || it->state == Backoff)) {
+      keysByNick.remove(it->nick);
+      it = peers.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void DiscoveryTable::setConnected(Peer &peer, qint64 now) {
+  peer.state = Connected;
+  peer.since = now;
+  peer.failures = 0;
+}
+
+void DiscoveryTable::setNick(const QByteArray &key, Peer &peer, const QString &nick) {
+  if (nick == peer.nick)
+    return;
+  if (!peer.nick.isEmpty())
+    keysByNick.remove(peer.nick);
+  peer.nick = nick;
+  keysByNick.insert(nick, key);
+}
+
+} // namespace p2pnetworking
@@ -0,0 +1,94 @@
+#ifndef DISCOVERYTABLE_H
+#define DISCOVERYTABLE_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QString>
+#include <functional>
+
+namespace p2pnetworking {
+
+/**
+ * @brief The DiscoveryTable class records what discovery knows about each announced peer, so that the
+ * stream of beacons and rendezvous announcements about the same peer costs a hash lookup each and
+ * starts at most one connection at a time.
+ *
+ * A peer is dialled when first announced, unless it already connected to us. It is then pending
+ * until the client reports it as a participant, and announcements are ignored meanwhile. A dial
+ * that has not produced a participant after PendingTimeout counts as failed and the peer is left
+ * alone for a backoff that doubles with every failure. A connected peer is only dialled again
+ * once the client reports it has left, or no longer has it when asked.
+ */
+class DiscoveryTable {
+public:
+  /** a dial without a participant after this long failed, in milliseconds */
+  static const qint64 PendingTimeout = 10000;
+  static const qint64 MinBackoff = 1000;
+  static const qint64 MaxBackoff = 60000;
+  /** peers not announced for this long are forgotten, in milliseconds */
+  static const qint64 ForgetAfter = 600000;
+
+  DiscoveryTable();
+
+  /**
+   * @brief contains test if a peer was announced before.
+   */
+  bool contains(const QByteArray &key) const;
+
+  /**
+   * @brief announced record an announcement and decide whether to dial the peer.
+   * @param key identifies the peer: its id, or the announcement itself if it carries none.
+   * @param generation changes whenever the announcement does, e.g. the beacon state counter.
+   * @param nick builds the peer's unique name, only called when the peer or its generation is new.
+   * @param isConnected asked about a peer whose announcement is new, in case it dialled us first,
+   * and before a dial is counted as failed or retried, in case it connected under another name;
+   * a connected peer is checked again every PendingTimeout for the same reason.
+   * @return true if the peer should be dialled now, it is pending from then on.
+   */
+  bool announced(const QByteArray &key, quint32 generation, const std::function<QString()> &nick,
+                 const std::function<bool(const QString &)> &isConnected);
+  /**
+   * @brief dialling record a dial that was not prompted by an announcement.
+   */
+  void dialling(const QByteArray &key);
+
+  /**
+   * @brief connected a participant connected, in either direction.
+   * @param nick its unique name.
+   */
+  void connected(const QString &nick);
+  /**
+   * @brief disconnected a participant left, the next announcement dials it again.
+   * @param nick its unique name.
+   */
+  void disconnected(const QString &nick);
+
+  /**
+   * @brief forget drop the peers that were not announced for ForgetAfter.
+   */
+  void forget();
+
+private:
+  enum State { Idle, Pending, Connected, Backoff };
+  struct Peer {
+    State state = Idle;
+    QString nick;
+    quint32 generation = 0;
+    qint64 since = 0;      /**< when it became pending or was last found connected, or when its
+                              backoff ends */
+    qint64 lastHeard = 0;
+    int failures = 0;      /**< dials in a row that produced no participant */
+  };
+
+  void setConnected(Peer &peer, qint64 now);
+  void setNick(const QByteArray &key, Peer &peer, const QString &nick);
+
+  QElapsedTimer clock;
+  QHash<QByteArray, Peer> peers;
+  QHash<QString, QByteArray> keysByNick;
+};
+
+} // namespace p2pnetworking
+
+#endif
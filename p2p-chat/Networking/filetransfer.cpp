@@ -0,0 +1,238 @@
+#include "filetransfer.h"
+
+#include "compression.h"
+#include "connection.h"
+#include <QDebug>
+#include <QScopedPointer>
+#include <QTimer>
+
+namespace p2pnetworking {
+
+// Chunks stay well below MaxBufferSize so a receiver never buffers more than one of them.
+static const int ChunkSize = 64 * 1024;
+// Older peers drop the connection over a frame larger than their whole receive buffer; the name,
+// room and message header leave this much of it for the file.
+static const qint64 LegacyMaxFileSize = MaxBufferSize - 4 * 1024;
+
+FileTransferManager::FileTransferManager(QObject *parent)
+    : QObject(parent), nextTransferId(1), nextFileNumber(0), pumpScheduled(false) {
+}
+
+FileTransferManager::~FileTransferManager() {
+  qDeleteAll(outgoing);
+  foreach (IncomingTransfer *transfer, incoming) {
+    transfer->file.remove();
+  }
+  qDeleteAll(incoming);
+}
+
+bool FileTransferManager::startTransfer(QSharedPointer<FileMessage> file, const QString &sender,
+                                        const QList<PeerConnection *> &targets) {
+  if (file.isNull() || !file->isOnDisk() || targets.isEmpty())
+    return false;
+
+  // older peers read a type 3 FileMessage, read from disk once for all of them
+  QList<PeerConnection *> streamed;
+  QScopedPointer<MessageFrames> whole;
+  foreach (PeerConnection *connection, targets) {
+    if (connection->acceptsFileTransfers()) {
+      streamed << connection;
+    } else if (file->size() > LegacyMaxFileSize) {
+      qWarning() << "Not sending" << file->filename() << "to" << connection->name()
+                 << "which only accepts files up to" << LegacyMaxFileSize << "bytes";
+    } else {
+      if (!whole)
+        whole.reset(new MessageFrames(*file));
+      connection->sendFrames(*whole);
+    }
+  }
+  if (streamed.isEmpty())
+    return true;
+
+  OutgoingTransfer *transfer = new OutgoingTransfer;
+  transfer->id = nextTransferId++;
+  transfer->sender = sender;
+  transfer->file.setFileName(file->localPath());
+  if (!transfer->file.open(QIODevice::ReadOnly)) {
+    delete transfer;
+    return false;
+  }
+  // archives, images and the like would only cost CPU time to compress again
+  transfer->compressible = !Compression::looksCompressed(transfer->file.peek(16));
+
+  const QByteArray offer = PeerConnection::messageFrame(
+      FileTransferMessage(sender, transfer->id, file->chatroomName(), file->filename(),
+                          transfer->file.size()));
+  // every stage of a transfer goes in the bulk lane, a higher lane would overtake queued chunks
+  foreach (PeerConnection *connection, streamed) {
+    connection->sendFrame(offer, OutboundQueue::BulkLane);
+    transfer->targets << connection;
+    connect(connection, &PeerConnection::congestionChanged, this,
+            &FileTransferManager::connectionCongestionChanged, Qt::UniqueConnection);
+  }
+  outgoing << transfer;
+
+  schedulePump();
+  return true;
+}
+
+void FileTransferManager::handleMessage(PeerConnection *connection,
+                                        QSharedPointer<FileTransferMessage> message) {
+  const IncomingKey key(connection, message->transferId());
+  switch (message->stage()) {
+  case FileTransferMessage::OFFER: {
+    // a repeated identifier replaces whatever was in progress under it
+    dropIncoming(key);
+    if (!storage.isValid() || message->position() < 0)
+      return;
+
+    IncomingTransfer *transfer = new IncomingTransfer;
+    transfer->sender = message->sender();
+    transfer->chatroomName = message->chatroomName();
+    transfer->filename = message->filename();
+    transfer->size = message->position();
+    transfer->received = 0;
+    transfer->file.setFileName(storage.path() + '/' + QString::number(nextFileNumber++));
+    if (!transfer->file.open(QIODevice::WriteOnly)) {
+      delete transfer;
+      return;
+    }
+    incoming.insert(key, transfer);
+    break;
+  }
+  case FileTransferMessage::CHUNK: {
+    IncomingTransfer *transfer = incoming.value(key);
+    if (!transfer)
+      return;
+
+    const QByteArray chunk = message->content();
+    if (message->position() != transfer->received
+        || transfer->received + chunk.size() > transfer->size
+        || transfer->file.write(chunk) != chunk.size()) {
+      dropIncoming(key);
+      return;
+    }
+    transfer->hash.addData(chunk);
+    transfer->received += chunk.size();
+    break;
+  }
+  case FileTransferMessage::DONE: {
+    IncomingTransfer *transfer = incoming.take(key);
+    if (!transfer)
+      return;
+
+    transfer->file.close();
+    if (transfer->received == transfer->size
+        && transfer->hash.result().toHex() == message->content()) {
+      emit fileReceived(QSharedPointer<Message>(
+          new FileMessage(transfer->sender, transfer->chatroomName, transfer->filename,
+                          transfer->file.fileName(), transfer->size)));
+    } else {
+      transfer->file.remove();
+    }
+    delete transfer;
+    break;
+  }
+  case FileTransferMessage::CANCEL:
+    dropIncoming(key);
+    break;
+  }
+}
+
+void FileTransferManager::connectionClosed(PeerConnection *connection) {
+  foreach (const IncomingKey &key, incoming.keys()) {
+    if (key.first == connection)
+      dropIncoming(key);
+  }
+
+  foreach (OutgoingTransfer *transfer, outgoing) {
+    transfer->targets.removeAll(connection);
+  }
+  if (!outgoing.isEmpty())
+    schedulePump();
+}
+
+void FileTransferManager::connectionCongestionChanged(bool congested) {
+  // congestionChanged(true) is emitted from inside sendFrame(), possibly in the middle of pump(),
+  // so resuming always goes through the event loop
+  if (!congested)
+    schedulePump();
+}
+
+void FileTransferManager::schedulePump() {
+  if (!pumpScheduled) {
+    pumpScheduled = true;
+    QTimer::singleShot(0, this, SLOT(pump()));
+  }
+}
+
+void FileTransferManager::pump() {
+  pumpScheduled = false;
+  for (int i = 0; i < outgoing.size();) {
+    OutgoingTransfer *transfer = outgoing.at(i);
+    if (pumpTransfer(transfer)) {
+      ++i;
+    } else {
+      outgoing.removeAt(i);
+      delete transfer;
+    }
+  }
+}
+
+bool FileTransferManager::pumpTransfer(OutgoingTransfer *transfer) {
+  if (transfer->targets.isEmpty())
+    return false;
+
+  while (!transfer->file.atEnd()) {
+    // the slowest target paces the transfer; congestionChanged(false) schedules pump() again
+    foreach (PeerConnection *connection, transfer->targets) {
+      if (connection->isCongested())
+        return true;
+    }
+
+    const qint64 offset = transfer->file.pos();
+    const QByteArray chunk = transfer->file.read(ChunkSize);
+    if (chunk.isEmpty()) {
+      finishTransfer(transfer);
+      return false;
+    }
+    transfer->hash.addData(chunk);
+
+    const FileTransferMessage message(transfer->sender, FileTransferMessage::CHUNK, transfer->id,
+                                      offset, chunk);
+    MessageFrames frames(message, transfer->compressible);
+    foreach (PeerConnection *connection, transfer->targets) {
+      connection->sendFrames(frames);
+    }
+    // a chunk that did not shrink says the rest of the file will not either
+    if (frames.compressionRejected())
+      transfer->compressible = false;
+  }
+
+  finishTransfer(transfer);
+  return false;
+}
+
+void FileTransferManager::finishTransfer(OutgoingTransfer *transfer) {
+  // a short read means the file changed or failed underneath us, so tell the receivers to give up
+  const bool complete = transfer->file.atEnd();
+  const QByteArray frame = PeerConnection::messageFrame(
+      complete ? FileTransferMessage(transfer->sender, FileTransferMessage::DONE, transfer->id,
+                                     transfer->file.pos(), transfer->hash.result().toHex())
+               : FileTransferMessage(transfer->sender, FileTransferMessage::CANCEL, transfer->id, 0));
+  // behind the chunks still queued, the receiver checks the size it got when DONE arrives
+  foreach (PeerConnection *connection, transfer->targets) {
+    connection->sendFrame(frame, OutboundQueue::BulkLane);
+  }
+  transfer->file.close();
+}
+
+void FileTransferManager::dropIncoming(const IncomingKey &key) {
+  IncomingTransfer *transfer = incoming.take(key);
+  if (transfer) {
+    transfer->file.remove();
+    delete transfer;
+  }
+}
+
+} // namespace p2pnetworking
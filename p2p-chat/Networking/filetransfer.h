@@ -0,0 +1,105 @@
+#ifndef FILETRANSFER_H
+#define FILETRANSFER_H
+
+#include "filemessage.h"
+#include "filetransfermessage.h"
+#include <QCryptographicHash>
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QPair>
+#include <QSharedPointer>
+#include <QTemporaryDir>
+
+namespace p2pnetworking {
+
+class PeerConnection;
+
+/**
+ * @brief The FileTransferManager class streams files between peers in fixed size chunks. Outgoing
+ * files are read from disk one chunk at a time while the targets' bulk lanes have room, and
+ * incoming files are written to disk as chunks arrive, so memory use does not depend on the size of
+ * the file.
+ */
+class FileTransferManager : public QObject {
+  Q_OBJECT
+
+public:
+  explicit FileTransferManager(QObject *parent = 0);
+  ~FileTransferManager() override;
+
+  /**
+   * @brief startTransfer begin streaming a file stored on disk to the given connections. Peers
+   * from before chunked transfers get the whole file in one FileMessage instead, if it fits in the
+   * frame they accept.
+   * @param file the file to send, must be on disk.
+   * @param sender the local user's identity.
+   * @param targets the connections to send to.
+   * @return false if the file could not be opened.
+   */
+  bool startTransfer(QSharedPointer<FileMessage> file, const QString &sender,
+                     const QList<PeerConnection *> &targets);
+
+  /**
+   * @brief handleMessage process one step of an incoming transfer.
+   * @param connection the connection the message arrived on.
+   * @param message the transfer message.
+   */
+  void handleMessage(PeerConnection *connection, QSharedPointer<FileTransferMessage> message);
+
+  /**
+   * @brief connectionClosed drop every transfer to or from a connection.
+   * @param connection the connection being removed.
+   */
+  void connectionClosed(PeerConnection *connection);
+
+signals:
+  /**
+   * @brief fileReceived emitted when an incoming file is complete and verified.
+   * @param message a FileMessage referring to the received file on disk.
+   */
+  void fileReceived(QSharedPointer<Message> message);
+
+private slots:
+  void pump();
+  void connectionCongestionChanged(bool congested);
+
+private:
+  struct OutgoingTransfer {
+    quint32 id;
+    QString sender;
+    QFile file;
+    QCryptographicHash hash{QCryptographicHash::Sha1};
+    bool compressible;
+    QList<PeerConnection *> targets; /**< kept current by connectionClosed() */
+  };
+
+  struct IncomingTransfer {
+    QString sender;
+    QString chatroomName;
+    QString filename;
+    qint64 size;
+    qint64 received;
+    QFile file;
+    QCryptographicHash hash{QCryptographicHash::Sha1};
+  };
+
+  typedef QPair<PeerConnection *, quint32> IncomingKey;
+
+  void schedulePump();
+  bool pumpTransfer(OutgoingTransfer *transfer);
+  void finishTransfer(OutgoingTransfer *transfer);
+  void dropIncoming(const IncomingKey &key);
+
+  QList<OutgoingTransfer *> outgoing;
+  QHash<IncomingKey, IncomingTransfer *> incoming;
+  QTemporaryDir storage;
+  quint32 nextTransferId;
+  quint64 nextFileNumber;
+  bool pumpScheduled;
+};
+
+} // namespace p2pnetworking
+
+#endif
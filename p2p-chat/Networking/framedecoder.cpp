@@ -0,0 +1,145 @@
+#include "framedecoder.h"
+
+#include <cstring>
+
+namespace p2pnetworking {
+
+// Every frame starts with a four character type tag and a separator, e.g. "MESG|".
+static const int TagSize = 4;
+static const int HeaderPrefixSize = TagSize + 1;
+// The length field of a frame no larger than INT_MAX fits in 10 digits.
+static const int MaxLengthDigits = 10;
+static const char SeparatorToken = '|';
+// Reserved up front so draining the buffer does not release its allocation.
+static const int InitialCapacity = 16 * 1024;
+
+static FrameDecoder::FrameType typeForTag(const char *tag) {
+  if (std::memcmp(tag, "MESG", TagSize) == 0)
+    return FrameDecoder::MessageFrame;
+  if (std::memcmp(tag, "MESZ", TagSize) == 0)
+    return FrameDecoder::CompressedMessageFrame;
+  if (std::memcmp(tag, "PING", TagSize) == 0)
+    return FrameDecoder::PingFrame;
+  if (std::memcmp(tag, "PONG", TagSize) == 0)
+    return FrameDecoder::PongFrame;
+  if (std::memcmp(tag, "GREE", TagSize) == 0)
+    return FrameDecoder::GreetingFrame;
+  if (std::memcmp(tag, "RELY", TagSize) == 0)
+    return FrameDecoder::RelayFrame;
+  if (std::memcmp(tag, "MCST", TagSize) == 0)
+    return FrameDecoder::MulticastFrame;
+  if (std::memcmp(tag, "HERE", TagSize) == 0)
+    return FrameDecoder::PresenceFrame;
+  if (std::memcmp(tag, "PART", TagSize) == 0)
+    return FrameDecoder::PartFrame;
+  return FrameDecoder::UnknownFrame;
+}
+
+FrameDecoder::FrameDecoder(int maxFrameSize, int maxReadSize)
+    : readPos(0), maxFrameSize(maxFrameSize), maxReadSize(maxReadSize), frameType(UnknownFrame),
+      frameData(nullptr), frameSize(0) {
+  buffer.reserve(InitialCapacity);
+}
+
+void FrameDecoder::setMaxFrameSize(int size) {
+  maxFrameSize = size;
+}
+
+qint64 FrameDecoder::readFrom(QIODevice *device) {
+  // Never pull more than maxReadSize per call, so one read stays bounded even when the socket has
+  // megabytes queued; a larger frame is assembled over several calls. Callers loop until the
+  // device is drained.
+  qint64 available = qMin<qint64>(device->bytesAvailable(), maxReadSize);
+  if (available <= 0)
+    return 0;
+
+  compact(int(available));
+  int oldSize = buffer.size();
+  buffer.resize(oldSize + int(available));
+  qint64 numRead = device->read(buffer.data() + oldSize, available);
+  buffer.resize(oldSize + int(qMax<qint64>(numRead, 0)));
+  return numRead;
+}
+
+void FrameDecoder::append(const char *data, int size) {
+  if (size <= 0)
+    return;
+  compact(size);
+  buffer.append(data, size);
+}
+
+FrameDecoder::Status FrameDecoder::next() {
+  const char *begin = buffer.constData() + readPos;
+  const int available = buffer.size() - readPos;
+  if (available < HeaderPrefixSize)
+    return NeedMoreData;
+
+  FrameType type = typeForTag(begin);
+  if (type == UnknownFrame || begin[TagSize] != SeparatorToken)
+    return ProtocolError;
+
+  const char *lengthBegin = begin + HeaderPrefixSize;
+  const int lengthSearch = qMin(available - HeaderPrefixSize, MaxLengthDigits + 1);
+  const char *lengthEnd =
+      static_cast<const char *>(std::memchr(lengthBegin, SeparatorToken, size_t(lengthSearch)));
+  if (!lengthEnd)
+    return lengthSearch > MaxLengthDigits ? ProtocolError : NeedMoreData;
+  if (lengthEnd == lengthBegin)
+    return ProtocolError;
+
+  qint64 length = 0;
+  for (const char *digit = lengthBegin; digit != lengthEnd; ++digit) {
+    if (*digit < '0' || *digit > '9')
+      return ProtocolError;
+    length = length * 10 + (*digit - '0');
+  }
+  if (length > maxFrameSize)
+    return ProtocolError;
+
+  const int headerSize = int(lengthEnd - begin) + 1;
+  if (available - headerSize < length)
+    return NeedMoreData;
+
+  frameType = type;
+  frameData = begin + headerSize;
+  frameSize = int(length);
+  readPos += headerSize + frameSize;
+  return FrameReady;
+}
+
+FrameDecoder::FrameType FrameDecoder::type() const {
+  return frameType;
+}
+
+QByteArray FrameDecoder::payload() const {
+  return QByteArray::fromRawData(frameData, frameSize);
+}
+
+bool FrameDecoder::hasPartialFrame() const {
+  return buffer.size() > readPos;
+}
+
+void FrameDecoder::clear() {
+  buffer.clear();
+  readPos = 0;
+  frameData = nullptr;
+  frameSize = 0;
+}
+
+void FrameDecoder::compact(int incoming) {
+  if (readPos == 0)
+    return;
+
+  // Slide the unconsumed tail to the front once the consumed prefix dominates the buffer, or
+  // when the incoming bytes would otherwise force a reallocation. Frames therefore always stay
+  // contiguous and never need to be stitched together.
+  const int pending = buffer.size() - readPos;
+  if (pending == 0 || readPos >= pending || buffer.capacity() - buffer.size() < incoming) {
+    if (pending > 0)
+      std::memmove(buffer.data(), buffer.constData() + readPos, size_t(pending));
+    buffer.resize(pending);
+    readPos = 0;
+  }
+}
+
+} // namespace p2pnetworking
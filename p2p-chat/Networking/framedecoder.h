@@ -0,0 +1,98 @@
+#ifndef FRAMEDECODER_H
+#define FRAMEDECODER_H
+
+#include <QByteArray>
+#include <QIODevice>
+
+namespace p2pnetworking {
+
+/**
+ * @brief The FrameDecoder class incrementally splits a peer byte stream into "TYPE|length|payload"
+ * frames. Everything the socket has available is pulled in with one read, separators are found with
+ * memchr, and complete payloads are handed out without being copied out of the receive buffer.
+ */
+class FrameDecoder {
+public:
+  enum FrameType {
+    MessageFrame,
+    CompressedMessageFrame,
+    PingFrame,
+    PongFrame,
+    GreetingFrame,
+    RelayFrame,
+    MulticastFrame,
+    PresenceFrame,
+    PartFrame,
+    UnknownFrame
+  };
+  enum Status { NeedMoreData, FrameReady, ProtocolError };
+
+  /**
+   * @brief FrameDecoder constructor
+   * @param maxFrameSize the largest payload accepted before the stream is treated as corrupt.
+   * @param maxReadSize the most bytes pulled from the device by one readFrom().
+   */
+  FrameDecoder(int maxFrameSize, int maxReadSize);
+
+  /**
+   * @brief setMaxFrameSize change the largest payload accepted, from the next frame on.
+   */
+  void setMaxFrameSize(int size);
+
+  /**
+   * @brief readFrom append everything currently available on the device to the receive buffer.
+   * @param device the socket to drain.
+   * @return the number of bytes read, or -1 on a read error.
+   */
+  qint64 readFrom(QIODevice *device);
+
+  /**
+   * @brief append append raw stream bytes to the receive buffer.
+   * @param data the bytes received.
+   * @param size the number of bytes received.
+   */
+  void append(const char *data, int size);
+
+  /**
+   * @brief next decode the next complete frame.
+   * @return FrameReady when type() and payload() describe a new frame.
+   */
+  Status next();
+
+  /**
+   * @brief type the type of the frame returned by the last successful next().
+   */
+  FrameType type() const;
+
+  /**
+   * @brief payload the payload of the frame returned by the last successful next(). The returned
+   * array references the receive buffer and is only valid until the next call to readFrom(),
+   * append() or clear(); copy it (or let a QByteArray detach) to keep it longer.
+   */
+  QByteArray payload() const;
+
+  /**
+   * @brief hasPartialFrame test if an incomplete frame is waiting for more data.
+   */
+  bool hasPartialFrame() const;
+
+  /**
+   * @brief clear drop all buffered data.
+   */
+  void clear();
+
+private:
+  void compact(int incoming);
+
+  QByteArray buffer;    /**< receive buffer, bytes before readPos are already consumed */
+  int readPos;          /**< start of the first unconsumed byte in buffer */
+  int maxFrameSize;     /**< largest payload accepted */
+  int maxReadSize;      /**< most bytes read by one readFrom() */
+  FrameType frameType;  /**< type of the last decoded frame */
+  const char *frameData; /**< start of the last decoded payload inside buffer */
+  int frameSize;        /**< size of the last decoded payload */
+};
+
+} // namespace p2pnetworking
+
+#endif
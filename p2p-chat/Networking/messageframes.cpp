@@ -0,0 +1,66 @@
+#include "messageframes.h"
+
+#include "compression.h"
+
+namespace p2pnetworking {
+
+static const char SeparatorToken = Message::Separator;
+
+MessageFrames::MessageFrames(const Message &message)
+    : MessageFrames(message, message.isCompressible()) {
+}
+
+MessageFrames::MessageFrames(const Message &message, bool compressible)
+    : message(message), compressedSize(0), compression(compressible ? NotTried : Rejected) {
+}
+
+const QByteArray &MessageFrames::content() {
+  if (data.isNull())
+    data = message.data();
+  return data;
+}
+
+QByteArray MessageFrames::frameFor(bool compressionAccepted) {
+  const QByteArray &content = this->content();
+
+  if (compressionAccepted && compression == NotTried) {
+    const QByteArray payload = Compression::compress(content);
+    if (payload.isNull()) {
+      compression = Rejected;
+    } else {
+      compression = Compressed;
+      compressedSize = payload.size();
+      compressed = frame("MESZ", payload);
+    }
+  }
+  if (compressionAccepted && compression == Compressed) {
+    Compression::recordSent(content.size(), compressedSize);
+    return compressed;
+  }
+
+  if (plain.isNull())
+    plain = frame("MESG", content);
+  return plain;
+}
+
+OutboundQueue::Lane MessageFrames::lane() const {
+  return message.isBulk() ? OutboundQueue::BulkLane : OutboundQueue::InteractiveLane;
+}
+
+bool MessageFrames::compressionRejected() const {
+  return compression == Rejected;
+}
+
+QByteArray MessageFrames::frame(const char *tag, const QByteArray &payload) {
+  QByteArray length = QByteArray::number(payload.size());
+  QByteArray frame;
+  frame.reserve(4 + 1 + length.size() + 1 + payload.size());
+  frame += tag;
+  frame += SeparatorToken;
+  frame += length;
+  frame += SeparatorToken;
+  frame += payload;
+  return frame;
+}
+
+} // namespace p2pnetworking
@@ -0,0 +1,74 @@
+#ifndef MESSAGEFRAMES_H
+#define MESSAGEFRAMES_H
+
+#include "message.h"
+#include "outboundqueue.h"
+#include <QByteArray>
+
+namespace p2pnetworking {
+
+/**
+ * @brief The MessageFrames class the frames for one outgoing message: a plain MESG frame, and a
+ * MESZ frame with a compressed payload for connections that accepted compression. Each is built on
+ * first use and at most once, so a message fanned out to many peers is serialized and compressed
+ * once no matter how many of them receive it.
+ */
+class MessageFrames {
+public:
+  /**
+   * @brief MessageFrames constructor, compression is tried if the message is compressible.
+   * @param message the message, must outlive this object.
+   */
+  explicit MessageFrames(const Message &message);
+  /**
+   * @brief MessageFrames constructor
+   * @param message the message, must outlive this object.
+   * @param compressible false to never try compressing it.
+   */
+  MessageFrames(const Message &message, bool compressible);
+
+  /**
+   * @brief frameFor the frame to send to one connection.
+   * @param compressionAccepted true if the connection accepts compressed frames.
+   * @return the compressed frame if the peer accepts it and it is smaller, else the plain one.
+   */
+  QByteArray frameFor(bool compressionAccepted);
+
+  /**
+   * @brief content the message as carried in a MESG frame, serialized on first use.
+   */
+  const QByteArray &content();
+
+  /**
+   * @brief lane the outbound lane the message belongs in.
+   */
+  OutboundQueue::Lane lane() const;
+
+  /**
+   * @brief compressionRejected test if compression was tried and did not pay off, a hint for
+   * senders of a series of similar messages to stop trying.
+   */
+  bool compressionRejected() const;
+
+  /**
+   * @brief frame build a frame.
+   * @param tag the four character frame type.
+   * @param payload the frame payload.
+   * @return "tag|length|payload".
+   */
+  static QByteArray frame(const char *tag, const QByteArray &payload);
+
+private:
+  enum CompressionState { NotTried, Compressed, Rejected };
+
+  const Message &message;
+  QByteArray data;       /**< message.data(), once needed */
+  QByteArray plain;      /**< the MESG frame, once needed */
+  QByteArray compressed; /**< the MESZ frame, once needed and worthwhile */
+  int compressedSize;    /**< size of the compressed payload */
+  CompressionState compression;
+};
+
+} // namespace p2pnetworking
+
+#endif
@@ -0,0 +1,335 @@
+#include "multicasttransport.h"
+
+#include "messageframes.h"
+#include <QRandomGenerator>
+#include <QtEndian>
+#include <cstring>
+
+namespace p2pnetworking {
+
+const char *const MulticastTransport::Capability = "mcast";
+const char *const MulticastTransport::DefaultGroup = "239.255.45.2";
+
+static const char Magic[] = "P2PM";
+static const char Version = 1;
+static const int HeaderSize = 32;
+static const char SeparatorToken = '|';
+// Sent while running, so receivers can confirm before the first message and notice silence.
+static const int HeartbeatInterval = 1000;
+static const int TickInterval = 250;
+static const qint64 RequestInterval = 500;
+// A gap not repaired by then is given up on, the held messages after it are delivered.
+static const qint64 RepairTimeout = 3000;
+// Heartbeats missed in a row before a receiver falls back to TCP.
+static const qint64 SilenceTimeout = 5 * HeartbeatInterval;
+
+MulticastTransport::MulticastTransport(const QUuid &id, QObject *parent)
+    : QObject(parent), id(id), session(QRandomGenerator::global()->generate()), nextSeq(1),
+      port(DefaultPort), history(HistorySize) {
+  clock.start();
+  heartbeatTimer.setInterval(HeartbeatInterval);
+  tickTimer.setInterval(TickInterval);
+  connect(&socket, &QUdpSocket::readyRead, this, &MulticastTransport::readDatagrams);
+  connect(&heartbeatTimer, &QTimer::timeout, this, &MulticastTransport::sendHeartbeat);
+  connect(&tickTimer, &QTimer::timeout, this, &MulticastTransport::tick);
+}
+
+bool MulticastTransport::start(const QHostAddress &group, quint16 port) {
+  stop();
+  this->group = group.isNull() ? QHostAddress(QString::fromLatin1(DefaultGroup)) : group;
+  this->port = port ? port : DefaultPort;
+  // an IPv4 group can only be joined by a socket bound to IPv4
+  if (!socket.bind(QHostAddress::AnyIPv4, this->port,
+                   QUdpSocket::ShareAddress | QUdpSocket::ReuseAddressHint))
+    return false;
+  socket.setSocketOption(QAbstractSocket::MulticastTtlOption, 1);
+  joinGroup();
+  heartbeatTimer.start();
+  tickTimer.start();
+  return true;
+}
+
+void MulticastTransport::stop() {
+  heartbeatTimer.stop();
+  tickTimer.stop();
+  socket.close();
+  interfaces.clear();
+  // receivers expect nothing more from the group, they notice and fall back to TCP
+  receivers.clear();
+  for (auto it = senders.begin(); it != senders.end(); ++it)
+    it->mode = Sender::Unheard;
+}
+
+bool MulticastTransport::isRunning() const {
+  return socket.state() == QAbstractSocket::BoundState;
+}
+
+qint64 MulticastTransport::send(const QByteArray &content) {
+  if (!isRunning() || content.size() > MaxContentSize)
+    return -1;
+  const quint32 seq = nextSeq++;
+  const QByteArray data = datagram(Data, seq, content);
+  history[int(seq % HistorySize)] = data;
+  return writeDatagram(data);
+}
+
+bool MulticastTransport::covers(const QUuid &peer) const {
+  return receivers.contains(peer);
+}
+
+void MulticastTransport::peerJoined(const QUuid &peer, const QString &nick) {
+  Sender &sender = senders[peer];
+  sender.nick = nick;
+}
+
+void MulticastTransport::peerLeft(const QUuid &peer) {
+  senders.remove(peer);
+  receivers.remove(peer);
+}
+
+void MulticastTransport::handleFrame(const QUuid &peer, const QByteArray &payload) {
+  const int separator = payload.indexOf(SeparatorToken);
+  const QByteArray command = payload.left(separator);
+  const QByteArray argument = separator < 0 ? QByteArray() : payload.mid(separator + 1);
+
+  if (command == "hear") {
+    // the peer hears us in the group: from the next message on it gets them only from there
+    if (!isRunning() || !senders.contains(peer))
+      return;
+    receivers.insert(peer);
+    sendControl(peer, "from|" + QByteArray::number(nextSeq));
+  } else if (command == "lost") {
+    // repaired up to now, and the messages after that go over TCP
+    receivers.remove(peer);
+    repair(peer, argument.toUInt(), nextSeq - 1);
+    sendControl(peer, "tcp|" + QByteArray::number(nextSeq));
+  } else if (command == "nack") {
+    const QList<QByteArray> range = argument.split(SeparatorToken);
+    if (range.size() == 2 && receivers.contains(peer))
+      repair(peer, range.at(0).toUInt(), range.at(1).toUInt());
+  } else if (command == "repr") {
+    process(argument, false);
+  } else if (command == "tcp") {
+    auto it = senders.find(peer);
+    if (it == senders.end() || it->mode != Sender::Lost)
+      return;
+    // the repairs are in, what is still missing is given up on
+    it->held.clear();
+    it->next = argument.toUInt();
+    it->mode = Sender::Unheard;
+  } else if (command == "from") {
+    auto it = senders.find(peer);
+    if (it == senders.end() || it->mode != Sender::Confirming)
+      return;
+    const quint32 from = argument.toUInt();
+    it->mode = Sender::Active;
+    it->next = from;
+    it->latest = qMax(it->latest, from - 1);
+    it->lastHeard = clock.elapsed();
+    it->gapSince = -1;
+    // what was held while confirming and is older came over TCP
+    while (!it->held.isEmpty() && it->held.firstKey() < from)
+      it->held.erase(it->held.begin());
+    deliverReady(*it);
+  }
+}
+
+void MulticastTransport::readDatagrams() {
+  while (socket.hasPendingDatagrams()) {
+    QByteArray datagram;
+    datagram.resize(int(socket.pendingDatagramSize()));
+    if (socket.readDatagram(datagram.data(), datagram.size()) == -1)
+      continue;
+    process(datagram, true);
+  }
+}
+
+void MulticastTransport::sendHeartbeat() {
+  writeDatagram(datagram(Heartbeat, nextSeq - 1, QByteArray()));
+  // interfaces come and go, joining one twice fails harmlessly
+  joinGroup();
+}
+
+void MulticastTransport::tick() {
+  const qint64 now = clock.elapsed();
+  for (auto it = senders.begin(); it != senders.end(); ++it) {
+    Sender &sender = *it;
+    if (sender.mode == Sender::Confirming && now - sender.lastRequest >= RequestInterval * 4) {
+      sender.mode = Sender::Unheard; // asked again when the peer is next heard
+      sender.held.clear();
+    }
+    if (sender.mode != Sender::Active)
+      continue;
+
+    if (now - sender.lastHeard > SilenceTimeout) {
+      // repaired from next on over TCP, and later messages come over TCP again
+      sendControl(it.key(), "lost|" + QByteArray::number(sender.next));
+      sender.mode = Sender::Lost;
+      sender.held.clear();
+      sender.gapSince = -1;
+      continue;
+    }
+    if (sender.next > sender.latest) {
+      sender.gapSince = -1;
+      continue;
+    }
+    if (sender.gapSince < 0) {
+      sender.gapSince = now;
+      sender.lastRequest = 0;
+    }
+    if (now - sender.gapSince > RepairTimeout) {
+      sender.next = sender.held.isEmpty() ? sender.latest + 1 : sender.held.firstKey();
+      sender.gapSince = -1;
+      deliverReady(sender);
+    } else if (now - sender.lastRequest >= RequestInterval) {
+      const quint32 last = sender.held.isEmpty() ? sender.latest : sender.held.firstKey() - 1;
+      sendControl(it.key(), "nack|" + QByteArray::number(sender.next) + SeparatorToken
+                                + QByteArray::number(last));
+      sender.lastRequest = now;
+    }
+  }
+}
+
+QByteArray MulticastTransport::datagram(Kind kind, quint32 seq, const QByteArray &content) const {
+  QByteArray data(HeaderSize, '\0');
+  char *out = data.data();
+  std::memcpy(out, Magic, 4);
+  out[4] = Version;
+  out[5] = char(kind);
+  qToBigEndian(session, out + 8);
+  qToBigEndian(seq, out + 12);
+  std::memcpy(out + 16, id.toRfc4122().constData(), 16);
+  data += content;
+  return data;
+}
+
+qint64 MulticastTransport::writeDatagram(const QByteArray &datagram) {
+  if (!isRunning())
+    return 0;
+  // once per interface, however many peers are listening
+  qint64 written = 0;
+  foreach (const QNetworkInterface &interface, interfaces) {
+    socket.setMulticastInterface(interface);
+    written += qMax<qint64>(0, socket.writeDatagram(datagram, group, port));
+  }
+  return written;
+}
+
+void MulticastTransport::joinGroup() {
+  interfaces.clear();
+  const QNetworkInterface::InterfaceFlags flags =
+      QNetworkInterface::IsUp | QNetworkInterface::IsRunning | QNetworkInterface::CanMulticast;
+  foreach (const QNetworkInterface &interface, QNetworkInterface::allInterfaces()) {
+    if ((interface.flags() & flags) != flags || (interface.flags() & QNetworkInterface::IsLoopBack))
+      continue;
+    foreach (const QNetworkAddressEntry &entry, interface.addressEntries()) {
+      if (entry.ip().protocol() == QAbstractSocket::IPv4Protocol) {
+        interfaces << interface;
+        socket.joinMulticastGroup(group, interface);
+        break;
+      }
+    }
+  }
+}
+
+void MulticastTransport::process(const QByteArray &datagram, bool viaGroup) {
+  if (datagram.size() < HeaderSize || std::memcmp(datagram.constData(), Magic, 4) != 0
+      || datagram.at(4) != Version)
+    return;
+  const char *in = datagram.constData();
+  const QUuid peer = QUuid::fromRfc4122(QByteArray::fromRawData(in + 16, 16));
+  auto it = senders.find(peer);
+  if (peer == id || it == senders.end())
+    return; // our own, or from a node that is not a participant
+  Sender &sender = *it;
+  const Kind kind = Kind(in[5]);
+  const quint32 peerSession = qFromBigEndian<quint32>(in + 8);
+  const quint32 seq = qFromBigEndian<quint32>(in + 12);
+
+  if (peerSession != sender.session) {
+    if (!viaGroup)
+      return; // a repair from a run that is over
+    // a restarted peer knows nothing about us, start over
+    sender.session = peerSession;
+    sender.mode = Sender::Unheard;
+    sender.next = 0;
+    sender.latest = 0;
+    sender.held.clear();
+  }
+  const qint64 now = clock.elapsed();
+  if (viaGroup)
+    sender.lastHeard = now;
+
+  switch (sender.mode) {
+  case Sender::Lost:
+    // only the repairs count until the sender says where TCP took over
+    if (!viaGroup && kind == Data)
+      accept(sender, seq, datagram.mid(HeaderSize));
+    return;
+  case Sender::Unheard:
+    if (!viaGroup)
+      return;
+    sendControl(peer, "hear");
+    sender.mode = Sender::Confirming;
+    sender.lastRequest = now;
+    break;
+  default:
+    break;
+  }
+  if (kind == Heartbeat) {
+    sender.latest = qMax(sender.latest, seq);
+    return;
+  }
+  if (kind == Data)
+    accept(sender, seq, datagram.mid(HeaderSize));
+}
+
+void MulticastTransport::accept(Sender &sender, quint32 seq, const QByteArray &content) {
+  sender.latest = qMax(sender.latest, seq);
+  if (sender.mode == Sender::Confirming) {
+    // kept until "from" says which of them did not come over TCP
+    if (sender.held.size() < HistorySize)
+      sender.held.insert(seq, content);
+    return;
+  }
+  if (seq < sender.next || sender.held.contains(seq))
+    return;
+  sender.held.insert(seq, content);
+  deliverReady(sender);
+}
+
+void MulticastTransport::deliverReady(Sender &sender) {
+  if (sender.mode != Sender::Active && sender.mode != Sender::Lost)
+    return;
+  while (!sender.held.isEmpty() && sender.held.firstKey() == sender.next) {
+    const QByteArray content = sender.held.take(sender.next);
+    ++sender.next;
+    const int pos = content.indexOf(SeparatorToken);
+    if (pos < 0)
+      continue;
+    QSharedPointer<Message> message =
+        messageFactory.create(sender.nick, content.mid(pos + 1), content.left(pos).toInt());
+    if (!message.isNull())
+      emit messageReceived(message);
+  }
+}
+
+void MulticastTransport::sendControl(const QUuid &peer, const QByteArray &payload) {
+  emit frameForPeer(peer, MessageFrames::frame("MCST", payload));
+}
+
+void MulticastTransport::repair(const QUuid &peer, quint32 first, quint32 last) {
+  if (last >= nextSeq)
+    last = nextSeq - 1;
+  // only what is still in the history, the receiver gives up on the rest
+  first = qMax(first, 1u);
+  if (last >= quint32(HistorySize) && first < last - HistorySize + 1)
+    first = last - HistorySize + 1;
+  for (quint32 seq = first; seq <= last && seq != 0; ++seq) {
+    const QByteArray &data = history.at(int(seq % HistorySize));
+    if (data.size() >= HeaderSize && qFromBigEndian<quint32>(data.constData() + 12) == seq)
+      sendControl(peer, "repr|" + data);
+  }
+}
+
+} // namespace p2pnetworking
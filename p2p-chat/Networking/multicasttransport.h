@@ -0,0 +1,152 @@
+#ifndef MULTICASTTRANSPORT_H
+#define MULTICASTTRANSPORT_H
+
+#include "message.h"
+#include "messagefactory.h"
+#include <QElapsedTimer>
+#include <QHash>
+#include <QHostAddress>
+#include <QList>
+#include <QMap>
+#include <QNetworkInterface>
+#include <QObject>
+#include <QSet>
+#include <QTimer>
+#include <QUdpSocket>
+#include <QUuid>
+#include <QVector>
+
+namespace p2pnetworking {
+
+/**
+ * @brief The MulticastTransport class a fast path for public text: a message is sent once to a
+ * multicast group instead of once per peer, with a sequence number per sender, and what a receiver
+ * misses is repaired over the peer's TCP connection. Offered during the greeting as the "mcast"
+ * capability.
+ *
+ * A receiver only takes a peer's messages from the group once it has heard the peer there: it
+ * sends "hear" over TCP, the sender answers "from|seq" with the first sequence number it no longer
+ * sends that receiver over TCP, and delivers in order from there. Gaps, noticed from later
+ * messages or from the heartbeat every sender multicasts, are requested with "nack|first|last" and
+ * resent as "repr|datagram". A receiver that stops hearing a sender sends "lost|seq", is repaired
+ * from there up to "tcp|seq", after which it gets the sender's messages over TCP again until it
+ * hears the sender once more. All of these travel in MCST frames.
+ *
+ * A datagram is "P2PM", version, kind (data or heartbeat), two reserved bytes, the sender's session
+ * and sequence number as 32 bit big endian integers, its 16 byte id, then for data the message as
+ * in a MESG frame. The session changes with every run, so a restarted sender is not mistaken for a
+ * replay. Network thread only.
+ */
+class MulticastTransport : public QObject {
+  Q_OBJECT
+
+public:
+  /** the capability token advertised in the greeting */
+  static const char *const Capability;
+  static const char *const DefaultGroup;
+  static const quint16 DefaultPort = 45002;
+  /** larger messages go over TCP, so a datagram is never fragmented */
+  static const int MaxContentSize = 1200;
+  /** sent datagrams kept for repair */
+  static const int HistorySize = 1024;
+
+  /**
+   * @brief MulticastTransport constructor, nothing is sent or received until start().
+   * @param id this node's id.
+   * @param parent the owner.
+   */
+  explicit MulticastTransport(const QUuid &id, QObject *parent = nullptr);
+
+  /**
+   * @brief start join the group on every multicast capable interface.
+   * @param group the IPv4 group, DefaultGroup if null.
+   * @param port the port, DefaultPort if 0.
+   * @return false if the socket could not be bound.
+   */
+  bool start(const QHostAddress &group = QHostAddress(), quint16 port = 0);
+  void stop();
+  bool isRunning() const;
+
+  /**
+   * @brief send multicast a public message.
+   * @param content the message as in a MESG frame.
+   * @return the bytes written, or -1 if the message is not for this transport and must be sent
+   * over TCP instead.
+   */
+  qint64 send(const QByteArray &content);
+  /**
+   * @brief covers test if a peer receives this node's messages from the group, and so must not
+   * get them over TCP as well.
+   */
+  bool covers(const QUuid &peer) const;
+
+  /**
+   * @brief peerJoined a participant that accepts the transport connected.
+   * @param peer its id.
+   * @param nick its unique name, the sender of its messages.
+   */
+  void peerJoined(const QUuid &peer, const QString &nick);
+  void peerLeft(const QUuid &peer);
+  /**
+   * @brief handleFrame process an MCST frame from a peer.
+   */
+  void handleFrame(const QUuid &peer, const QByteArray &payload);
+
+signals:
+  /**
+   * @brief frameForPeer emitted to send a frame over a peer's TCP connection.
+   */
+  void frameForPeer(const QUuid &peer, const QByteArray &frame);
+  void messageReceived(QSharedPointer<Message> message);
+
+private slots:
+  void readDatagrams();
+  void sendHeartbeat();
+  void tick();
+
+private:
+  enum Kind { Data = 0, Heartbeat = 1 };
+
+  /** what this node knows about another node's messages */
+  struct Sender {
+    /** Lost: no longer heard, waiting for the repairs and "tcp|seq" */
+    enum Mode { Unheard, Confirming, Active, Lost };
+    QString nick;
+    Mode mode = Unheard;
+    quint32 session = 0;
+    quint32 next = 0;     /**< the first sequence number not delivered yet */
+    quint32 latest = 0;   /**< the highest sequence number known to exist */
+    QMap<quint32, QByteArray> held; /**< received out of order, waiting for the gap to close */
+    qint64 lastHeard = 0;
+    qint64 gapSince = -1; /**< when the current gap was noticed, -1 without one */
+    qint64 lastRequest = 0; /**< when "hear" or the last nack was sent */
+  };
+
+  QByteArray datagram(Kind kind, quint32 seq, const QByteArray &content) const;
+  qint64 writeDatagram(const QByteArray &datagram);
+  void joinGroup();
+  void process(const QByteArray &datagram, bool viaGroup);
+  void accept(Sender &sender, quint32 seq, const QByteArray &content);
+  void deliverReady(Sender &sender);
+  void sendControl(const QUuid &peer, const QByteArray &payload);
+  void repair(const QUuid &peer, quint32 first, quint32 last);
+
+  QUuid id;
+  quint32 session;
+  quint32 nextSeq;   /**< the sequence number of the next message sent */
+  QUdpSocket socket;
+  QHostAddress group;
+  quint16 port;
+  QList<QNetworkInterface> interfaces;
+  QVector<QByteArray> history; /**< sent datagrams, by sequence number modulo HistorySize */
+  QHash<QUuid, Sender> senders;
+  QSet<QUuid> receivers; /**< peers that take our messages from the group */
+  QTimer heartbeatTimer;
+  QTimer tickTimer;
+  QElapsedTimer clock;
+  MessageFactory messageFactory;
+};
+
+} // namespace p2pnetworking
+
+#endif
@@ -0,0 +1,92 @@
+#include "outboundqueue.h"
+
+namespace p2pnetworking {
+
+const char OutboundQueue::MorePartsFlag;
+const char OutboundQueue::LastPartFlag;
+
+OutboundQueue::OutboundQueue() : currentOffset(0), splitOffset(0), partSize(0), totalBytes(0) {
+}
+
+void OutboundQueue::setPartSize(int size) {
+  partSize = qMax(0, size);
+}
+
+void OutboundQueue::enqueue(const QByteArray &frame, Lane lane) {
+  if (frame.isEmpty())
+    return;
+  lanes[lane].enqueue(frame);
+  totalBytes += frame.size();
+}
+
+const char *OutboundQueue::peek(int maxSize, int *size) {
+  if (currentOffset >= current.size()) {
+    // frames are never interleaved on the wire, so lanes are only consulted between frames; a bulk
+    // frame sent in parts lets the other lanes in after every part
+    current.clear();
+    currentOffset = 0;
+    for (int lane = 0; lane < LaneCount; ++lane) {
+      if (lane == BulkLane && !splitting.isEmpty()) {
+        nextPart();
+        break;
+      }
+      if (!lanes[lane].isEmpty()) {
+        current = lanes[lane].dequeue();
+        if (lane == BulkLane && partSize > 0 && current.size() > partSize) {
+          splitting = current;
+          splitOffset = 0;
+          nextPart();
+        }
+        break;
+      }
+    }
+    if (current.isEmpty()) {
+      *size = 0;
+      return nullptr;
+    }
+  }
+
+  *size = qMin(maxSize, current.size() - currentOffset);
+  return current.constData() + currentOffset;
+}
+
+void OutboundQueue::consume(int size) {
+  currentOffset += size;
+  totalBytes -= size;
+}
+
+qint64 OutboundQueue::queuedBytes() const {
+  return totalBytes;
+}
+
+bool OutboundQueue::isEmpty() const {
+  return totalBytes == 0;
+}
+
+void OutboundQueue::clear() {
+  for (int lane = 0; lane < LaneCount; ++lane)
+    lanes[lane].clear();
+  current.clear();
+  currentOffset = 0;
+  splitting.clear();
+  splitOffset = 0;
+  totalBytes = 0;
+}
+
+void OutboundQueue::nextPart() {
+  const int size = qMin(partSize, splitting.size() - splitOffset);
+  const bool last = splitOffset + size == splitting.size();
+  current = "PART|" + QByteArray::number(size + 1) + '|';
+  // the part's own header and flag are written on top of the frame's bytes
+  totalBytes += current.size() + 1;
+  current.reserve(current.size() + 1 + size);
+  current += last ? LastPartFlag : MorePartsFlag;
+  current.append(splitting.constData() + splitOffset, size);
+  splitOffset += size;
+  if (last) {
+    splitting.clear();
+    splitOffset = 0;
+  }
+}
+
+} // namespace p2pnetworking
@@ -0,0 +1,78 @@
+#ifndef OUTBOUNDQUEUE_H
+#define OUTBOUNDQUEUE_H
+
+#include <QByteArray>
+#include <QQueue>
+
+namespace p2pnetworking {
+
+/**
+ * @brief The OutboundQueue class holds the frames waiting to be written to one connection, in
+ * priority lanes. Frames are handed out a slice at a time so the socket's own buffer stays small,
+ * and whenever a frame completes the next one is taken from the highest priority lane that has
+ * data. A PONG or a line of text therefore waits for at most the rest of the frame on the wire,
+ * never for everything queued behind it. For peers that reassemble them, large bulk frames go out
+ * as a series of PART frames, so that wait is one part rather than a whole inline image.
+ */
+class OutboundQueue {
+public:
+  enum Lane { ControlLane, InteractiveLane, BulkLane, LaneCount };
+
+  // The first payload byte of a PART frame, the rest is the next piece of the original frame.
+  static const char MorePartsFlag = '+';
+  static const char LastPartFlag = '.';
+
+  OutboundQueue();
+
+  /**
+   * @brief setPartSize send bulk frames larger than size as PART frames carrying at most size
+   * bytes each. 0, the default, sends every frame whole, as peers that do not reassemble parts
+   * need. Set it before the first frame is queued.
+   * @param size the largest piece of a frame in one part.
+   */
+  void setPartSize(int size);
+
+  /**
+   * @brief enqueue add a complete frame to the end of a lane.
+   * @param frame the frame, it is kept implicitly shared until written.
+   * @param lane the lane to add it to.
+   */
+  void enqueue(const QByteArray &frame, Lane lane);
+
+  /**
+   * @brief peek retrieve the next bytes to write, without consuming them.
+   * @param maxSize the largest slice wanted.
+   * @param size receives the size of the returned slice.
+   * @return a pointer to the slice, or nullptr if the queue is empty.
+   */
+  const char *peek(int maxSize, int *size);
+
+  /**
+   * @brief consume mark bytes returned by peek() as written.
+   * @param size the number of bytes written.
+   */
+  void consume(int size);
+
+  /**
+   * @brief queuedBytes the number of bytes not yet written.
+   */
+  qint64 queuedBytes() const;
+
+  bool isEmpty() const;
+  void clear();
+
+private:
+  void nextPart();
+
+  QQueue<QByteArray> lanes[LaneCount]; /**< frames not yet started, per lane */
+  QByteArray current;                  /**< the frame or part being written */
+  int currentOffset;                   /**< bytes of current already written */
+  QByteArray splitting;                /**< the bulk frame being sent in parts */
+  int splitOffset;                     /**< bytes of splitting already put in parts */
+  int partSize;                        /**< largest piece per part, 0 to never split */
+  qint64 totalBytes;                   /**< bytes not yet written, including current */
+};
+
+} // namespace p2pnetworking
+
+#endif
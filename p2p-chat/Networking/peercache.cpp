@@ -0,0 +1,171 @@
+#include "peercache.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <algorithm>
+
+namespace p2pnetworking {
+
+static const int FormatVersion = 1;
+
+PeerCache::PeerCache(const QString &fileName)
+    : fileName(fileName.isEmpty() ? defaultFileName() : fileName), serverPort(0), dirty(false) {
+}
+
+QString PeerCache::defaultFileName() {
+  return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)
+         + QStringLiteral("/peers.json");
+}
+
+void PeerCache::load() {
+  entries.clear();
+  serverPort = 0;
+  selfId = QUuid();
+  dirty = false;
+
+  QFile file(fileName);
+  if (!file.open(QIODevice::ReadOnly))
+    return;
+  const QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+  if (root.value("version").toInt() != FormatVersion)
+    return;
+
+  serverPort = quint16(root.value("port").toInt());
+  selfId = QUuid(root.value("self").toString());
+  foreach (const QJsonValue &value, root.value("peers").toArray()) {
+    const QJsonObject object = value.toObject();
+    Entry entry;
+    entry.id = QUuid(object.value("id").toString());
+    entry.address = QHostAddress(object.value("address").toString());
+    entry.port = quint16(object.value("port").toInt());
+    entry.lastSeen = qint64(object.value("lastSeen").toDouble());
+    if (!entry.id.isNull() && !entry.address.isNull() && entry.port != 0)
+      entries.insert(entry.id, entry);
+  }
+  expire(QDateTime::currentMSecsSinceEpoch());
+}
+
+bool PeerCache::save() {
+  if (!dirty)
+    return true;
+  expire(QDateTime::currentMSecsSinceEpoch());
+
+  QJsonArray peers;
+  foreach (const Entry &entry, entries) {
+    QJsonObject object;
+    object.insert("id", entry.id.toString());
+    object.insert("address", entry.address.toString());
+    object.insert("port", entry.port);
+    object.insert("lastSeen", double(entry.lastSeen));
+    peers.append(object);
+  }
+  QJsonObject root;
+  root.insert("version", FormatVersion);
+  root.insert("port", serverPort);
+  if (!selfId.isNull())
+    root.insert("self", selfId.toString());
+  root.insert("peers", peers);
+
+  QDir().mkpath(QFileInfo(fileName).absolutePath());
+  // a crash while writing leaves the previous file in place
+  QSaveFile file(fileName);
+  if (!file.open(QIODevice::WriteOnly))
+    return false;
+  file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+  if (!file.commit())
+    return false;
+  dirty = false;
+  return true;
+}
+
+void PeerCache::seen(const QUuid &id, const QHostAddress &address, quint16 port) {
+  const qint64 now = QDateTime::currentMSecsSinceEpoch();
+  auto it = entries.find(id);
+  if (it != entries.end()) {
+    it->address = address;
+    it->port = port;
+    it->lastSeen = now;
+  } else {
+    // a node that came back with another id replaces its old entry
+    for (auto old = entries.begin(); old != entries.end();) {
+      if (old->port == port && old->address == address)
+        old = entries.erase(old);
+      else
+        ++old;
+    }
+    Entry entry;
+    entry.id = id;
+    entry.address = address;
+    entry.port = port;
+    entry.lastSeen = now;
+    entries.insert(id, entry);
+  }
+  dirty = true;
+}
+
+QList<PeerCache::Entry> PeerCache::recent(qint64 maxAge, int limit) const {
+  const qint64 since = QDateTime::currentMSecsSinceEpoch() - maxAge;
+  QList<Entry> recent;
+  foreach (const Entry &entry, entries) {
+    if (entry.lastSeen >= since)
+      recent << entry;
+  }
+  std::sort(recent.begin(), recent.end(),
+            [](const Entry &a, const Entry &b) { return a.lastSeen > b.lastSeen; });
+  return recent.mid(0, limit);
+}
+
+quint16 PeerCache::localPort() const {
+  return serverPort;
+}
+
+void PeerCache::setLocalPort(quint16 port) {
+  if (port != serverPort) {
+    serverPort = port;
+    dirty = true;
+  }
+}
+
+QUuid PeerCache::localId() {
+  if (lockFile.isNull()) {
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+    lockFile.reset(new QLockFile(fileName + QStringLiteral(".lock")));
+    // held for the whole run, the lock of a crashed run is recognised by its process id
+    lockFile->setStaleLockTime(0);
+    lockFile->tryLock(0);
+  }
+  if (!lockFile->isLocked())
+    return QUuid();
+  if (selfId.isNull()) {
+    selfId = QUuid::createUuid();
+    dirty = true;
+  }
+  return selfId;
+}
+
+void PeerCache::expire(qint64 now) {
+  for (auto it = entries.begin(); it != entries.end();) {
+    if (it->lastSeen < now - MaxAge) {
+      it = entries.erase(it);
+      dirty = true;
+    } else {
+      ++it;
+    }
+  }
+  if (entries.size() > MaxEntries) {
+    QList<Entry> kept = recent(MaxAge, MaxEntries);
+    entries.clear();
+    foreach (const Entry &entry, kept)
+      entries.insert(entry.id, entry);
+    dirty = true;
+  }
+}
+
+} // namespace p2pnetworking
@@ -0,0 +1,93 @@
+#ifndef PEERCACHE_H
+#define PEERCACHE_H
+
+#include <QHash>
+#include <QHostAddress>
+#include <QList>
+#include <QLockFile>
+#include <QScopedPointer>
+#include <QUuid>
+
+namespace p2pnetworking {
+
+/**
+ * @brief The PeerCache class the peers heard from recently, kept on disk between runs so a node can
+ * dial them as soon as it starts instead of waiting for their next beacon. It also remembers the
+ * local server port, which is reused when it is free so that the entries other nodes keep about
+ * this one stay valid, and the node's own id. Entries are aged out after MaxAge.
+ */
+class PeerCache {
+public:
+  struct Entry {
+    QUuid id;
+    QHostAddress address;
+    quint16 port = 0;
+    qint64 lastSeen = 0; /**< milliseconds since the epoch */
+  };
+
+  /** entries not heard from for this long are dropped, in milliseconds */
+  static const qint64 MaxAge = 7 * 24 * 3600 * 1000LL;
+  /** the oldest entries are dropped beyond this many */
+  static const int MaxEntries = 256;
+
+  /**
+   * @brief PeerCache constructor, nothing is read until load().
+   * @param fileName the cache file, defaultFileName() if empty.
+   */
+  explicit PeerCache(const QString &fileName = QString());
+
+  /**
+   * @brief defaultFileName peers.json in the application's data directory.
+   */
+  static QString defaultFileName();
+
+  /**
+   * @brief load replace the entries with the file's, a missing or corrupt file leaves it empty.
+   */
+  void load();
+  /**
+   * @brief save write the entries out if anything changed since the last load or save.
+   * @return false if the file could not be written.
+   */
+  bool save();
+
+  /**
+   * @brief seen record that a peer was heard from just now.
+   * @param id the peer's id.
+   * @param address the address it can be reached at.
+   * @param port its server port.
+   */
+  void seen(const QUuid &id, const QHostAddress &address, quint16 port);
+  /**
+   * @brief recent the entries heard from within a given time, most recent first.
+   * @param maxAge the age limit, in milliseconds.
+   * @param limit the largest number of entries returned.
+   */
+  QList<Entry> recent(qint64 maxAge, int limit) const;
+
+  /**
+   * @brief localPort the server port used by the last run, 0 if unknown.
+   */
+  quint16 localPort() const;
+  void setLocalPort(quint16 port);
+  /**
+   * @brief localId the id of this node, created on first use and kept across runs. The file is
+   * locked for as long as the cache exists, a second instance sharing it gets a null id and must
+   * make up one of its own, so the two do not take each other for themselves.
+   */
+  QUuid localId();
+
+private:
+  void expire(qint64 now);
+
+  QString fileName;
+  QHash<QUuid, Entry> entries;
+  quint16 serverPort;
+  QUuid selfId;
+  QScopedPointer<QLockFile> lockFile; /**< held while this instance owns selfId */
+  bool dirty; /**< changed since the last load or save */
+};
+
+} // namespace p2pnetworking
+
+#endif
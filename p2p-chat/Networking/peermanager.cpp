@@ -50,31 +50,99 @@
 
 #include <QtNetwork>
 
+#include "beacon.h"
 #include "client.h"
-#include "connection.h"
 #include "peermanager.h"
-#include <QJsonArray>
-#include <QJsonDocument>
-#include <QJsonObject>
+#include <QRandomGenerator>
 
 namespace p2pnetworking {
 
-static const qint32 BroadcastInterval = 2000;
+// Beacons start fast so a new node is found at once, then back off to the slow rate, where a
+// floor of a few hundred nodes costs each of them a datagram every few tens of milliseconds.
+static const qint32 FastBroadcastInterval = 250;
+static const qint32 SlowBroadcastInterval = 15000;
+/** each delay is moved by up to this fraction either way */
+static const qreal BroadcastJitter = 0.25;
+/** the longest wait before answering a new peer */
+static const qint32 AnswerDelay = 1000;
 static const unsigned broadcastPort = 45001;
-static const QString centralServerUrl = QStringLiteral("http://cppchat.dpwlabs.com/chat");
-static const qint32 CentralInterval = 600;
+/** how often the peer cache is written while peers are heard from */
+static const qint32 CacheSaveInterval = 60000;
+/** cached peers are dialled at start if they were heard from within this time */
+static const qint64 CachedPeerAge = 24 * 3600 * 1000LL;
+/** the most cached peers dialled at start */
+static const int MaxCachedDials = 32;
+
+// The server port of a text beacon, "name|port|address", or 0. It is found without splitting the
+// datagram, so text copies of binary beacons cost next to nothing.
+static quint16 legacyBeaconPort(const QByteArray &datagram) {
+  const int end = datagram.lastIndexOf('|');
+  if (end <= 0)
+    return 0;
+  const int begin = datagram.lastIndexOf('|', end - 1) + 1;
+  if (begin <= 0)
+    return 0;
+  uint port = 0;
+  for (int i = begin; i < end; ++i) {
+    const char digit = datagram.at(i);
+    if (digit < '0' || digit > '9' || port > 0xffff)
+      return 0;
+    port = port * 10 + uint(digit - '0');
+  }
+  return port <= 0xffff ? quint16(port) : 0;
+}
+
+const char *const PeerManager::DefaultMulticastGroup = "239.255.45.1";
+const char *const PeerManager::DefaultRendezvousUrl = "http://cppchat.dpwlabs.com/chat";
 
 PeerManager::PeerManager(Client *client)
-    : QObject(client), client(client), sendCount{}, serverPort{} {
+    : QObject(client), client(client), mode(DiscoveryMode::Broadcast),
+      multicastGroup(QString::fromLatin1(DefaultMulticastGroup)), serverPort{}, state{},
+      broadcastInterval(FastBroadcastInterval) {
   updateAddresses();
-  centralTimer.setSingleShot(true);
-  centralTimer.setInterval(CentralInterval);
-  connect(&centralTimer, &QTimer::timeout, this, &PeerManager::centralRequest);
-  connect(&manager, &QNetworkAccessManager::finished, this, &PeerManager::managerReplyFinished);
+  cache.load();
+  id = cache.localId();
+  if (id.isNull())
+    id = QUuid::createUuid();
+  cache.save();
+  cacheTimer.setInterval(CacheSaveInterval);
+  connect(&cacheTimer, &QTimer::timeout, this, &PeerManager::saveCache);
+  connect(&cacheTimer, &QTimer::timeout, this, [this]() {
+    discovery.forget();
+    // a node silent that long may have been replaced by an older one at the same address
+    const qint64 before = beaconClock.elapsed() - DiscoveryTable::ForgetAfter;
+    for (auto it = beaconSenders.begin(); it != beaconSenders.end();) {
+      if (it.value() < before)
+        it = beaconSenders.erase(it);
+      else
+        ++it;
+    }
+  });
+  beaconClock.start();
+  connect(client, &Client::newParticipant, this,
+          [this](const QString &nick) { discovery.connected(nick); });
+  connect(client, &Client::participantLeft, this,
+          [this](const QString &nick) { discovery.disconnected(nick); });
+  broadcastTimer.setSingleShot(true);
+  rendezvous.setUrl(QUrl(QString::fromLatin1(DefaultRendezvousUrl)));
+  connect(&rendezvous, &RendezvousClient::announcement, this, &PeerManager::parseMessage);
 }
 
 void PeerManager::setServerPort(int port) {
+  if (port == serverPort)
+    return;
   serverPort = port;
+  if (port != 0)
+    cache.setLocalPort(quint16(port));
+  stateChanged();
+}
+
+quint16 PeerManager::preferredServerPort() const {
+  return cache.localPort();
+}
+
+void PeerManager::setRendezvousUrl(const QUrl &url) {
+  rendezvous.setUrl(url.isEmpty() ? QUrl(QString::fromLatin1(DefaultRendezvousUrl)) : url);
 }
 
 QByteArray PeerManager::userName() const {
@@ -82,22 +150,51 @@ QByteArray PeerManager::userName() const {
 }
 
 void PeerManager::start() {
-  broadcastSocket.bind(QHostAddress::Any, broadcastPort,
-                       QUdpSocket::ShareAddress | QUdpSocket::ReuseAddressHint);
+  if (mode == DiscoveryMode::Multicast) {
+    // an IPv4 group can only be joined by a socket bound to IPv4
+    broadcastSocket.bind(QHostAddress::AnyIPv4, broadcastPort,
+                         QUdpSocket::ShareAddress | QUdpSocket::ReuseAddressHint);
+    // beacons are for the local network only
+    broadcastSocket.setSocketOption(QAbstractSocket::MulticastTtlOption, 1);
+    joinMulticastGroup();
+  } else {
+    broadcastSocket.bind(QHostAddress::Any, broadcastPort,
+                         QUdpSocket::ShareAddress | QUdpSocket::ReuseAddressHint);
+  }
   connect(&broadcastSocket, SIGNAL(readyRead()), this, SLOT(readBroadcastDatagram()));
 
-  broadcastTimer.setInterval(BroadcastInterval);
   connect(&broadcastTimer, SIGNAL(timeout()), this, SLOT(sendBroadcastDatagram()));
-  broadcastTimer.start();
-  centralTimer.start();
+  broadcastInterval = FastBroadcastInterval;
+  sendBroadcastDatagram();
+  updateAnnouncements();
+  rendezvous.start();
+  cacheTimer.start();
+  dialCachedPeers();
 }
 
 void PeerManager::stop() {
   disconnect(&broadcastTimer, &QTimer::timeout, this, 0);
   disconnect(&broadcastSocket, &QTcpSocket::readyRead, this, 0);
   broadcastTimer.stop();
-  centralTimer.stop();
+  rendezvous.stop();
+  cacheTimer.stop();
   broadcastSocket.close();
+  saveCache();
+}
+
+void PeerManager::saveCache() {
+  if (!cache.save())
+    qWarning() << "could not write the peer cache" << PeerCache::defaultFileName();
+}
+
+void PeerManager::dialCachedPeers() {
+  const int limit = qMin(MaxCachedDials, client->dialBudget());
+  foreach (const PeerCache::Entry &entry, cache.recent(CachedPeerAge, limit)) {
+    if (entry.port == serverPort && isLocalHostAddress(entry.address))
+      continue;
+    discovery.dialling(entry.id.toRfc4122());
+    client->connectToPeer(entry.address, entry.port);
+  }
 }
 
 bool PeerManager::isLocalHostAddress(const QHostAddress &address) {
@@ -109,40 +206,112 @@ bool PeerManager::isLocalHostAddress(const QHostAddress &address) {
 }
 
 void PeerManager::setUserName(const QByteArray &name) {
+  if (name == username)
+    return;
   username = name;
+  stateChanged();
+}
+
+QUuid PeerManager::peerId() const {
+  return id;
+}
+
+void PeerManager::setDiscovery(DiscoveryMode mode, const QHostAddress &group) {
+  QHostAddress newGroup = group;
+  if (newGroup.protocol() != QAbstractSocket::IPv4Protocol || !newGroup.isMulticast()) {
+    if (!newGroup.isNull())
+      qWarning() << "not an IPv4 multicast group:" << newGroup.toString();
+    newGroup = QHostAddress(QString::fromLatin1(DefaultMulticastGroup));
+  }
+  if (mode == this->mode && newGroup == multicastGroup)
+    return;
+
+  const bool running = broadcastSocket.state() == QAbstractSocket::BoundState;
+  if (running)
+    stop();
+  this->mode = mode;
+  multicastGroup = newGroup;
+  if (running)
+    start();
+}
+
+void PeerManager::joinMulticastGroup() {
+  // joining an interface twice fails harmlessly, so this also picks up new interfaces
+  foreach (const QNetworkInterface &interface, multicastInterfaces)
+    broadcastSocket.joinMulticastGroup(multicastGroup, interface);
+}
+
+void PeerManager::scheduleBroadcast(int interval) {
+  const int jitter = int(interval * BroadcastJitter);
+  broadcastTimer.start(interval - jitter + QRandomGenerator::global()->bounded(2 * jitter + 1));
+}
+
+void PeerManager::announceSoon() {
+  if (broadcastTimer.isActive() && broadcastTimer.remainingTime() > AnswerDelay)
+    broadcastTimer.start(QRandomGenerator::global()->bounded(AnswerDelay));
+}
+
+void PeerManager::stateChanged() {
+  ++state;
+  broadcastInterval = FastBroadcastInterval;
+  if (broadcastTimer.isActive())
+    scheduleBroadcast(broadcastInterval);
+  updateAnnouncements();
 }
 
 void PeerManager::sendBroadcastDatagram() {
-  QByteArray datagram(username);
-  datagram.append('|');
-  datagram.append(QByteArray::number(serverPort));
-  datagram.append('|');
-  int len = datagram.length();
+  Beacon beacon;
+  beacon.port = quint16(serverPort);
+  beacon.peerId = id;
+  beacon.state = state;
+  beacon.name = username;
+  QByteArray binary = beacon.encode();
+
   bool validBroadcastAddresses = true;
-  auto ipIter = ipAddresses.begin();
-  foreach (QHostAddress address, broadcastAddresses) {
-    QByteArray ip = ipIter->toString().toUtf8();
-    datagram.append(ip);
-    if (broadcastSocket.writeDatagram(datagram, address, broadcastPort) == -1)
-      validBroadcastAddresses = false;
-    if (sendCount % 10 == 0) {
-      sendCount = 0;
-      QUrl url(centralServerUrl + QStringLiteral("/post"));
-      QString query = QStringLiteral("sender=");
-      query += QString::fromUtf8(username);
-      query += QStringLiteral("&message=");
-      query += QString::fromUtf8(datagram);
-      query += QStringLiteral("&id=0");
-      url.setQuery(query);
-      manager.get(QNetworkRequest(url));
+  if (mode == DiscoveryMode::Multicast) {
+    // one datagram per interface, each carrying the address peers on that link can reach
+    for (int i = 0; i < multicastInterfaces.size(); ++i) {
+      Beacon::setAddress(&binary, multicastAddresses.at(i).toIPv4Address());
+      broadcastSocket.setMulticastInterface(multicastInterfaces.at(i));
+      if (broadcastSocket.writeDatagram(binary, multicastGroup, broadcastPort) == -1)
+        validBroadcastAddresses = false;
+    }
+  } else {
+    // nodes from before binary beacons only understand "name|port|ip", they get that as well
+    QByteArray legacyPrefix(username);
+    legacyPrefix.append('|');
+    legacyPrefix.append(QByteArray::number(serverPort));
+    legacyPrefix.append('|');
+    auto ipIter = ipAddresses.begin();
+    foreach (QHostAddress address, broadcastAddresses) {
+      Beacon::setAddress(&binary, ipIter->toIPv4Address());
+      if (broadcastSocket.writeDatagram(binary, address, broadcastPort) == -1
+          || broadcastSocket.writeDatagram(legacyPrefix + ipIter->toString().toUtf8(), address,
+                                           broadcastPort) == -1)
+        validBroadcastAddresses = false;
+      ++ipIter;
     }
-    datagram.truncate(len);
-    ++ipIter;
   }
-  ++sendCount;
   if (!validBroadcastAddresses) {
     updateAddresses();
+    updateAnnouncements();
+    if (mode == DiscoveryMode::Multicast)
+      joinMulticastGroup();
   }
+  scheduleBroadcast(broadcastInterval);
+  broadcastInterval = qMin(2 * broadcastInterval, SlowBroadcastInterval);
+}
+
+void PeerManager::updateAnnouncements() {
+  // the rendezvous server relays text, so it still gets the old format
+  QByteArray prefix(username);
+  prefix.append('|');
+  prefix.append(QByteArray::number(serverPort));
+  prefix.append('|');
+  QList<QByteArray> announcements;
+  foreach (QHostAddress address, ipAddresses)
+    announcements << prefix + address.toString().toUtf8();
+  rendezvous.setAnnouncements(username, announcements);
 }
 
 void PeerManager::readBroadcastDatagram() {
@@ -154,57 +323,50 @@ void PeerManager::readBroadcastDatagram() {
     if (broadcastSocket.readDatagram(datagram.data(), datagram.size(), &senderIp, &senderPort)
         == -1)
       continue;
-    parseMessage(datagram);
-  }
-}
-
-void PeerManager::newPeer(QHostAddress address, QString nickName, quint16 port) {
-  if (!client->hasConnection(address.toIPv4Address(), nickName)) {
-    PeerConnection *connection = new PeerConnection(this);
-    emit newConnection(connection);
-    connection->connectToHost(address, port);
-  }
-}
-
-void PeerManager::centralRequest() {
-  QUrl url(centralServerUrl + QStringLiteral("/list"));
-  manager.get(QNetworkRequest(url));
-  centralTimer.start(5000); // crude timeout
-}
-
-void PeerManager::parseUserAnnouncements(QNetworkReply *reply) {
-  QByteArray httpResponse = reply->readAll();
-  if (!httpResponse.isEmpty()) {
-    QJsonDocument doc(QJsonDocument::fromJson(httpResponse));
-    if (doc.isObject()) {
-      QJsonObject obj = doc.object();
-    }
-    if (doc.isArray()) {
-      QJsonArray array = doc.array();
-      foreach (QJsonValue val, array) {
-        if (val.isObject()) {
-          QJsonObject obj = val.toObject();
-          parseMessage(obj.value("message").toString().toUtf8());
-        }
-      }
+    Beacon beacon;
+    if (Beacon::decode(datagram, &beacon)) {
+      beaconSenders.insert(qMakePair(senderIp.toIPv4Address(), beacon.port), beaconClock.elapsed());
+      parseBeacon(beacon);
+      continue;
     }
+    // the text copy of a binary beacon, which is sent first and already handled
+    if (beaconSenders.contains(qMakePair(senderIp.toIPv4Address(), legacyBeaconPort(datagram))))
+      continue;
+    parseMessage(datagram);
   }
-  centralTimer.start(CentralInterval);
 }
 
-void PeerManager::managerReplyFinished(QNetworkReply *reply)
-{
-  if (reply->error() == QNetworkReply::NoError && reply->url().path().contains("/list")) {
-    parseUserAnnouncements(reply);
-  }
-  reply->deleteLater();
+void PeerManager::newPeer(const QByteArray &key, const QUuid &id, quint32 generation,
+                          const QHostAddress &address, quint16 port,
+                          const std::function<QString()> &nick) {
+  const quint32 ipv4 = address.toIPv4Address();
+  // a peer with an id may be connected over another of its addresses, under another name
+  auto isConnected = [this, ipv4, &id](const QString &nickName) {
+    return client->hasPeer(id) || client->hasConnection(ipv4, nickName);
+  };
+  // in the relay overlay a peer not dialled now counts as failed, and is retried after a backoff
+  if (discovery.announced(key, generation, nick, isConnected) && client->dialBudget() > 0)
+    client->connectToPeer(address, port);
 }
 
 void PeerManager::updateAddresses() {
-  sendCount = 0;
   broadcastAddresses.clear();
   ipAddresses.clear();
+  multicastInterfaces.clear();
+  multicastAddresses.clear();
   foreach (QNetworkInterface interface, QNetworkInterface::allInterfaces()) {
+    const QNetworkInterface::InterfaceFlags multicastFlags =
+        QNetworkInterface::IsUp | QNetworkInterface::IsRunning | QNetworkInterface::CanMulticast;
+    if ((interface.flags() & multicastFlags) == multicastFlags
+        && !(interface.flags() & QNetworkInterface::IsLoopBack)) {
+      foreach (QNetworkAddressEntry entry, interface.addressEntries()) {
+        if (entry.ip().protocol() == QAbstractSocket::IPv4Protocol) {
+          multicastInterfaces << interface;
+          multicastAddresses << entry.ip();
+          break;
+        }
+      }
+    }
     if (interface.flags() & (QNetworkInterface::IsUp | QNetworkInterface::CanBroadcast)
         && !(interface.flags() & QNetworkInterface::IsLoopBack)) {
       foreach (QNetworkAddressEntry entry, interface.addressEntries()) {
@@ -219,6 +381,18 @@ void PeerManager::updateAddresses() {
   }
 }
 
+void PeerManager::parseBeacon(const Beacon &beacon) {
+  if (beacon.peerId == id || beacon.port == 0)
+    return;
+  const QByteArray key = beacon.peerId.toRfc4122();
+  if (!discovery.contains(key))
+    announceSoon();
+  QHostAddress address(beacon.ipv4);
+  cache.seen(beacon.peerId, address, beacon.port);
+  newPeer(key, beacon.peerId, beacon.state, address, beacon.port,
+          [&]() { return QString::fromUtf8(beacon.name) + '@' + address.toString(); });
+}
+
 void PeerManager::parseMessage(const QByteArray &message) {
   QList<QByteArray> list = message.split('|');
   if (list.size() != 3)
@@ -228,8 +402,12 @@ void PeerManager::parseMessage(const QByteArray &message) {
   int senderServerPort = list.at(1).toInt();
   if (isLocalHostAddress(address) && senderServerPort == serverPort)
     return;
-  QString nickName = QString::fromUtf8(list.at(0)) + '@' + QString::fromUtf8(list.at(2));
-  newPeer(address, nickName, senderServerPort);
+  // a node that sends binary beacons, announced again by the rendezvous server
+  if (beaconSenders.contains(qMakePair(address.toIPv4Address(), quint16(senderServerPort))))
+    return;
+  // a legacy announcement carries no id, the whole text identifies the peer and its port
+  newPeer(message, QUuid(), 0, address, quint16(senderServerPort),
+          [&]() { return QString::fromUtf8(list.at(0)) + '@' + QString::fromUtf8(list.at(2)); });
 }
 
 } // namespace p2pnetworking
@@ -51,19 +51,33 @@
 #ifndef PEERMANAGER_H
 #define PEERMANAGER_H
 
+#include "discoverytable.h"
+#include "peercache.h"
+#include "rendezvousclient.h"
 #include <QByteArray>
+#include <QHash>
 #include <QCoreApplication>
+#include <QElapsedTimer>
 #include <QList>
-#include <QNetworkAccessManager>
-#include <QNetworkReply>
+#include <QNetworkInterface>
 #include <QObject>
+#include <QPair>
 #include <QTimer>
 #include <QUdpSocket>
+#include <QUuid>
 
 namespace p2pnetworking {
 
 class Client;
-class PeerConnection;
+struct Beacon;
+
+/**
+ * @brief The DiscoveryMode enum how beacons reach the local network. Broadcast reaches every host
+ * on every attached subnet; multicast only reaches hosts that joined the discovery group, at the
+ * cost of needing multicast routing (IGMP snooping) that some networks lack. Nodes only find each
+ * other when they use the same mode.
+ */
+enum class DiscoveryMode { Broadcast, Multicast };
 
 class PeerManager : public QObject {
   Q_OBJECT
@@ -77,33 +91,100 @@ public:
   void stop();
   bool isLocalHostAddress(const QHostAddress &address);
   void setUserName(const QByteArray &name);
-
-signals:
-  void newConnection(PeerConnection *connection);
+  /**
+   * @brief peerId the id this node announces, kept across runs in the peer cache.
+   */
+  QUuid peerId() const;
+  /**
+   * @brief setDiscovery choose how beacons are sent and received, restarting discovery if it runs.
+   * @param mode broadcast or multicast.
+   * @param group the IPv4 multicast group, the default group if it is null or not multicast.
+   */
+  void setDiscovery(DiscoveryMode mode, const QHostAddress &group = QHostAddress());
+  /** the group joined in multicast mode unless another is chosen, organization-local scope */
+  static const char *const DefaultMulticastGroup;
+  /**
+   * @brief preferredServerPort the server port of the last run, so peers that cached it can still
+   * dial this node. 0 if unknown.
+   */
+  quint16 preferredServerPort() const;
+  /**
+   * @brief setRendezvousUrl choose the central rendezvous server.
+   * @param url its base url, DefaultRendezvousUrl if empty.
+   */
+  void setRendezvousUrl(const QUrl &url);
+  static const char *const DefaultRendezvousUrl;
 
 private slots:
   void sendBroadcastDatagram();
   void readBroadcastDatagram();
-  void newPeer(QHostAddress address, QString nickName, quint16 port);
-  void centralRequest();
-  void managerReplyFinished(QNetworkReply *reply);
+  void parseMessage(const QByteArray &message);
+  void saveCache();
 
 private:
   void updateAddresses();
-  void parseMessage(const QByteArray &message);
-  void parseUserAnnouncements(QNetworkReply *reply);
+  /**
+   * @brief dialCachedPeers connect to the peers cached by earlier runs, all at once, without
+   * waiting for their beacons.
+   */
+  void dialCachedPeers();
+  void joinMulticastGroup();
+  /**
+   * @brief updateAnnouncements give the rendezvous client the current "name|port|ip" text
+   * announcements, one per interface.
+   */
+  void updateAnnouncements();
+  /**
+   * @brief scheduleBroadcast arm the broadcast timer for the next announcement, jittered so that
+   * nodes started together drift apart.
+   * @param interval the nominal delay.
+   */
+  void scheduleBroadcast(int interval);
+  /**
+   * @brief announceSoon answer a peer we have not heard from before with one early announcement,
+   * so it learns about us without waiting for our slow rate.
+   */
+  void announceSoon();
+  /**
+   * @brief stateChanged something announced changed, bump the state counter and start over at the
+   * fast rate.
+   */
+  void stateChanged();
+  void parseBeacon(const Beacon &beacon);
+  /**
+   * @brief newPeer a peer was announced, dial it unless the discovery table says otherwise.
+   * @param key identifies the peer in the table.
+   * @param id the peer's id, null for legacy announcements.
+   * @param generation changes whenever the peer's announcement does.
+   * @param address the peer's address.
+   * @param port the peer's server port.
+   * @param nick builds the peer's unique name, only when the table needs it.
+   */
+  void newPeer(const QByteArray &key, const QUuid &id, quint32 generation,
+               const QHostAddress &address, quint16 port, const std::function<QString()> &nick);
 
   Client *client;
   QList<QHostAddress> broadcastAddresses;
   QList<QHostAddress> ipAddresses;
+  QList<QNetworkInterface> multicastInterfaces; /**< up, multicast capable and with an IPv4 address */
+  QList<QHostAddress> multicastAddresses;       /**< the IPv4 address of each multicast interface */
+  DiscoveryMode mode;
+  QHostAddress multicastGroup;
   QUdpSocket broadcastSocket;
   QTimer broadcastTimer;
-  QTimer centralTimer;
+  QTimer cacheTimer;
   QByteArray username;
-  QNetworkAccessManager manager;
-  QByteArray httpReply;
-  int sendCount;
+  RendezvousClient rendezvous;
   int serverPort;
+  QUuid id;
+  quint32 state;                    /**< the state counter sent in our beacons */
+  int broadcastInterval;            /**< the current nominal interval, doubling up to the slow rate */
+  DiscoveryTable discovery;         /**< dial decisions, by peer id or legacy announcement */
+  PeerCache cache;
+  /** the address and server port of every node heard sending binary beacons, whose text beacons
+   * are meant for older nodes only, with when it was last heard on beaconClock */
+  QHash<QPair<quint32, quint16>, qint64> beaconSenders;
+  QElapsedTimer beaconClock;
 };
 
 } // namespace p2pnetworking
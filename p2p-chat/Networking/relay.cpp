@@ -0,0 +1,117 @@
+#include "relay.h"
+
+#include "messageframes.h"
+#include <QAtomicInteger>
+#include <QMutex>
+#include <QSet>
+#include <QUuid>
+
+namespace p2pnetworking {
+
+const char *const Relay::Capability = "relay";
+
+static const char SeparatorToken = '|';
+static const int IdSize = 32;
+
+static QAtomicInteger<quint64> originated;
+static QAtomicInteger<quint64> originBytes;
+static QAtomicInteger<quint64> delivered;
+static QAtomicInteger<quint64> duplicates;
+static QAtomicInteger<quint64> forwarded;
+static QAtomicInteger<quint64> forwardedBytes;
+
+// Two generations of ids: once the current one is full it becomes the previous one and the oldest
+// ids are dropped, so memory stays bounded without a timestamp per id.
+static QMutex seenMutex;
+static QSet<QByteArray> seenCurrent;
+static QSet<QByteArray> seenPrevious;
+
+quint64 RelayStats::bytesPerMessage() const {
+  return originated ? originBytes / originated : 0;
+}
+
+QByteArray Relay::newId() {
+  return QUuid::createUuid().toRfc4122().toHex();
+}
+
+QByteArray Relay::frame(const QByteArray &id, const QByteArray &origin, const QByteArray &inner) {
+  QByteArray payload;
+  payload.reserve(id.size() + 1 + origin.size() + 1 + inner.size());
+  payload += id;
+  payload += SeparatorToken;
+  payload += origin;
+  payload += SeparatorToken;
+  payload += inner;
+  return MessageFrames::frame("RELY", payload);
+}
+
+bool Relay::parse(const QByteArray &payload, QByteArray *id, QByteArray *origin,
+                  QByteArray *inner) {
+  if (payload.size() <= IdSize || payload.at(IdSize) != SeparatorToken)
+    return false;
+  const int end = payload.indexOf(SeparatorToken, IdSize + 1);
+  if (end < 0)
+    return false;
+  *id = payload.left(IdSize);
+  *origin = payload.mid(IdSize + 1, end - IdSize - 1);
+  *inner = payload.mid(end + 1);
+  return true;
+}
+
+QByteArray Relay::withOrigin(const QByteArray &frame, const QByteArray &origin) {
+  // skip the "RELY|length|" header
+  const int header = frame.indexOf(SeparatorToken, 5);
+  QByteArray id, previous, inner;
+  if (header < 0 || !parse(frame.mid(header + 1), &id, &previous, &inner))
+    return frame;
+  return Relay::frame(id, origin, inner);
+}
+
+QByteArray Relay::presenceFrame() {
+  const QByteArray id = newId();
+  firstSighting(id);
+  return frame(id, QByteArray(), MessageFrames::frame("HERE", QByteArray()));
+}
+
+bool Relay::firstSighting(const QByteArray &id) {
+  QMutexLocker locker(&seenMutex);
+  if (seenCurrent.contains(id) || seenPrevious.contains(id))
+    return false;
+  if (seenCurrent.size() >= SeenCapacity) {
+    seenPrevious.swap(seenCurrent);
+    seenCurrent.clear();
+  }
+  seenCurrent.insert(id);
+  return true;
+}
+
+void Relay::recordOriginated(qint64 bytes) {
+  originated.fetchAndAddRelaxed(1);
+  originBytes.fetchAndAddRelaxed(quint64(bytes));
+}
+
+void Relay::recordDelivered() {
+  delivered.fetchAndAddRelaxed(1);
+}
+
+void Relay::recordDuplicate() {
+  duplicates.fetchAndAddRelaxed(1);
+}
+
+void Relay::recordForwarded(qint64 bytes) {
+  forwarded.fetchAndAddRelaxed(1);
+  forwardedBytes.fetchAndAddRelaxed(quint64(bytes));
+}
+
+RelayStats Relay::stats() {
+  RelayStats stats;
+  stats.originated = originated.loadAcquire();
+  stats.originBytes = originBytes.loadAcquire();
+  stats.delivered = delivered.loadAcquire();
+  stats.duplicates = duplicates.loadAcquire();
+  stats.forwarded = forwarded.loadAcquire();
+  stats.forwardedBytes = forwardedBytes.loadAcquire();
+  return stats;
+}
+
+} // namespace p2pnetworking
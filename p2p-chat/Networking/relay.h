@@ -0,0 +1,103 @@
+#ifndef RELAY_H
+#define RELAY_H
+
+#include <QByteArray>
+
+namespace p2pnetworking {
+
+/**
+ * @brief The RelayStats struct totals for public messages since the process started. Originated
+ * bytes are everything written for messages sent by this node, so originBytes / originated is the
+ * sender's upload per message.
+ */
+struct RelayStats {
+  quint64 originated = 0;
+  quint64 originBytes = 0;
+  quint64 delivered = 0;      /**< relayed messages received for the first time */
+  quint64 duplicates = 0;     /**< relayed messages dropped as already seen */
+  quint64 forwarded = 0;      /**< frames forwarded to neighbours */
+  quint64 forwardedBytes = 0;
+
+  /**
+   * @brief bytesPerMessage the sender's upload per originated message, 0 before the first.
+   */
+  quint64 bytesPerMessage() const;
+};
+
+/**
+ * @brief The Relay class the relay overlay for large rooms, offered during the greeting as the
+ * "relay" capability. Instead of sending a public message to every participant, a node sends it to
+ * its few overlay neighbours in a RELY frame, and every node forwards a message it sees for the
+ * first time to its other neighbours. A random id per message and a set of the ids seen recently
+ * make each node deliver and forward a message once, however many neighbours it comes from.
+ *
+ * A RELY payload is "id|origin|frame": the id as 32 hex digits, the name of the node that sent the
+ * message as its neighbours see it, empty until the first hop fills it in, and the message's MESG
+ * or MESZ frame, forwarded untouched.
+ *
+ * Nodes only connected through the overlay learn of each other from presence announcements, a
+ * RELY frame around an empty HERE frame that every node sends each PresenceInterval.
+ */
+class Relay {
+public:
+  /** the capability token advertised in the greeting */
+  static const char *const Capability;
+  /** the seen set remembers at least this many ids */
+  static const int SeenCapacity = 16384;
+  /** how often a node announces itself, in milliseconds */
+  static const int PresenceInterval = 10 * 1000;
+  /** a node not heard of for this long has left, in milliseconds */
+  static const int PresenceTimeout = 35 * 1000;
+
+  /**
+   * @brief newId a random message id.
+   */
+  static QByteArray newId();
+
+  /**
+   * @brief frame build a RELY frame.
+   * @param id the message id.
+   * @param origin the sender's name, empty when sent by the sender itself.
+   * @param inner the message's MESG or MESZ frame.
+   */
+  static QByteArray frame(const QByteArray &id, const QByteArray &origin, const QByteArray &inner);
+
+  /**
+   * @brief parse split a RELY payload, see frame().
+   * @return false if the payload is malformed.
+   */
+  static bool parse(const QByteArray &payload, QByteArray *id, QByteArray *origin,
+                    QByteArray *inner);
+
+  /**
+   * @brief withOrigin rebuild a RELY frame naming another sender.
+   * @param frame a frame built by frame().
+   * @param origin the sender's name.
+   * @return the new frame, or the given one if it is malformed.
+   */
+  static QByteArray withOrigin(const QByteArray &frame, const QByteArray &origin);
+
+  /**
+   * @brief presenceFrame build a presence announcement of this node, its id is marked seen.
+   */
+  static QByteArray presenceFrame();
+
+  /**
+   * @brief firstSighting record a message id, safe to call from any thread.
+   * @return true if the id was not seen recently.
+   */
+  static bool firstSighting(const QByteArray &id);
+
+  static void recordOriginated(qint64 bytes);
+  static void recordDelivered();
+  static void recordDuplicate();
+  static void recordForwarded(qint64 bytes);
+  /**
+   * @brief stats the totals so far, safe to call from any thread.
+   */
+  static RelayStats stats();
+};
+
+} // namespace p2pnetworking
+
+#endif
@@ -0,0 +1,216 @@
+#include "rendezvousclient.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QUrlQuery>
+
+namespace p2pnetworking {
+
+/** a poll the server holds this much longer than asked for is given up, in milliseconds */
+static const int PollGrace = 10000;
+/** failed polls are retried after 1 s, doubling up to this, in milliseconds */
+static const int MaxRetryDelay = 30000;
+
+RendezvousClient::RendezvousClient(QObject *parent)
+    : QObject(parent), listReply(nullptr), legacyListHash(0), failures(0), resync(false),
+      legacy(false), running(false) {
+  pollTimer.setSingleShot(true);
+  deadlineTimer.setSingleShot(true);
+  announceTimer.setInterval(AnnounceInterval);
+  resyncTimer.setInterval(ResyncInterval);
+  connect(&pollTimer, &QTimer::timeout, this, &RendezvousClient::poll);
+  connect(&deadlineTimer, &QTimer::timeout, this, &RendezvousClient::pollTimedOut);
+  connect(&announceTimer, &QTimer::timeout, this, &RendezvousClient::post);
+  connect(&resyncTimer, &QTimer::timeout, this, &RendezvousClient::resyncDue);
+}
+
+void RendezvousClient::setUrl(const QUrl &url) {
+  if (url == baseUrl)
+    return;
+  baseUrl = url;
+  cursor.clear();
+  legacyListHash = 0;
+  legacy = false;
+  if (running) {
+    if (listReply)
+      listReply->abort();
+    failures = 0;
+    pollTimer.start(0);
+    post();
+  }
+}
+
+QUrl RendezvousClient::url() const {
+  return baseUrl;
+}
+
+void RendezvousClient::start() {
+  if (running)
+    return;
+  running = true;
+  failures = 0;
+  poll();
+  post();
+  announceTimer.start();
+  resyncTimer.start();
+}
+
+void RendezvousClient::stop() {
+  running = false;
+  pollTimer.stop();
+  deadlineTimer.stop();
+  announceTimer.stop();
+  resyncTimer.stop();
+  if (listReply)
+    listReply->abort();
+}
+
+void RendezvousClient::setAnnouncements(const QByteArray &sender,
+                                        const QList<QByteArray> &announcements) {
+  if (sender == senderName && announcements == this->announcements)
+    return;
+  senderName = sender;
+  this->announcements = announcements;
+  if (running)
+    post();
+}
+
+QUrl RendezvousClient::endpoint(const QString &path) const {
+  QUrl url(baseUrl);
+  url.setPath(url.path() + path);
+  return url;
+}
+
+void RendezvousClient::poll() {
+  if (!running || listReply || !baseUrl.isValid())
+    return;
+  // the poll in flight has already advanced the cursor, so the whole list is asked for only now
+  if (resync) {
+    resync = false;
+    cursor.clear();
+    legacyListHash = 0;
+  }
+
+  QUrl url = endpoint(QStringLiteral("/list"));
+  QNetworkRequest request;
+  if (!legacy) {
+    QUrlQuery query;
+    query.addQueryItem(QStringLiteral("since"),
+                       cursor.isEmpty() ? QStringLiteral("0") : QString::fromLatin1(cursor));
+    query.addQueryItem(QStringLiteral("wait"), QString::number(PollWait));
+    url.setQuery(query);
+    if (!cursor.isEmpty())
+      request.setRawHeader("If-None-Match", '"' + cursor + '"');
+  }
+  request.setUrl(url);
+  listReply = manager.get(request);
+  connect(listReply, &QNetworkReply::finished, this, &RendezvousClient::listFinished);
+  deadlineTimer.start(legacy ? PollGrace : PollWait * 1000 + PollGrace);
+}
+
+void RendezvousClient::resyncDue() {
+  resync = true;
+}
+
+void RendezvousClient::pollTimedOut() {
+  if (listReply)
+    listReply->abort();
+}
+
+void RendezvousClient::listFinished() {
+  QNetworkReply *reply = listReply;
+  listReply = nullptr;
+  deadlineTimer.stop();
+  reply->deleteLater();
+  if (!running)
+    return;
+
+  const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+  if (reply->error() != QNetworkReply::NoError) {
+    retryLater();
+    return;
+  }
+  failures = 0;
+  if (status == 304) { // nothing new while the server waited
+    pollTimer.start(0);
+    return;
+  }
+
+  const QByteArray body = reply->readAll();
+  const QJsonDocument doc = QJsonDocument::fromJson(body);
+  if (doc.isArray()) {
+    if (!legacy) {
+      legacy = true;
+      post(); // they went out in the new format before we knew better
+    }
+    const uint hash = qHash(body);
+    if (hash != legacyListHash) {
+      legacyListHash = hash;
+      foreach (const QJsonValue &value, doc.array())
+        emit announcement(value.toObject().value("message").toString().toUtf8());
+    }
+    pollTimer.start(LegacyPollInterval);
+  } else if (doc.isObject()) {
+    const QJsonObject object = doc.object();
+    cursor = object.value("cursor").toString().toLatin1();
+    foreach (const QJsonValue &value, object.value("messages").toArray())
+      emit announcement(value.toObject().value("message").toString().toUtf8());
+    pollTimer.start(0);
+  } else {
+    retryLater();
+  }
+}
+
+void RendezvousClient::retryLater() {
+  ++failures;
+  pollTimer.start(qMin(MaxRetryDelay, 1000 << qMin(failures - 1, 5)));
+}
+
+void RendezvousClient::post() {
+  if (!running || announcements.isEmpty() || !baseUrl.isValid())
+    return;
+
+  if (legacy) {
+    foreach (const QByteArray &message, announcements) {
+      QUrl url = endpoint(QStringLiteral("/post"));
+      QUrlQuery query;
+      query.addQueryItem(QStringLiteral("sender"), QString::fromUtf8(senderName));
+      query.addQueryItem(QStringLiteral("message"), QString::fromUtf8(message));
+      query.addQueryItem(QStringLiteral("id"), QStringLiteral("0"));
+      url.setQuery(query);
+      connect(manager.get(QNetworkRequest(url)), &QNetworkReply::finished, this,
+              &RendezvousClient::postFinished);
+    }
+    return;
+  }
+
+  QJsonArray messages;
+  foreach (const QByteArray &message, announcements)
+    messages.append(QString::fromUtf8(message));
+  QJsonObject body;
+  body.insert("sender", QString::fromUtf8(senderName));
+  body.insert("messages", messages);
+  QNetworkRequest request(endpoint(QStringLiteral("/post")));
+  request.setHeader(QNetworkRequest::ContentTypeHeader, QStringLiteral("application/json"));
+  connect(manager.post(request, QJsonDocument(body).toJson(QJsonDocument::Compact)),
+          &QNetworkReply::finished, this, &RendezvousClient::postFinished);
+}
+
+void RendezvousClient::postFinished() {
+  QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+  if (!reply)
+    return;
+  reply->deleteLater();
+  const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+  // the original API only takes announcements as GET requests
+  if (running && !legacy && reply->operation() == QNetworkAccessManager::PostOperation
+      && (status == 404 || status == 405)) {
+    legacy = true;
+    post();
+  }
+}
+
+} // namespace p2pnetworking
@@ -0,0 +1,104 @@
+#ifndef RENDEZVOUSCLIENT_H
+#define RENDEZVOUSCLIENT_H
+
+#include <QByteArray>
+#include <QList>
+#include <QNetworkAccessManager>
+#include <QObject>
+#include <QTimer>
+#include <QUrl>
+
+class QNetworkReply;
+
+namespace p2pnetworking {
+
+/**
+ * @brief The RendezvousClient class finds peers through a central rendezvous server, for networks
+ * that beacons do not reach.
+ *
+ * The list is long-polled: GET /list?since=<cursor>&wait=<seconds> with If-None-Match is held by
+ * the server until an announcement newer than the cursor arrives, then answered with only those
+ * announcements and the new cursor, or with 304 Not Modified when the wait runs out. Announcements
+ * of all interfaces are posted together as one JSON POST /post, refreshed every AnnounceInterval.
+ * Deltas only report new announcements, so every ResyncInterval the whole list is fetched and
+ * emitted again; a peer that dropped but is still announced is then dialled again.
+ *
+ * A server that answers /list with a plain array only knows the original API. It is polled every
+ * LegacyPollInterval instead and gets one GET /post per announcement; a list that did not change
+ * since the last poll is not parsed again.
+ */
+class RendezvousClient : public QObject {
+  Q_OBJECT
+
+public:
+  /** how long the server may hold a list request, in seconds */
+  static const int PollWait = 25;
+  /** how often the announcements are posted again, in milliseconds */
+  static const int AnnounceInterval = 30000;
+  /** the poll interval for servers with the original API, in milliseconds */
+  static const int LegacyPollInterval = 600;
+  /** how often the whole list is emitted again, in milliseconds */
+  static const int ResyncInterval = 300000;
+
+  explicit RendezvousClient(QObject *parent = nullptr);
+
+  /**
+   * @brief setUrl choose the server, takes effect on the next request.
+   * @param url the base url, /list and /post are appended to its path.
+   */
+  void setUrl(const QUrl &url);
+  QUrl url() const;
+
+  void start();
+  void stop();
+
+  /**
+   * @brief setAnnouncements replace what is announced, posting it at once if it changed.
+   * @param sender the user name.
+   * @param announcements one "name|port|ip" announcement per interface.
+   */
+  void setAnnouncements(const QByteArray &sender, const QList<QByteArray> &announcements);
+
+signals:
+  /**
+   * @brief announcement emitted for every announcement received from the server, each at most once
+   * per change unless the server only knows the original API.
+   * @param message the announcement as it was posted.
+   */
+  void announcement(const QByteArray &message);
+
+private slots:
+  void poll();
+  void post();
+  void listFinished();
+  void postFinished();
+  void pollTimedOut();
+  void resyncDue();
+
+private:
+  QUrl endpoint(const QString &path) const;
+  /**
+   * @brief retryLater schedule the next poll after a failure, backing off.
+   */
+  void retryLater();
+
+  QNetworkAccessManager manager;
+  QUrl baseUrl;
+  QNetworkReply *listReply;
+  QTimer pollTimer;     /**< the delay before the next poll */
+  QTimer deadlineTimer; /**< aborts a poll the server holds for too long */
+  QTimer announceTimer;
+  QTimer resyncTimer;
+  QByteArray senderName;
+  QList<QByteArray> announcements;
+  QByteArray cursor;   /**< the last cursor the server sent, empty before the first answer */
+  uint legacyListHash; /**< hash of the last plain array, to skip unchanged lists */
+  int failures;        /**< consecutive failed polls */
+  bool resync;         /**< the next poll fetches the whole list */
+  bool legacy;         /**< the server only knows the original API */
+  bool running;
+};
+
+} // namespace p2pnetworking
+
+#endif
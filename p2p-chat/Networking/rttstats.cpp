@@ -0,0 +1,90 @@
+#include "rttstats.h"
+
+#include <QtAlgorithms>
+#include <cmath>
+#include <cstring>
+
+namespace p2pnetworking {
+
+// Samples are clamped here, a little over half an hour; anything longer is a dead peer anyway.
+static const qint64 LargestSample = 0x7fffffff;
+
+RttStats::RttStats() : historyNext(0), samples(0), total(0), minimum(0), maximum(0) {
+  std::memset(buckets, 0, sizeof(buckets));
+  std::memset(history, 0, sizeof(history));
+}
+
+void RttStats::record(qint64 microseconds) {
+  microseconds = qBound<qint64>(0, microseconds, LargestSample);
+  ++buckets[bucketFor(microseconds)];
+  history[historyNext] = microseconds;
+  historyNext = (historyNext + 1) % HistorySize;
+
+  minimum = samples == 0 ? microseconds : qMin(minimum, microseconds);
+  maximum = samples == 0 ? microseconds : qMax(maximum, microseconds);
+  total += quint64(microseconds);
+  ++samples;
+}
+
+quint64 RttStats::count() const {
+  return samples;
+}
+
+qint64 RttStats::min() const {
+  return minimum;
+}
+
+qint64 RttStats::max() const {
+  return maximum;
+}
+
+qint64 RttStats::mean() const {
+  return samples == 0 ? 0 : qint64(total / samples);
+}
+
+qint64 RttStats::last() const {
+  return samples == 0 ? 0 : history[(historyNext + HistorySize - 1) % HistorySize];
+}
+
+qint64 RttStats::percentile(double fraction) const {
+  if (samples == 0)
+    return 0;
+
+  const quint64 rank = qMax<quint64>(1, quint64(std::ceil(qBound(0.0, fraction, 1.0) * samples)));
+  quint64 seen = 0;
+  for (int bucket = 0; bucket < BucketCount; ++bucket) {
+    seen += buckets[bucket];
+    if (seen >= rank)
+      return qBound(minimum, bucketUpperBound(bucket), maximum);
+  }
+  return maximum;
+}
+
+QVector<qint64> RttStats::recent() const {
+  const int size = int(qMin<quint64>(samples, HistorySize));
+  QVector<qint64> recent;
+  recent.reserve(size);
+  for (int i = size; i > 0; --i)
+    recent << history[(historyNext + HistorySize - i) % HistorySize];
+  return recent;
+}
+
+int RttStats::bucketFor(qint64 microseconds) {
+  // values below 4 get a bucket each, above that every power of two is split in four by the two
+  // bits below the most significant one
+  if (microseconds < 4)
+    return int(microseconds);
+  const int msb = 63 - qCountLeadingZeroBits(quint64(microseconds));
+  const int sub = int(microseconds >> (msb - 2)) & 3;
+  return 4 * (msb - 1) + sub;
+}
+
+qint64 RttStats::bucketUpperBound(int bucket) {
+  if (bucket < 4)
+    return bucket;
+  const int msb = bucket / 4 + 1;
+  const qint64 sub = bucket % 4;
+  return ((4 + sub + 1) << (msb - 2)) - 1;
+}
+
+} // namespace p2pnetworking
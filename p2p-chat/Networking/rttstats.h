@@ -0,0 +1,66 @@
+#ifndef RTTSTATS_H
+#define RTTSTATS_H
+
+#include <QVector>
+
+namespace p2pnetworking {
+
+/**
+ * @brief The RttStats class round trip time statistics of one connection. Samples go into a
+ * histogram with four buckets per power of two, so percentiles are exact to within a quarter of
+ * the value whatever the number of samples, and the most recent samples are kept as they are.
+ * All times are in microseconds.
+ */
+class RttStats {
+public:
+  /** number of recent samples kept */
+  static const int HistorySize = 32;
+
+  RttStats();
+
+  /**
+   * @brief record add a sample.
+   * @param microseconds the measured round trip time.
+   */
+  void record(qint64 microseconds);
+
+  /**
+   * @brief count the number of samples recorded.
+   */
+  quint64 count() const;
+  qint64 min() const;
+  qint64 max() const;
+  qint64 mean() const;
+  /**
+   * @brief last the most recent sample, 0 if there is none.
+   */
+  qint64 last() const;
+  /**
+   * @brief percentile estimate a percentile from the histogram.
+   * @param fraction the percentile as a fraction, e.g. 0.99 for p99.
+   * @return the upper bound of the bucket holding the percentile, 0 if there are no samples.
+   */
+  qint64 percentile(double fraction) const;
+  /**
+   * @brief recent the last HistorySize samples, oldest first.
+   */
+  QVector<qint64> recent() const;
+
+private:
+  static const int BucketCount = 120;
+
+  static int bucketFor(qint64 microseconds);
+  static qint64 bucketUpperBound(int bucket);
+
+  quint32 buckets[BucketCount];
+  qint64 history[HistorySize];
+  int historyNext; /**< where the next sample goes in history */
+  quint64 samples;
+  quint64 total;
+  qint64 minimum;
+  qint64 maximum;
+};
+
+} // namespace p2pnetworking
+
+#endif
@@ -50,7 +50,6 @@
 
 #include <QtNetwork>
 
-#include "connection.h"
 #include "server.h"
 
 namespace p2pnetworking {
@@ -58,8 +57,9 @@ namespace p2pnetworking {
 Server::Server(QObject *parent) : QTcpServer(parent) {
 }
 
-void Server::start() {
-  listen(QHostAddress::AnyIPv4);
+void Server::start(quint16 preferredPort) {
+  if (preferredPort == 0 || !listen(QHostAddress::AnyIPv4, preferredPort))
+    listen(QHostAddress::AnyIPv4);
 }
 
 void Server::stop()
@@ -70,9 +70,7 @@ void Server::stop()
 }
 
 void Server::incomingConnection(qintptr socketDescriptor) {
-  PeerConnection *connection = new PeerConnection(this);
-  connection->setSocketDescriptor(socketDescriptor);
-  emit newConnection(connection);
+  emit incomingSocket(socketDescriptor);
 }
 
 } // namespace p2pnetworking
@@ -54,8 +54,6 @@
 #include <QTcpServer>
 namespace p2pnetworking {
 
-class PeerConnection;
-
 class Server : public QTcpServer {
   Q_OBJECT
 
@@ -63,10 +61,19 @@ public:
   Server(QObject *parent = 0);
 
 signals:
-  void newConnection(PeerConnection *connection);
+  /**
+   * @brief incomingSocket emitted for every accepted socket, the receiver decides which thread
+   * the connection is created on.
+   * @param socketDescriptor the native descriptor of the accepted socket.
+   */
+  void incomingSocket(qintptr socketDescriptor);
 
 public slots:
-  void start();
+  /**
+   * @brief start listen for peers.
+   * @param preferredPort the port to listen on if it is free, any free port otherwise.
+   */
+  void start(quint16 preferredPort = 0);
   void stop();
 
 protected:
@@ -0,0 +1,117 @@
+#include "timerwheel.h"
+
+#include <QThreadStorage>
+#include <QTimerEvent>
+
+namespace p2pnetworking {
+
+static QThreadStorage<TimerWheel *> wheels;
+
+WheelTimer::WheelTimer(std::function<void()> callback)
+    : wheel(TimerWheel::forCurrentThread()), callback(std::move(callback)), previous(nullptr),
+      next(nullptr), bucket(-1), rounds(0) {
+}
+
+WheelTimer::~WheelTimer() {
+  stop();
+}
+
+void WheelTimer::start(int milliseconds) {
+  if (bucket >= 0)
+    wheel->remove(this);
+  wheel->insert(this, milliseconds);
+}
+
+void WheelTimer::stop() {
+  if (bucket >= 0)
+    wheel->remove(this);
+}
+
+bool WheelTimer::isActive() const {
+  return bucket >= 0;
+}
+
+TimerWheel *TimerWheel::forCurrentThread() {
+  if (!wheels.hasLocalData())
+    wheels.setLocalData(new TimerWheel);
+  return wheels.localData();
+}
+
+TimerWheel::TimerWheel() : current(0), lastTick(0), armed(0), tickTimerId(0) {
+  for (WheelTimer *&head : buckets)
+    head = nullptr;
+  clock.start();
+}
+
+void TimerWheel::timerEvent(QTimerEvent *event) {
+  if (event->timerId() != tickTimerId)
+    return;
+
+  current = (current + 1) % BucketCount;
+  lastTick = clock.elapsed();
+
+  // Decide what expires before calling anything, so timers started by the callbacks wait for
+  // their own turn even when they land in this bucket.
+  for (WheelTimer *timer = buckets[current], *next; timer; timer = next) {
+    next = timer->next;
+    if (timer->rounds > 0) {
+      --timer->rounds;
+    } else {
+      unlink(timer);
+      link(timer, ExpiredBucket);
+    }
+  }
+  // A callback may stop, restart or delete any other expired timer, which takes it off the list.
+  while (WheelTimer *timer = buckets[ExpiredBucket]) {
+    remove(timer);
+    timer->callback();
+  }
+
+  if (armed == 0) {
+    killTimer(tickTimerId);
+    tickTimerId = 0;
+  }
+}
+
+void TimerWheel::insert(WheelTimer *timer, int milliseconds) {
+  if (tickTimerId == 0) {
+    tickTimerId = startTimer(Resolution);
+    lastTick = clock.elapsed();
+  }
+
+  // The n-th tick from now is due n * Resolution after the last one, the first of them that is not
+  // early fires the timer, at most one Resolution late.
+  const qint64 due = clock.elapsed() + qMax(0, milliseconds) - lastTick;
+  const int ticks = int(qMax<qint64>(1, (due + Resolution - 1) / Resolution));
+  timer->rounds = (ticks - 1) / BucketCount;
+  link(timer, (current + ticks) % BucketCount);
+  ++armed;
+}
+
+void TimerWheel::remove(WheelTimer *timer) {
+  unlink(timer);
+  timer->bucket = -1;
+  --armed;
+}
+
+void TimerWheel::link(WheelTimer *timer, int bucket) {
+  timer->bucket = bucket;
+  timer->previous = nullptr;
+  timer->next = buckets[bucket];
+  if (timer->next)
+    timer->next->previous = timer;
+  buckets[bucket] = timer;
+}
+
+void TimerWheel::unlink(WheelTimer *timer) {
+  if (timer->previous)
+    timer->previous->next = timer->next;
+  else
+    buckets[timer->bucket] = timer->next;
+  if (timer->next)
+    timer->next->previous = timer->previous;
+  timer->previous = nullptr;
+  timer->next = nullptr;
+}
+
+} // namespace p2pnetworking
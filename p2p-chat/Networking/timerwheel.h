@@ -0,0 +1,92 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <functional>
+
+namespace p2pnetworking {
+
+class TimerWheel;
+
+/**
+ * @brief The WheelTimer class a single shot timer driven by its thread's TimerWheel. Starting,
+ * restarting and stopping only relink the timer inside the wheel, nothing reaches the event
+ * dispatcher, so it is cheap to re-arm on every read. A WheelTimer belongs to the thread that
+ * created it and must be destroyed before that thread finishes.
+ */
+class WheelTimer {
+public:
+  /**
+   * @brief WheelTimer constructor
+   * @param callback called when the timer expires, it may start or stop any timer.
+   */
+  explicit WheelTimer(std::function<void()> callback);
+  ~WheelTimer();
+
+  /**
+   * @brief start (re)arm the timer. It expires after at least the given time and at most one
+   * TimerWheel::Resolution later.
+   * @param milliseconds the timeout.
+   */
+  void start(int milliseconds);
+  void stop();
+  bool isActive() const;
+
+private:
+  friend class TimerWheel;
+  WheelTimer(const WheelTimer &) = delete;
+  WheelTimer &operator=(const WheelTimer &) = delete;
+
+  TimerWheel *wheel;
+  std::function<void()> callback;
+  WheelTimer *previous; /**< neighbours in the bucket list */
+  WheelTimer *next;
+  int bucket;           /**< the bucket the timer is linked into, -1 when stopped */
+  int rounds;           /**< full turns of the wheel left before it expires */
+};
+
+/**
+ * @brief The TimerWheel class a hashed timer wheel shared by every WheelTimer of a thread. One Qt
+ * timer ticks the wheel while any timer is armed, and each tick only looks at the timers that fall
+ * into the current bucket, so the cost of a thousand idle connections is a few wakeups a second.
+ */
+class TimerWheel : public QObject {
+  Q_OBJECT
+
+public:
+  /** the tick interval, in milliseconds */
+  static const int Resolution = 250;
+
+  /**
+   * @brief forCurrentThread the wheel of the calling thread, created on first use and deleted
+   * when the thread finishes.
+   */
+  static TimerWheel *forCurrentThread();
+
+protected:
+  void timerEvent(QTimerEvent *event) override;
+
+private:
+  friend class WheelTimer;
+  static const int BucketCount = 256;
+  /** expired timers wait in this extra bucket while their callbacks run */
+  static const int ExpiredBucket = BucketCount;
+
+  TimerWheel();
+  void insert(WheelTimer *timer, int milliseconds);
+  void remove(WheelTimer *timer);
+  void link(WheelTimer *timer, int bucket);
+  void unlink(WheelTimer *timer);
+
+  WheelTimer *buckets[BucketCount + 1]; /**< heads of the bucket lists */
+  int current;                          /**< the bucket handled by the last tick */
+  QElapsedTimer clock;
+  qint64 lastTick;                      /**< clock time of the last tick, or of starting them */
+  int armed;                            /**< timers linked into any bucket */
+  int tickTimerId;
+};
+
+} // namespace p2pnetworking
+
+#endif
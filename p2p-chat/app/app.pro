@@ -0,0 +1,41 @@
+#-------------------------------------------------
+#
+# The widgets chat client.
+#
+#-------------------------------------------------
+
+QT       += core gui network concurrent
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+TARGET = P2PChat
+TEMPLATE = app
+
+# The following define makes your compiler emit warnings if you use
+# any feature of Qt which has been marked as deprecated (the exact warnings
+# depend on your compiler). Please consult the documentation of the
+# deprecated API in order to know how to port your code away from it.
+DEFINES += QT_DEPRECATED_WARNINGS
+
+include(../core/core.pri)
+
+SOURCES += \
+    ../main.cpp \
+    ../chatwindow.cpp \
+    ../htmldelegate.cpp \
+    ../setprofile.cpp \
+    ../selectparticipants.cpp
+
+HEADERS += \
+    ../chatwindow.h \
+    ../htmldelegate.h \
+    ../setprofile.h \
+    ../selectparticipants.h
+
+FORMS += \
+    ../chatwindow.ui \
+    ../setprofile.ui \
+    ../selectparticipants.ui
+
+RESOURCES += \
+    ../resources.qrc
@@ -0,0 +1,64 @@
+#include "avatarcache.h"
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+AvatarCache::AvatarCache(const QString &directory)
+        : directory(directory.isEmpty() ? defaultDirectory() : directory) {
+}
+
+QString AvatarCache::defaultDirectory() {
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + QStringLiteral("/avatars");
+}
+
+bool AvatarCache::isHash(const QByteArray &hash) {
+    if (hash.size() != 64)
+        return false;
+    for (const char c : hash) {
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f')))
+            return false;
+    }
+    return true;
+}
+
+EncodedImage AvatarCache::find(const QByteArray &hash) {
+    if (!isHash(hash))
+        return EncodedImage();
+    auto avatar = avatars.constFind(hash);
+    if (avatar != avatars.constEnd())
+        return avatar.value();
+
+    QFile file(fileName(hash));
+    if (!file.open(QIODevice::ReadOnly))
+        return EncodedImage();
+    const EncodedImage cached = EncodedImage::fromData(file.readAll());
+    // a damaged file is ignored, and replaced once the avatar is fetched again
+    if (cached.hash() != hash)
+        return EncodedImage();
+
+    avatars.insert(hash, cached);
+    return cached;
+}
+
+void AvatarCache::insert(const EncodedImage &avatar) {
+    if (avatar.isNull())
+        return;
+    const QByteArray hash = avatar.hash();
+    if (avatars.contains(hash))
+        return;
+    avatars.insert(hash, avatar);
+
+    if (QFile::exists(fileName(hash)))
+        return;
+    QDir().mkpath(directory);
+    QSaveFile file(fileName(hash));
+    if (file.open(QIODevice::WriteOnly)) {
+        file.write(avatar.data());
+        file.commit();
+    }
+}
+
+QString AvatarCache::fileName(const QByteArray &hash) const {
+    return directory + '/' + QString::fromLatin1(hash);
+}
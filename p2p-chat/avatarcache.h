@@ -0,0 +1,55 @@
+#ifndef AVATARCACHE_H
+#define AVATARCACHE_H
+
+#include "encodedimage.h"
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+
+/**
+ * @brief The AvatarCache class the avatars seen so far, named by the SHA-256 of their encoded bytes
+ * and kept on disk, one file per avatar, so they survive restarts. A profile only carries the hash
+ * of its avatar, and the avatar is fetched from its owner when it is not in the cache.
+ */
+class AvatarCache {
+public:
+    /**
+     * @brief AvatarCache constructor, nothing is read until an avatar is looked up
+     * @param directory where the avatars are kept, defaultDirectory() if empty
+     */
+    explicit AvatarCache(const QString &directory = QString());
+
+    /**
+     * @brief defaultDirectory the avatars directory in the application's data directory
+     */
+    static QString defaultDirectory();
+
+    /**
+     * @brief isHash test if a hash received from a peer is well formed, and so safe to name a file
+     * @param hash the hash
+     * @return true if the hash is 64 lower case hex digits
+     */
+    static bool isHash(const QByteArray &hash);
+
+    /**
+     * @brief find look an avatar up, in memory then on disk
+     * @param hash the avatar's hash
+     * @return the avatar, null if it is not cached
+     */
+    EncodedImage find(const QByteArray &hash);
+
+    /**
+     * @brief insert add an avatar, written to disk unless it is there already
+     * @param avatar the avatar
+     */
+    void insert(const EncodedImage &avatar);
+
+private:
+    QString fileName(const QByteArray &hash) const;
+
+    QString directory;
+    QHash<QByteArray, EncodedImage> avatars; /**< the avatars looked up or added so far */
+};
+
+#endif // AVATARCACHE_H
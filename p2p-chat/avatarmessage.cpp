@@ -0,0 +1,55 @@
+#include "avatarmessage.h"
+
+
+AvatarMessage::AvatarMessage(const QString &sender, const QByteArray &hash, const QDateTime &timestamp)
+        : Message(sender, timestamp),
+          _hash(hash) {
+
+}
+
+AvatarMessage::AvatarMessage(const QString &sender, const EncodedImage &avatar, const QDateTime &timestamp)
+        : Message(sender, timestamp),
+          _hash(avatar.hash()),
+          _avatar(avatar) {
+
+}
+
+QByteArray AvatarMessage::data() const {
+    QByteArray data = QByteArray::number(Message::AvatarMessage);
+    data += Message::Separator;
+
+    // REQUEST|hash or AVATAR|hash|image
+    if (isRequest()) {
+        data += "REQUEST";
+        data += Message::Separator;
+        data += _hash;
+    } else {
+        data += "AVATAR";
+        data += Message::Separator;
+        data += _hash;
+        data += Message::Separator;
+        data += _avatar.data();
+    }
+
+    return data;
+}
+
+bool AvatarMessage::isBulk() const {
+    return !isRequest();
+}
+
+bool AvatarMessage::isCompressible() const {
+    return false;
+}
+
+bool AvatarMessage::isRequest() const {
+    return _avatar.isNull();
+}
+
+QByteArray AvatarMessage::hash() const {
+    return _hash;
+}
+
+EncodedImage AvatarMessage::avatar() const {
+    return _avatar;
+}
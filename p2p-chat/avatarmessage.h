@@ -0,0 +1,73 @@
+#ifndef AVATARMESSAGE_H
+#define AVATARMESSAGE_H
+
+#include "encodedimage.h"
+#include "message.h"
+
+/**
+ * @brief The AvatarMessage class asks a peer for an avatar missing from the avatar cache, or answers
+ * such a request. Identity messages only carry the hash of the avatar, so each avatar crosses the
+ * network once per peer that has never seen it, instead of with every profile.
+ */
+class AvatarMessage : public Message {
+public:
+    /**
+     * @brief AvatarMessage constructor for a request
+     * @param sender the sender of this message
+     * @param hash the hash of the avatar wanted
+     * @param timestamp the creation or received time of this message
+     */
+    AvatarMessage(const QString &sender, const QByteArray &hash,
+                  const QDateTime &timestamp = QDateTime::currentDateTime());
+
+    /**
+     * @brief AvatarMessage constructor for an answer
+     * @param sender the sender of this message
+     * @param avatar the avatar asked for
+     * @param timestamp the creation or received time of this message
+     */
+    AvatarMessage(const QString &sender, const EncodedImage &avatar,
+                  const QDateTime &timestamp = QDateTime::currentDateTime());
+
+    /**
+     * @brief data convert data to the format required by the network.
+     * @return a QByteArray containing a network compatible representation of this AvatarMessage.
+     */
+    QByteArray data() const override;
+
+    /**
+     * @brief isBulk answers carry an image, and are queued behind interactive traffic
+     * @return true for an answer
+     */
+    bool isBulk() const override;
+
+    /**
+     * @brief isCompressible the avatar is already compressed
+     * @return false
+     */
+    bool isCompressible() const override;
+
+    /**
+     * @brief isRequest check if this message asks for an avatar rather than carries one
+     * @return true for a request
+     */
+    bool isRequest() const;
+
+    /**
+     * @brief hash retrieves the hash of the avatar asked for or carried
+     * @return the hash
+     */
+    QByteArray hash() const;
+
+    /**
+     * @brief avatar retrieves the avatar carried by an answer
+     * @return the avatar, null for a request
+     */
+    EncodedImage avatar() const;
+
+private:
+    const QByteArray _hash; /**< the hash of the avatar */
+    const EncodedImage _avatar; /**< the avatar, null for a request */
+};
+
+#endif // AVATARMESSAGE_H
@@ -1,21 +1,32 @@
 #include "chatwindow.h"
 #include "htmldelegate.h"
 #include "imagemessage.h"
+#include "imagepreviewmessage.h"
+#include "imagesendpolicy.h"
 #include "textmessage.h"
 #include "ui_chatwindow.h"
 #include "privatemessage.h"
 
 #include <QBuffer>
 #include <QFileDialog>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QGuiApplication>
 #include <QHostInfo>
 #include <QMessageBox>
 #include <QMenu>
 #include <QInputDialog>
+#include <QSettings>
+#include <QtConcurrent>
+
+// how long an avatar request may go unanswered before the avatar is asked for again, in milliseconds
+static const qint64 AvatarRequestTimeout = 10000;
 
 ChatWindow::ChatWindow(QWidget *parent)
         : QMainWindow(parent),
           ui(new Ui::ChatWindow),
           client(QSharedPointer<p2pnetworking::Client>::create()),
+          _avatars(QSharedPointer<AvatarCache>::create()),
           _chatStarted(false),
           _isPrivate(false) {
     ui->setupUi(this);
@@ -23,11 +34,27 @@ ChatWindow::ChatWindow(QWidget *parent)
     connect(client.data(), &p2pnetworking::Client::newMessage, this, &ChatWindow::handleMessage);
     connect(client.data(), SIGNAL(newParticipant(QString)), this, SLOT(newParticipant(QString)));
     connect(client.data(), SIGNAL(participantLeft(QString)), this, SLOT(participantLeft(QString)));
+
+    // discovery/mode is "broadcast" (the default) or "multicast", discovery/group the group to join
+    QSettings settings;
+    if (settings.value("discovery/mode").toString() == "multicast")
+        client->setDiscovery(p2pnetworking::DiscoveryMode::Multicast,
+                             QHostAddress(settings.value("discovery/group").toString()));
+    // rendezvous/url replaces the default rendezvous server
+    if (settings.contains("rendezvous/url"))
+        client->setRendezvousUrl(QUrl(settings.value("rendezvous/url").toString()));
+    // relay/overlay joins the relay overlay, for rooms of hundreds
+    client->setRelayOverlay(settings.value("relay/overlay", false).toBool());
+    // multicast/text sends public text to the multicast/textGroup group once instead of to each peer
+    client->setMulticastText(settings.value("multicast/text", false).toBool(),
+                             QHostAddress(settings.value("multicast/textGroup").toString()));
+
     ui->listView->setModel(&historyModel);
     // The HTMLDelegate allows display of HTML formatted text, a subset of HTML is supported.
     // See http://doc.qt.io/qt-5/richtext-html-subset.html - also can be found in built-in help.
-    auto *delegate = new HTMLDelegate(this);
-    ui->listView->setItemDelegate(delegate);
+    _delegate = new HTMLDelegate(this);
+    ui->listView->setItemDelegate(_delegate);
+    connect(_delegate, &HTMLDelegate::imageDecoded, ui->listView->viewport(), QOverload<>::of(&QWidget::update));
 
     ui->noPeople_privateChatroom->hide();
 
@@ -43,6 +70,7 @@ ChatWindow::ChatWindow(ChatWindow *parent, QString chatroomName,
         : ui(new Ui::ChatWindow),
           _parent(parent),
           client(parent->client),
+          _avatars(parent->_avatars),
           _chatStarted(true),
           _isPrivate(true) {
     ui->setupUi(this);
@@ -52,8 +80,9 @@ ChatWindow::ChatWindow(ChatWindow *parent, QString chatroomName,
 
     // setup UI
     ui->listView->setModel(&historyModel);
-    auto delegate = new HTMLDelegate(this);
-    ui->listView->setItemDelegate(delegate);
+    _delegate = new HTMLDelegate(this);
+    ui->listView->setItemDelegate(_delegate);
+    connect(_delegate, &HTMLDelegate::imageDecoded, ui->listView->viewport(), QOverload<>::of(&QWidget::update));
     setWindowTitle(chatroomName);
     ui->createRoom->setToolTip("Invite people...");
     setWindowIcon(QIcon(":/resource/private.png"));
@@ -73,7 +102,18 @@ void ChatWindow::handleMessage(QSharedPointer<Message> message) {
     } else if (QSharedPointer<ImageMessage> img = qSharedPointerDynamicCast<ImageMessage>(message)) {
         // IMAGE MESSAGE
         if (_isPrivate || !img->isPrivate()) {  // IN A PRIVATE WINDOW
-            appendMessage(img->sender(), img->imageRaw(), true);
+            // the image takes the place of its thumbnail, if one came first
+            auto preview = _previews.find(qMakePair(img->sender(), img->name()));
+            QUrl url;
+            if (preview != _previews.end()) {
+                url = preview.value().takeFirst();
+                if (preview.value().isEmpty()) {
+                    _previews.erase(preview);
+                }
+            }
+            if (url.isEmpty() || !_delegate->replaceImage(url, img->encodedImage())) {
+                appendImage(img->sender(), img->encodedImage());
+            }
         } else { // IN A PUBLIC WINDOW
             auto privateWindow = _privateChatWindows.find(img->chatroomName());
             if (privateWindow == _privateChatWindows.end()) {
@@ -84,10 +124,26 @@ void ChatWindow::handleMessage(QSharedPointer<Message> message) {
             }
             privateWindow.value()->handleMessage(img);
         }
+    } else if (QSharedPointer<ImagePreviewMessage> preview = qSharedPointerDynamicCast<ImagePreviewMessage>(message)) {
+        // IMAGE PREVIEW MESSAGE, shown at the image's size until the image arrives
+        if (_isPrivate || !preview->isPrivate()) {
+            _previews[qMakePair(preview->sender(), preview->name())]
+                    << appendImage(preview->sender(), preview->thumbnail(), preview->imageSize());
+        } else {
+            auto privateWindow = _privateChatWindows.find(preview->chatroomName());
+            if (privateWindow == _privateChatWindows.end()) {
+                // NO SUCH PRIVATE WINDOW, create one
+                inviteParticipants(QSharedPointer<QList<QListWidgetItem *>>::create(
+                        ui->participantsListWidget->findItems(preview->sender(), Qt::MatchExactly)),
+                                   preview->chatroomName());
+                privateWindow = _privateChatWindows.find(preview->chatroomName());
+            }
+            privateWindow.value()->handleMessage(preview);
+        }
     } else if (QSharedPointer<FileMessage> file = qSharedPointerDynamicCast<FileMessage>(message)) {
         // FILE MESSAGE
         if (_isPrivate || !file->isPrivate()) {
-            appendMessage(file->sender(), file->file(), false);
+            appendMessage(file->sender(), QByteArray(), false);
             _files.insert(chatHistory.length() - 1, file);
         } else {
             auto privateWindow = _privateChatWindows.find(file->chatroomName());
@@ -102,12 +158,10 @@ void ChatWindow::handleMessage(QSharedPointer<Message> message) {
     } else if (QSharedPointer<IdentityMessage> profile = qSharedPointerDynamicCast<IdentityMessage>(message)) {
         // IDENTITY MESSAGE
         _profiles.insert(profile->sender(), profile);
-        if (!profile->image().isNull()) {
-            auto toUpdate = ui->participantsListWidget->findItems(profile->sender(), Qt::MatchExactly);
-                    foreach (QListWidgetItem *item, toUpdate) {
-                    item->setIcon(QIcon(QPixmap::fromImage(profile->image())));
-                }
-        }
+        resolveAvatar(profile);
+    } else if (QSharedPointer<AvatarMessage> avatar = qSharedPointerDynamicCast<AvatarMessage>(message)) {
+        // AVATAR MESSAGE
+        handleAvatarMessage(avatar);
     } else if (QSharedPointer<PrivateMessage> pMessage = qSharedPointerDynamicCast<PrivateMessage>(message)) {
         // PRIVATE MESSAGE
         if (_isPrivate) { // IN A PRIVATE WINDOW
@@ -141,24 +195,104 @@ void ChatWindow::appendMessage(const QString &from, const QString &message) {
 }
 
 void ChatWindow::appendMessage(const QString &from, const QByteArray &raw, bool isImage) {
-    QString newLine = "<strong>";
-    newLine += from;
-    newLine += ":</strong><br \\>  ";
     if (isImage) {
         // image
-        newLine += "<img src=\"data:image/png;base64,";
-        newLine += raw.toBase64();
-        newLine += "\">";
-    } else {
-        // file
-        newLine += "[FILE] Double click to save. ";
+        appendImage(from, EncodedImage::fromData(raw));
+        return;
     }
+
+    QString newLine = "<strong>";
+    newLine += from;
+    newLine += ":</strong><br \\>  ";
+    // file
+    newLine += "[FILE] Double click to save. ";
     chatHistory << newLine;
     cleanupHistory();
 
     ui->listView->scrollToBottom();
 }
 
+QUrl ChatWindow::appendImage(const QString &from, const EncodedImage &image, const QSize &size) {
+    const QUrl url = _delegate->addImage(image, size);
+
+    QString newLine = "<strong>";
+    newLine += from;
+    newLine += ":</strong><br \\>  ";
+    newLine += _delegate->imageHtml(url);
+    chatHistory << newLine;
+    cleanupHistory();
+
+    ui->listView->scrollToBottom();
+    return url;
+}
+
+void ChatWindow::resolveAvatar(QSharedPointer<IdentityMessage> profile) {
+    const QByteArray hash = profile->avatarHash();
+    if (hash.isEmpty()) {
+        return;
+    }
+
+    EncodedImage avatar = profile->encodedImage();
+    if (!avatar.isNull()) {
+        // sent along by a peer that predates the avatar cache
+        _avatars->insert(avatar);
+    } else {
+        avatar = _avatars->find(hash);
+        if (avatar.isNull()) {
+            // ask again if the last request went unanswered for a while, its peer may have left
+            const qint64 now = QDateTime::currentMSecsSinceEpoch();
+            if (now - _avatarRequests.value(hash, 0) > AvatarRequestTimeout) {
+                _avatarRequests.insert(hash, now);
+                client->sendMessage(QSharedPointer<Message>(new AvatarMessage(client->nickName(), hash)),
+                                    profile->sender());
+            }
+            return;
+        }
+        // keep the avatar with the profile, for viewing it
+        _profiles.insert(profile->sender(), QSharedPointer<IdentityMessage>(
+                new IdentityMessage(profile->sender(), profile->username(), profile->location(),
+                                    profile->timezone(), avatar)));
+    }
+    showAvatar(profile->sender(), avatar);
+}
+
+void ChatWindow::handleAvatarMessage(QSharedPointer<AvatarMessage> message) {
+    if (message->isRequest()) {
+        const EncodedImage avatar = _avatars->find(message->hash());
+        if (!avatar.isNull()) {
+            client->sendMessage(QSharedPointer<Message>(new AvatarMessage(client->nickName(), avatar)),
+                                message->sender());
+        }
+        return;
+    }
+
+    _avatars->insert(message->avatar());
+    _avatarRequests.remove(message->hash());
+    // every profile waiting for this avatar, whoever it was asked from
+    foreach (const QSharedPointer<IdentityMessage> &profile, _profiles.values()) {
+        if (profile->encodedImage().isNull() && profile->avatarHash() == message->hash()) {
+            resolveAvatar(profile);
+        }
+    }
+}
+
+void ChatWindow::showAvatar(const QString &nick, const EncodedImage &avatar) {
+    auto *watcher = new QFutureWatcher<QImage>(this);
+    connect(watcher, &QFutureWatcher<QImage>::finished, this, [this, watcher, nick, avatar]() {
+        // skip an avatar replaced by a newer profile in the meantime
+        if (_profiles.contains(nick) && _profiles.value(nick)->avatarHash() == avatar.hash()
+            && !watcher->result().isNull()) {
+            const QIcon icon(QPixmap::fromImage(watcher->result()));
+            auto toUpdate = ui->participantsListWidget->findItems(nick, Qt::MatchExactly);
+            foreach (QListWidgetItem *item, toUpdate) {
+                item->setIcon(icon);
+            }
+        }
+        watcher->deleteLater();
+    });
+    watcher->setFuture(QtConcurrent::run([avatar]() { return avatar.image(); }));
+}
+
 void ChatWindow::updateProfile(IdentityMessage *im) {
     // update the _myProfile variable
     _myProfile = QSharedPointer<IdentityMessage>(
@@ -166,7 +300,9 @@ void ChatWindow::updateProfile(IdentityMessage *im) {
                                 _chatStarted ? im->username() : im->sender(),
                                 im->location(),
                                 im->timezone(),
-                                im->image()));
+                                im->encodedImage()));
+    // peers only get the avatar's hash, and fetch the avatar from here
+    _avatars->insert(_myProfile->encodedImage());
 
     if (!_chatStarted) { // the chat have not started
         // set the username client
@@ -212,6 +348,14 @@ void ChatWindow::participantLeft(const QString &nick) {
         delete item;
     }
     _profiles.remove(nick);
+    // the images of a participant that left will never arrive, their thumbnails stay as they are
+    for (auto preview = _previews.begin(); preview != _previews.end();) {
+        if (preview.key().first == nick) {
+            preview = _previews.erase(preview);
+        } else {
+            ++preview;
+        }
+    }
 
     if (ui->participantsListWidget->count() == 0) {
         ui->noPeople->show();
@@ -240,29 +384,58 @@ void ChatWindow::on_textSend_clicked() {
 }
 
 void ChatWindow::on_imageSend_clicked() {
+    // holding Shift on the button sends the file as it is
+    const bool sendOriginal = QGuiApplication::keyboardModifiers() & Qt::ShiftModifier;
     QString filename =
             QFileDialog::getOpenFileName(this,
                                          tr("Select an image... "), "",
                                          tr("Images (*.bmp *.gif *.jpg *.jpeg *.png *.pbm *.pgm *.ppm *.xbm *.xpm)"));
     if (!filename.isEmpty()) {
         // user selected a file
-        QImage image(filename);
-        if (image.isNull()) {
-            // read failed
-            QMessageBox::critical(this, tr("Error"), tr("Unable to open the image, please try again. "));
-            return;
-        }
+        // image/maxDimension, image/format ("jpeg" or "webp") and image/quality say how an image is
+        // shrunk before it is sent, image/sendOriginal sends every file as it is
+        QSettings settings;
+        ImageSendPolicy policy;
+        policy.maxDimension = settings.value("image/maxDimension", ImageSendPolicy::DefaultMaxDimension).toInt();
+        policy.format = settings.value("image/format", "jpeg").toByteArray();
+        policy.quality = settings.value("image/quality", ImageSendPolicy::DefaultQuality).toInt();
+        policy.sendOriginal = sendOriginal || settings.value("image/sendOriginal", false).toBool();
+
+        const QString sender = client->nickName();
+        const QString chatroomName = _isPrivate ? windowTitle() : QString();
+        const QString name = filename.right(filename.size() - filename.lastIndexOf("/") - 1);
+
+        // loading, scaling and encoding a photo takes a while, so it is done on a worker thread
+        using Prepared = QPair<QSharedPointer<ImageMessage>, QSharedPointer<ImagePreviewMessage>>;
+        auto *watcher = new QFutureWatcher<Prepared>(this);
+        connect(watcher, &QFutureWatcher<Prepared>::finished, this, [this, watcher]() {
+            const Prepared prepared = watcher->result();
+            watcher->deleteLater();
+            if (prepared.first.isNull()) {
+                // read failed
+                QMessageBox::critical(this, tr("Error"), tr("Unable to open the image, please try again. "));
+                return;
+            }
 
-        // create the message obj
-        QSharedPointer<ImageMessage> message(
-                _isPrivate ? new ImageMessage(client->nickName(), windowTitle(),
-                                              filename.right(filename.size() - filename.lastIndexOf("/") - 1), image)
-                           : new ImageMessage(client->nickName(),
-                                              filename.right(filename.size() - filename.lastIndexOf("/") - 1), image));
-        // send the message
-        _isPrivate ? sendMessageToParticipantList(message) : client->sendMessage(message);
-        // display on local
-        handleMessage(message);
+            // the thumbnail goes ahead on the interactive lane, the image follows on the bulk lane
+            _isPrivate ? sendMessageToParticipantList(prepared.second) : client->sendMessage(prepared.second);
+            _isPrivate ? sendMessageToParticipantList(prepared.first) : client->sendMessage(prepared.first);
+            // display on local
+            handleMessage(prepared.first);
+        });
+        watcher->setFuture(QtConcurrent::run([=]() {
+            // a JPEG or PNG the policy cannot shrink goes out as it is rather than re-encoded
+            const EncodedImage image = policy.apply(EncodedImage::fromFile(filename));
+            if (image.isNull()) {
+                return Prepared();
+            }
+
+            // create the message obj
+            QSharedPointer<ImageMessage> message(
+                    chatroomName.isNull() ? new ImageMessage(sender, name, image)
+                                          : new ImageMessage(sender, chatroomName, name, image));
+            return Prepared(message, ImagePreviewMessage::forImage(*message));
+        }));
     }
 }
 
@@ -272,7 +445,7 @@ void ChatWindow::on_lineEdit_textChanged(const QString &arg1) {
 
 void ChatWindow::cleanupHistory() {
     while (chatHistory.size() > 100) {
-        chatHistory.removeFirst();
+        _delegate->removeImages(chatHistory.takeFirst());
     }
     historyModel.setStringList(chatHistory);
 
@@ -333,12 +506,22 @@ void ChatWindow::on_listView_doubleClicked(const QModelIndex &index) {
 
         if (filename != "") {
             // file name is not empty
-            QFile qfile(filename);
-            if (qfile.open(QIODevice::WriteOnly)) {
-                // the file can be open
-                qfile.write(file.value()->file());
-                qfile.close();
+            bool saved = false;
+            if (file.value()->isOnDisk()) {
+                // streamed files are already on disk, copy them instead of loading them
+                if (QFile::exists(filename)) {
+                    QFile::remove(filename);
+                }
+                saved = QFile::copy(file.value()->localPath(), filename);
             } else {
+                QFile qfile(filename);
+                if (qfile.open(QIODevice::WriteOnly)) {
+                    // the file can be open
+                    saved = qfile.write(file.value()->file()) == file.value()->size();
+                    qfile.close();
+                }
+            }
+            if (!saved) {
                 QMessageBox::critical(this, tr("Error"), tr("Unable to save the file. "));
             }
         }
@@ -350,14 +533,9 @@ void ChatWindow::on_fileSend_clicked() {
                                                     tr("Select a file... "), "",
                                                     tr("Files (*)"));
     if (!filename.isEmpty()) {
-        // user selected a file
-        QFile qfile(filename);
-        QByteArray file;
-        if (qfile.open(QIODevice::ReadOnly)) {
-            // the file can be open
-            file = qfile.readAll();
-            qfile.close();
-        } else {
+        // user selected a file, it is streamed from disk so it is never read in here
+        QFileInfo fileInfo(filename);
+        if (!fileInfo.isFile() || !fileInfo.isReadable()) {
             // read failed
             QMessageBox::critical(this, tr("Error"), tr("Unable to open the file, please try again. "));
             return;
@@ -365,12 +543,10 @@ void ChatWindow::on_fileSend_clicked() {
 
         // create the message obj
         QSharedPointer<FileMessage> message(
-                _isPrivate ? new FileMessage(client->nickName(), windowTitle(),
-                                             filename.right(filename.size() - filename.lastIndexOf("/") - 1), file)
-                           : new FileMessage(client->nickName(),
-                                             filename.right(filename.size() - filename.lastIndexOf("/") - 1), file));
+                new FileMessage(client->nickName(), _isPrivate ? windowTitle() : QString(),
+                                fileInfo.fileName(), fileInfo.absoluteFilePath(), fileInfo.size()));
         // send the message
-        _isPrivate ? sendMessageToParticipantList(message) : client->sendMessage(message);
+        _isPrivate ? client->sendFile(message, participantNames()) : client->sendFile(message);
         // display on local
         handleMessage(message);
     }
@@ -443,7 +619,7 @@ void ChatWindow::on_exportChat_clicked() {
         out << "<table>";
         for (const auto &chatLine : chatHistory) {
             out << "<tr><td>";
-            out << chatLine;
+            out << _delegate->exportHtml(chatLine);
             out << "</tr></td>";
         }
         out << "</table>";
@@ -600,10 +776,17 @@ void ChatWindow::handleActionMessage(QSharedPointer<ActionMessage> message) {
 }
 
 void ChatWindow::sendMessageToParticipantList(QSharedPointer<Message> message) {
+    // the client serializes the message once for the whole list
+    client->sendMessage(message, participantNames());
+}
+
+QStringList ChatWindow::participantNames() const {
+    QStringList participants;
     for (int i = 0; i < ui->participantsListWidget->count(); ++i) {
-        // for each already participated participants, send out the message
-        client->sendMessage(message, ui->participantsListWidget->item(i)->text());
+        // every already participated participant
+        participants << ui->participantsListWidget->item(i)->text();
     }
+    return participants;
 }
 
 void ChatWindow::sendMessageToParticipantList(QString roomName, QSharedPointer<Message> message) {
@@ -667,13 +850,8 @@ void ChatWindow::on_participantsListWidget_customContextMenuRequested(const QPoi
                                                                                      tr("Files (*)"));
                                                 if (!filename.isEmpty()) {
                                                     // user selected a file
-                                                    QFile qfile(filename);
-                                                    QByteArray file;
-                                                    if (qfile.open(QIODevice::ReadOnly)) {
-                                                        // the file can be open
-                                                        file = qfile.readAll();
-                                                        qfile.close();
-                                                    } else {
+                                                    QFileInfo fileInfo(filename);
+                                                    if (!fileInfo.isFile() || !fileInfo.isReadable()) {
                                                         // read failed
                                                         QMessageBox::critical(this, tr("Error"),
                                                                               tr("Unable to open the file, please try "
@@ -682,11 +860,10 @@ void ChatWindow::on_participantsListWidget_customContextMenuRequested(const QPoi
                                                     }
                                                     auto message = QSharedPointer<FileMessage>(
                                                             new FileMessage(client->nickName(), receiver,
-                                                                            filename.right(filename.size() -
-                                                                                           filename.lastIndexOf("/") -
-                                                                                           1),
-                                                                            file));
-                                                    client->sendMessage(message, receiver);
+                                                                            fileInfo.fileName(),
+                                                                            fileInfo.absoluteFilePath(),
+                                                                            fileInfo.size()));
+                                                    client->sendFile(message, QStringList(receiver));
                                                     // if has such room, append the message in
                                                     auto &privateChatWindows = _isPrivate ? _parent->_privateChatWindows
                                                                                           : _privateChatWindows;
@@ -696,6 +873,9 @@ void ChatWindow::on_participantsListWidget_customContextMenuRequested(const QPoi
                                                     }
                                                 }
                                             });
+        participantRightClickMenu.addAction("Connection latency", this, [=]() {
+            showLatency(ui->participantsListWidget->selectedItems().first()->text());
+        });
         if (_isPrivate) {
             participantRightClickMenu.addAction(QIcon(":/resource/kick.png"), "Kick from chatroom",
                                                 this,
@@ -720,3 +900,25 @@ void ChatWindow::on_participantsListWidget_customContextMenuRequested(const QPoi
     }
 }
 
+void ChatWindow::showLatency(const QString &nick) {
+    p2pnetworking::RttStats stats = client->rttStats(nick);
+    if (stats.count() == 0) {
+        QMessageBox::information(this, "Latency of " + nick, "No round trip has been measured yet.");
+        return;
+    }
+
+    auto ms = [](qint64 microseconds) { return QString::number(microseconds / 1000.0, 'f', 1); };
+    QStringList recent;
+    foreach (qint64 sample, stats.recent()) {
+        recent << ms(sample);
+    }
+    QMessageBox::information(this, "Latency of " + nick,
+                             QString("<b>%1</b> round trips measured<br/>"
+                                     "min %2 ms, avg %3 ms, max %4 ms<br/>"
+                                     "p50 %5 ms, p99 %6 ms<br/><br/>"
+                                     "Recent (ms): %7")
+                                     .arg(stats.count())
+                                     .arg(ms(stats.min()), ms(stats.mean()), ms(stats.max()),
+                                          ms(stats.percentile(0.5)), ms(stats.percentile(0.99)),
+                                          recent.join(", ")));
+}
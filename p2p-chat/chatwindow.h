@@ -3,10 +3,13 @@
 
 #include "./Networking/client.h"
 #include "filemessage.h"
+#include "htmldelegate.h"
 #include "message.h"
 #include "setprofile.h"
 #include "selectparticipants.h"
 #include "actionmessage.h"
+#include "avatarcache.h"
+#include "avatarmessage.h"
 #include <QMainWindow>
 #include <QStringList>
 #include <QStringListModel>
@@ -69,6 +72,15 @@ public slots:
      */
     void appendMessage(const QString &from, const QByteArray &raw, bool isImage);
 
+    /**
+     * @brief appendImage append an image into the UI, it is only decoded once it is scrolled into view
+     * @param from message sender
+     * @param image the image
+     * @param size the size to show it at, its own size if invalid
+     * @return the image's URL in the chat history
+     */
+    QUrl appendImage(const QString &from, const EncodedImage &image, const QSize &size = QSize());
+
     /**
      * @brief updateProfile slot is used to process when user's profile changed
      * @param im the IdentityMessage of the user (myself only)
@@ -271,11 +283,48 @@ private:
      */
     void sendMessageToParticipantList(QString roomName, QSharedPointer<Message> message);
 
+    /**
+     * @brief participantNames lists the identifiers of everyone on the participantList.
+     * @return the participants' identifiers (nick[@]ip)
+     */
+    QStringList participantNames() const;
+
+    /**
+     * @brief showLatency show the round trip times measured on the connection to a participant.
+     * @param nick the participant's identifier (nick[@]ip)
+     */
+    void showLatency(const QString &nick);
+
+    /**
+     * @brief resolveAvatar find a profile's avatar, in the profile or the avatar cache, and show it. An
+     * avatar in neither is asked for from the profile's sender.
+     * @param profile the participant's profile
+     */
+    void resolveAvatar(QSharedPointer<IdentityMessage> profile);
+
+    /**
+     * @brief showAvatar decode an avatar on a worker thread, then show it in the participant list.
+     * @param nick the participant's identifier (nick[@]ip)
+     * @param avatar the avatar
+     */
+    void showAvatar(const QString &nick, const EncodedImage &avatar);
+
+    /**
+     * @brief handleAvatarMessage answer a request for an avatar, or show an avatar that was fetched.
+     * @param message the AvatarMessage to be handled
+     */
+    void handleAvatarMessage(QSharedPointer<AvatarMessage> message);
+
     /**
      * @brief ui the ChatWindow UI
      */
     Ui::ChatWindow *ui;
 
+    /**
+     * @brief _delegate draws the chat history, and holds the images in it
+     */
+    HTMLDelegate *_delegate;
+
     /**
      * @brief _parent is used for private chatroom ONLY. Record the parent ChatWindow (i.e. the public
      * chatroom)
@@ -307,11 +356,29 @@ private:
      */
     QMap<int, QSharedPointer<FileMessage>> _files;
 
+    /**
+     * @brief _previews the thumbnails shown for images still on their way, by sender and image name,
+     * oldest first. A sender's entries are dropped when it leaves.
+     */
+    QHash<QPair<QString, QString>, QList<QUrl>> _previews;
+
     /**
      * @brief _profiles stores all received user profiles. Used for public room ONLY
      */
     QMap<QString, QSharedPointer<IdentityMessage>> _profiles;
 
+    /**
+     * @brief _avatars the avatars seen so far, kept on disk by hash. Created by the public room and
+     * shared with its private rooms
+     */
+    QSharedPointer<AvatarCache> _avatars;
+
+    /**
+     * @brief _avatarRequests when each avatar being fetched was asked for, by hash. Used for public
+     * room ONLY
+     */
+    QHash<QByteArray, qint64> _avatarRequests;
+
     /**
      * @brief _privateChatWindows stores all private chatting windows. Used for public room ONLY
      */
@@ -0,0 +1,14 @@
+# Include from a project that links the core library, see core.pro.
+
+INCLUDEPATH += $$PWD/..
+DEPENDPATH += $$PWD/..
+
+win32:CONFIG(release, debug|release): CORE_LIB_DIR = $$OUT_PWD/../core/release
+else:win32:CONFIG(debug, debug|release): CORE_LIB_DIR = $$OUT_PWD/../core/debug
+else: CORE_LIB_DIR = $$OUT_PWD/../core
+
+LIBS += -L$$CORE_LIB_DIR -lp2pchatcore
+
+win32-g++: PRE_TARGETDEPS += $$CORE_LIB_DIR/libp2pchatcore.a
+else:win32: PRE_TARGETDEPS += $$CORE_LIB_DIR/p2pchatcore.lib
+else: PRE_TARGETDEPS += $$CORE_LIB_DIR/libp2pchatcore.a
@@ -0,0 +1,87 @@
+#-------------------------------------------------
+#
+# The networking and message classes, shared by the widgets app and the headless node. Only QtGui
+# is needed (for QImage), never QtWidgets.
+#
+#-------------------------------------------------
+
+QT       += core gui network
+
+TARGET = p2pchatcore
+TEMPLATE = lib
+CONFIG += staticlib
+
+# The following define makes your compiler emit warnings if you use
+# any feature of Qt which has been marked as deprecated (the exact warnings
+# depend on your compiler). Please consult the documentation of the
+# deprecated API in order to know how to port your code away from it.
+DEFINES += QT_DEPRECATED_WARNINGS
+
+# The sources stay at the top of the tree, which is also where their includes are relative to.
+INCLUDEPATH += $$PWD/..
+
+SOURCES += \
+    ../message.cpp \
+    ../Networking/connection.cpp \
+    ../Networking/peermanager.cpp \
+    ../Networking/server.cpp \
+    ../Networking/client.cpp \
+    ../Networking/framedecoder.cpp \
+    ../Networking/filetransfer.cpp \
+    ../Networking/outboundqueue.cpp \
+    ../Networking/compression.cpp \
+    ../Networking/messageframes.cpp \
+    ../Networking/rttstats.cpp \
+    ../Networking/timerwheel.cpp \
+    ../Networking/beacon.cpp \
+    ../Networking/peercache.cpp \
+    ../Networking/rendezvousclient.cpp \
+    ../Networking/discoverytable.cpp \
+    ../Networking/relay.cpp \
+    ../Networking/multicasttransport.cpp \
+    ../messagefactory.cpp \
+    ../textmessage.cpp \
+    ../identitymessage.cpp \
+    ../actionmessage.cpp \
+    ../filemessage.cpp \
+    ../imagemessage.cpp \
+    ../privatemessage.cpp \
+    ../filetransfermessage.cpp \
+    ../encodedimage.cpp \
+    ../imagepreviewmessage.cpp \
+    ../imagesendpolicy.cpp \
+    ../avatarcache.cpp \
+    ../avatarmessage.cpp
+
+HEADERS += \
+    ../message.h \
+    ../Networking/connection.h \
+    ../Networking/peermanager.h \
+    ../Networking/server.h \
+    ../Networking/client.h \
+    ../Networking/framedecoder.h \
+    ../Networking/filetransfer.h \
+    ../Networking/outboundqueue.h \
+    ../Networking/compression.h \
+    ../Networking/messageframes.h \
+    ../Networking/rttstats.h \
+    ../Networking/timerwheel.h \
+    ../Networking/beacon.h \
+    ../Networking/peercache.h \
+    ../Networking/rendezvousclient.h \
+    ../Networking/discoverytable.h \
+    ../Networking/relay.h \
+    ../Networking/multicasttransport.h \
+    ../messagefactory.h \
+    ../textmessage.h \
+    ../identitymessage.h \
+    ../actionmessage.h \
+    ../filemessage.h \
+    ../imagemessage.h \
+    ../privatemessage.h \
+    ../filetransfermessage.h \
+    ../encodedimage.h \
+    ../imagepreviewmessage.h \
+    ../imagesendpolicy.h \
+    ../avatarcache.h \
+    ../avatarmessage.h
@@ -0,0 +1,128 @@
+#include "encodedimage.h"
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QFile>
+#include <QImageReader>
+#include <QMutex>
+
+// Formats that are already compressed, re-encoding them as PNG would only make them larger.
+static bool isCompact(const QByteArray &format) {
+    return format == "jpeg" || format == "jpg" || format == "png" || format == "gif" || format == "webp";
+}
+
+struct EncodedImage::Shared {
+    QImage image;   /**< null for bytes received from a peer, which are decoded on demand */
+    QMutex mutex;   /**< guards data, size and hash, which are filled in lazily */
+    QByteArray data;
+    QSize size;
+    QByteArray hash;
+};
+
+EncodedImage::EncodedImage() = default;
+
+EncodedImage::EncodedImage(const QImage &image)
+        : EncodedImage(image, QByteArray()) {
+
+}
+
+EncodedImage::EncodedImage(const QImage &image, const QByteArray &data) {
+    if (image.isNull() && data.isEmpty())
+        return;
+    d = QSharedPointer<Shared>::create();
+    d->image = image;
+    d->data = data;
+    d->size = image.size();
+}
+
+EncodedImage EncodedImage::fromData(const QByteArray &data) {
+    return EncodedImage(QImage(), data);
+}
+
+EncodedImage EncodedImage::fromFile(const QString &filename) {
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+        return EncodedImage();
+    const QByteArray data = file.readAll();
+
+    QBuffer buffer;
+    buffer.setData(data);
+    buffer.open(QIODevice::ReadOnly);
+    QImageReader reader(&buffer);
+    const QByteArray format = reader.format();
+    const QImage image = reader.read();
+    if (image.isNull())
+        return EncodedImage();
+
+    return EncodedImage(image, isCompact(format) ? data : QByteArray());
+}
+
+EncodedImage EncodedImage::encode(const QImage &image, const char *format, int quality) {
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    if (!image.save(&buffer, format, quality))
+        return EncodedImage();
+
+    return EncodedImage(image, data);
+}
+
+bool EncodedImage::isNull() const {
+    return d.isNull();
+}
+
+bool EncodedImage::isDecoded() const {
+    return d && !d->image.isNull();
+}
+
+QByteArray EncodedImage::hash() const {
+    if (!d)
+        return QByteArray();
+
+    const QByteArray encoded = data();
+    QMutexLocker locker(&d->mutex);
+    if (d->hash.isEmpty()) {
+        d->hash = QCryptographicHash::hash(encoded, QCryptographicHash::Sha256).toHex();
+    }
+    return d->hash;
+}
+
+bool EncodedImage::operator==(const EncodedImage &other) const {
+    return d == other.d;
+}
+
+QSize EncodedImage::size() const {
+    if (!d)
+        return QSize();
+
+    QMutexLocker locker(&d->mutex);
+    if (!d->size.isValid()) {
+        // only the header is read
+        QBuffer buffer(&d->data);
+        buffer.open(QIODevice::ReadOnly);
+        d->size = QImageReader(&buffer).size();
+    }
+    return d->size;
+}
+
+QImage EncodedImage::image() const {
+    if (!d)
+        return QImage();
+    if (!d->image.isNull())
+        return d->image;
+
+    // the bytes of a received image never change, so they can be decoded without the lock
+    return QImage::fromData(d->data);
+}
+
+QByteArray EncodedImage::data() const {
+    if (!d)
+        return QByteArray();
+
+    QMutexLocker locker(&d->mutex);
+    if (d->data.isEmpty()) {
+        QBuffer buffer(&d->data);
+        buffer.open(QIODevice::WriteOnly);
+        d->image.save(&buffer, "PNG");
+    }
+    return d->data;
+}
@@ -0,0 +1,106 @@
+#ifndef ENCODEDIMAGE_H
+#define ENCODEDIMAGE_H
+
+#include <QByteArray>
+#include <QImage>
+#include <QSharedPointer>
+
+/**
+ * @brief The EncodedImage class an image together with its encoded bytes, as sent on the network.
+ * The bytes a file or a peer supplied are kept untouched, an image without any is encoded to PNG
+ * once, on first use. Copies share the bytes, so a message sent to many peers, or sent again, is
+ * never encoded twice.
+ *
+ * Bytes received from a peer are not decoded until image() is called, so receiving an image costs
+ * no more than copying it, and decoding can be left to a worker thread or skipped for an image that
+ * is never shown. Safe to use from any thread.
+ */
+class EncodedImage {
+public:
+    /**
+     * @brief EncodedImage a null image
+     */
+    EncodedImage();
+
+    /**
+     * @brief EncodedImage wrap a decoded image, encoded to PNG when the bytes are first needed
+     * @param image the image
+     */
+    EncodedImage(const QImage &image);
+
+    /**
+     * @brief fromData wrap bytes received from a peer, kept as they are and not decoded yet
+     * @param data the encoded image
+     * @return the image, null if there are no bytes
+     */
+    static EncodedImage fromData(const QByteArray &data);
+
+    /**
+     * @brief fromFile load an image file. A file already in a compact format (JPEG, PNG, GIF or
+     * WebP) is sent as it is, anything else is encoded to PNG.
+     * @param filename the file to load
+     * @return the image, null if the file could not be read
+     */
+    static EncodedImage fromFile(const QString &filename);
+
+    /**
+     * @brief encode encode an image now, in a chosen format
+     * @param image the image
+     * @param format the format, as for QImage::save()
+     * @param quality 0 to 100, or -1 for the format's default
+     * @return the image, null if it could not be encoded
+     */
+    static EncodedImage encode(const QImage &image, const char *format, int quality = -1);
+
+    /**
+     * @brief isNull test if there is no image
+     * @return true if there is no image
+     */
+    bool isNull() const;
+
+    /**
+     * @brief isDecoded test if image() returns without decoding
+     * @return true if the image is held decoded
+     */
+    bool isDecoded() const;
+
+    /**
+     * @brief size retrieves the image's dimensions, from the header of the encoded bytes if the image
+     * is not decoded
+     * @return the dimensions, invalid if they cannot be read
+     */
+    QSize size() const;
+
+    /**
+     * @brief image retrieves the decoded image. An image held only encoded is decoded on every call,
+     * which may take long for a photo, so keep the result, and call this off the UI thread.
+     * @return the image, null if the bytes could not be decoded
+     */
+    QImage image() const;
+
+    /**
+     * @brief data retrieves the encoded image, encoding it on the first call if needed
+     * @return the encoded image, empty for a null image
+     */
+    QByteArray data() const;
+
+    /**
+     * @brief hash retrieves the SHA-256 of the encoded image, which names it in the avatar cache
+     * @return the hash as 64 hex digits, empty for a null image
+     */
+    QByteArray hash() const;
+
+    /**
+     * @brief operator == test if two images are copies of the same one
+     */
+    bool operator==(const EncodedImage &other) const;
+
+private:
+    struct Shared;
+
+    EncodedImage(const QImage &image, const QByteArray &data);
+
+    QSharedPointer<Shared> d; /**< shared by all copies */
+};
+
+#endif // ENCODEDIMAGE_H
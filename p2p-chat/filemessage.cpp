@@ -1,4 +1,5 @@
 #include "filemessage.h"
+#include <QFile>
 
 FileMessage::FileMessage(const QString &sender,
                          const QString &filename,
@@ -6,7 +7,8 @@ FileMessage::FileMessage(const QString &sender,
                          const QDateTime &timestamp)
         : Message(sender, timestamp),
           _filename(QString(filename).replace(Message::SeparatorHTMLCode, QString(Message::Separator))),
-          _file(file) {
+          _file(file),
+          _size(file.size()) {
 
 }
 
@@ -18,7 +20,22 @@ FileMessage::FileMessage(const QString &sender,
         : Message(sender, timestamp),
           _chatroomName(QString(chatroomName).replace(Message::SeparatorHTMLCode, QString(Message::Separator))),
           _filename(QString(filename).replace(Message::SeparatorHTMLCode, QString(Message::Separator))),
-          _file(file) {
+          _file(file),
+          _size(file.size()) {
+
+}
+
+FileMessage::FileMessage(const QString &sender,
+                         const QString &chatroomName,
+                         const QString &filename,
+                         const QString &localPath,
+                         qint64 size,
+                         const QDateTime &timestamp)
+        : Message(sender, timestamp),
+          _chatroomName(QString(chatroomName).replace(Message::SeparatorHTMLCode, QString(Message::Separator))),
+          _filename(QString(filename).replace(Message::SeparatorHTMLCode, QString(Message::Separator))),
+          _localPath(localPath),
+          _size(size) {
 
 }
 
@@ -32,17 +49,41 @@ QByteArray FileMessage::data() const {
 
     data += QString(_filename).replace(Message::Separator, Message::SeparatorHTMLCode);
     data += Message::Separator;
-    data += _file;
+    data += file();
 
     return data;
 }
 
+bool FileMessage::isBulk() const {
+    return true;
+}
+
 QString FileMessage::filename() const {
     return _filename;
 }
 
 QByteArray FileMessage::file() const {
-    return _file;
+    if (!isOnDisk()) {
+        return _file;
+    }
+
+    QFile file(_localPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    return file.readAll();
+}
+
+qint64 FileMessage::size() const {
+    return _size;
+}
+
+QString FileMessage::localPath() const {
+    return _localPath;
+}
+
+bool FileMessage::isOnDisk() const {
+    return !_localPath.isEmpty();
 }
 
 QString FileMessage::chatroomName() const {
@@ -34,12 +34,35 @@ public:
                 const QByteArray &file,
                 const QDateTime &timestamp = QDateTime::currentDateTime());
 
+    /**
+     * @brief Constructor for a FileMessage whose content stays on disk. These are streamed by
+     * p2pnetworking::Client::sendFile() rather than loaded into memory.
+     * @param sender the sender of this message
+     * @param chatroomName the chatroom name or recipient identifier, null for the public room
+     * @param filename the filename of this file of this message
+     * @param localPath the path of the file content on this computer
+     * @param size the size of the file in bytes
+     * @param timestamp the creation or received time of this message
+     */
+    FileMessage(const QString &sender,
+                const QString &chatroomName,
+                const QString &filename,
+                const QString &localPath,
+                qint64 size,
+                const QDateTime &timestamp = QDateTime::currentDateTime());
+
     /**
     * @brief data convert data to the format required by the network.
     * @return a QByteArray containing a network compatible representation of this FileMessage.
     */
     QByteArray data() const override;
 
+    /**
+     * @brief isBulk files are queued behind interactive traffic
+     * @return true
+     */
+    bool isBulk() const override;
+
     /**
      * @brief retrieve the filename of the file
      * @return the filename
@@ -47,11 +70,29 @@ public:
     QString filename() const;
 
     /**
-     * @brief retrieve the file data
+     * @brief retrieve the file data, for a file on disk this reads the whole file
      * @return the file data
      */
     QByteArray file() const;
 
+    /**
+     * @brief size retrieve the size of the file
+     * @return the size in bytes
+     */
+    qint64 size() const;
+
+    /**
+     * @brief localPath retrieve where the content is stored on this computer
+     * @return the path, or an empty string if the content is held in memory
+     */
+    QString localPath() const;
+
+    /**
+     * @brief isOnDisk check if the content is stored on disk rather than in memory
+     * @return true if the content is on disk
+     */
+    bool isOnDisk() const;
+
     /**
      * @brief chatroomName retrieves the chatroom name (private message)
      * @return the chatroom name or recipient identifier (private message)
@@ -68,6 +109,8 @@ private:
     const QString _chatroomName; /**< the chatroom name or recipient identifier (private message) */
     const QString _filename; /**< the filename of this file of this message */
     const QByteArray _file; /**< the data of this file of this message */
+    const QString _localPath; /**< where the content is stored, empty if held in _file */
+    const qint64 _size; /**< the size of the file in bytes */
 };
 
 #endif // FILEMESSAGE_H
@@ -0,0 +1,106 @@
+#include "filetransfermessage.h"
+
+static QByteArray offerContent(const QString &chatroomName, const QString &filename) {
+    QString content;
+    if (!chatroomName.isNull()) {
+        content += QString(chatroomName).replace(Message::Separator, Message::SeparatorHTMLCode) + "/";
+    }
+    content += QString(filename).replace(Message::Separator, Message::SeparatorHTMLCode);
+    return content.toUtf8();
+}
+
+FileTransferMessage::FileTransferMessage(const QString &sender,
+                                         quint32 transferId,
+                                         const QString &chatroomName,
+                                         const QString &filename,
+                                         qint64 size,
+                                         const QDateTime &timestamp)
+        : Message(sender, timestamp),
+          _stage(OFFER),
+          _transferId(transferId),
+          _position(size),
+          _content(offerContent(chatroomName, filename)) {
+
+}
+
+FileTransferMessage::FileTransferMessage(const QString &sender,
+                                         Stage stage,
+                                         quint32 transferId,
+                                         qint64 position,
+                                         const QByteArray &content,
+                                         const QDateTime &timestamp)
+        : Message(sender, timestamp),
+          _stage(stage),
+          _transferId(transferId),
+          _position(position),
+          _content(content) {
+
+}
+
+QByteArray FileTransferMessage::data() const {
+    QByteArray data = QByteArray::number(Message::FileTransferMessage);
+    data += Message::Separator;
+
+    switch (_stage) {
+        case OFFER:
+            data += "OFFER";
+            break;
+        case CHUNK:
+            data += "CHUNK";
+            break;
+        case DONE:
+            data += "DONE";
+            break;
+        case CANCEL:
+            data += "CANCEL";
+            break;
+    }
+    data += Message::Separator;
+    data += QByteArray::number(_transferId);
+    data += Message::Separator;
+    data += QByteArray::number(_position);
+    data += Message::Separator;
+    // the content goes last, so chunk data may contain the separator
+    data += _content;
+
+    return data;
+}
+
+bool FileTransferMessage::isBulk() const {
+    return true;
+}
+
+FileTransferMessage::Stage FileTransferMessage::stage() const {
+    return _stage;
+}
+
+quint32 FileTransferMessage::transferId() const {
+    return _transferId;
+}
+
+qint64 FileTransferMessage::position() const {
+    return _position;
+}
+
+QByteArray FileTransferMessage::content() const {
+    return _content;
+}
+
+QString FileTransferMessage::filename() const {
+    QString name = QString::fromUtf8(_content);
+    const int index = name.indexOf('/');
+    return name.right(name.length() - index - 1).replace(Message::SeparatorHTMLCode, QString(Message::Separator));
+}
+
+QString FileTransferMessage::chatroomName() const {
+    QString name = QString::fromUtf8(_content);
+    const int index = name.indexOf('/');
+    if (index == -1) {
+        return QString();
+    }
+    return name.left(index).replace(Message::SeparatorHTMLCode, QString(Message::Separator));
+}
+
+bool FileTransferMessage::isPrivate() const {
+    return !chatroomName().isNull();
+}
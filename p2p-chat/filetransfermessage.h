@@ -0,0 +1,112 @@
+#ifndef FILETRANSFERMESSAGE_H
+#define FILETRANSFERMESSAGE_H
+
+#include "message.h"
+
+/**
+ * @brief FileTransferMessage is one step of a streamed file transfer. A transfer is an OFFER
+ * announcing the file, a sequence of CHUNKs carrying the content in order, and a DONE carrying the
+ * checksum of the whole file (or a CANCEL if the sender gives up). Unlike FileMessage the file is
+ * never held in memory as a whole on either side.
+ */
+class FileTransferMessage : public Message {
+public:
+    enum Stage {
+        OFFER, CHUNK, DONE, CANCEL
+    };
+
+    /**
+     * @brief FileTransferMessage constructor for an OFFER
+     * @param sender the sender of this message
+     * @param transferId the sender's identifier for this transfer
+     * @param chatroomName the chatroom name or recipient identifier, null for the public room
+     * @param filename the filename of the offered file
+     * @param size the size of the file in bytes
+     * @param timestamp the creation or received time of this message
+     */
+    FileTransferMessage(const QString &sender,
+                        quint32 transferId,
+                        const QString &chatroomName,
+                        const QString &filename,
+                        qint64 size,
+                        const QDateTime &timestamp = QDateTime::currentDateTime());
+
+    /**
+     * @brief FileTransferMessage constructor for any stage
+     * @param sender the sender of this message
+     * @param stage the stage of the transfer, from FileTransferMessage::Stage
+     * @param transferId the sender's identifier for this transfer
+     * @param position the file size (OFFER, DONE) or the offset of the chunk (CHUNK)
+     * @param content the offered name (OFFER), chunk data (CHUNK) or hex SHA-1 checksum (DONE)
+     * @param timestamp the creation or received time of this message
+     */
+    FileTransferMessage(const QString &sender,
+                        Stage stage,
+                        quint32 transferId,
+                        qint64 position,
+                        const QByteArray &content = QByteArray(),
+                        const QDateTime &timestamp = QDateTime::currentDateTime());
+
+    /**
+    * @brief data convert data to the format required by the network.
+    * @return a QByteArray containing a network compatible representation of this FileTransferMessage.
+    */
+    QByteArray data() const override;
+
+    /**
+     * @brief isBulk every stage is queued behind interactive traffic, in the lane of the chunks, so
+     * the stages of a transfer arrive in the order they were sent
+     * @return true
+     */
+    bool isBulk() const override;
+
+    /**
+     * @brief stage retrieve the stage of the transfer
+     * @return the stage
+     */
+    Stage stage() const;
+
+    /**
+     * @brief transferId retrieve the sender's identifier of the transfer
+     * @return the transfer identifier
+     */
+    quint32 transferId() const;
+
+    /**
+     * @brief position retrieve the file size (OFFER, DONE) or chunk offset (CHUNK)
+     * @return the size or offset in bytes
+     */
+    qint64 position() const;
+
+    /**
+     * @brief content retrieve the raw content, see the constructor for its meaning per stage
+     * @return the content
+     */
+    QByteArray content() const;
+
+    /**
+     * @brief filename retrieve the offered filename (OFFER only)
+     * @return the filename
+     */
+    QString filename() const;
+
+    /**
+     * @brief chatroomName retrieve the chatroom name (OFFER only)
+     * @return the chatroom name or recipient identifier, null for the public room
+     */
+    QString chatroomName() const;
+
+    /**
+     * @brief isPrivate check if the offered file is sent to a private room
+     * @return true is private
+     */
+    bool isPrivate() const;
+
+private:
+    const Stage _stage; /**< the stage of the transfer */
+    const quint32 _transferId; /**< the sender's identifier for this transfer */
+    const qint64 _position; /**< the file size or the offset of the chunk */
+    const QByteArray _content; /**< the offered name, chunk data or checksum */
+};
+
+#endif // FILETRANSFERMESSAGE_H
@@ -0,0 +1,25 @@
+#-------------------------------------------------
+#
+# A chat node without a display: joins the chat, logs what it sees and answers with its profile.
+# Links only the core library, so it runs on servers without QtWidgets or a windowing system.
+#
+#-------------------------------------------------
+
+QT       += core gui network
+
+CONFIG += console
+CONFIG -= app_bundle
+
+TARGET = p2pchat-headless
+TEMPLATE = app
+
+# The following define makes your compiler emit warnings if you use
+# any feature of Qt which has been marked as deprecated (the exact warnings
+# depend on your compiler). Please consult the documentation of the
+# deprecated API in order to know how to port your code away from it.
+DEFINES += QT_DEPRECATED_WARNINGS
+
+include(../core/core.pri)
+
+SOURCES += \
+    main.cpp
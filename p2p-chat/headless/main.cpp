@@ -0,0 +1,133 @@
+#include "Networking/client.h"
+#include "actionmessage.h"
+#include "filemessage.h"
+#include "identitymessage.h"
+#include "imagemessage.h"
+#include "privatemessage.h"
+#include "textmessage.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QTimer>
+
+/**
+ * @brief describe a one line summary of a message for the log.
+ * @param message the received message.
+ * @return the summary.
+ */
+static QString describe(const QSharedPointer<Message> &message) {
+    if (QSharedPointer<TextMessage> txt = qSharedPointerDynamicCast<TextMessage>(message))
+        return QString("%1: %2").arg(txt->sender(), txt->message());
+    if (QSharedPointer<PrivateMessage> pm = qSharedPointerDynamicCast<PrivateMessage>(message))
+        return QString("[private to %1] %2: %3").arg(pm->receiver(), pm->sender(), pm->message());
+    if (QSharedPointer<ImageMessage> img = qSharedPointerDynamicCast<ImageMessage>(message))
+        return QString("[image] %1: %2").arg(img->sender(), img->name());
+    if (QSharedPointer<FileMessage> file = qSharedPointerDynamicCast<FileMessage>(message))
+        return QString("[file] %1: %2 (%3 bytes)").arg(file->sender(), file->filename()).arg(file->size());
+    if (QSharedPointer<IdentityMessage> im = qSharedPointerDynamicCast<IdentityMessage>(message))
+        return QString("[profile] %1: %2, %3").arg(im->sender(), im->username(), im->location());
+    if (QSharedPointer<ActionMessage> am = qSharedPointerDynamicCast<ActionMessage>(message))
+        return QString("[action %1] %2: %3").arg(am->action()).arg(am->sender(), am->roomName());
+    return QString("[message] %1").arg(message->sender());
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("p2pchat-headless");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Joins the chat without a user interface and logs what it receives.");
+    parser.addHelpOption();
+    QCommandLineOption nameOption(QStringList() << "n" << "name",
+                                  "The name announced to other users.", "name", "bot");
+    QCommandLineOption locationOption(QStringList() << "l" << "location",
+                                      "The location shown in the profile.", "location", "headless");
+    QCommandLineOption statsOption("stats", "Log traffic statistics every <seconds> seconds.", "seconds");
+    QCommandLineOption discoveryOption("discovery", "Find peers by <mode>, broadcast or multicast.",
+                                       "mode", "broadcast");
+    QCommandLineOption groupOption("group", "The multicast group used for discovery.", "address",
+                                   p2pnetworking::PeerManager::DefaultMulticastGroup);
+    parser.addOption(nameOption);
+    parser.addOption(locationOption);
+    parser.addOption(statsOption);
+    parser.addOption(discoveryOption);
+    QCommandLineOption rendezvousOption("rendezvous", "The rendezvous server, e.g. http://localhost:8080.",
+                                        "url", p2pnetworking::PeerManager::DefaultRendezvousUrl);
+    QCommandLineOption overlayOption("overlay", "Join the relay overlay instead of connecting to every peer.");
+    QCommandLineOption multicastTextOption("multicast-text", "Send public text to <group> once instead of to "
+                                           "each peer.", "group",
+                                           p2pnetworking::MulticastTransport::DefaultGroup);
+    QCommandLineOption sayOption("say", "Send a public text message every <seconds> seconds.", "seconds");
+    parser.addOption(groupOption);
+    parser.addOption(rendezvousOption);
+    parser.addOption(overlayOption);
+    parser.addOption(multicastTextOption);
+    parser.addOption(sayOption);
+    parser.process(a);
+
+    const QString discovery = parser.value(discoveryOption);
+    if (discovery != "broadcast" && discovery != "multicast")
+        parser.showHelp(1);
+
+    p2pnetworking::Client client;
+    client.setUserName(parser.value(nameOption));
+    client.setDiscovery(discovery == "multicast" ? p2pnetworking::DiscoveryMode::Multicast
+                                                 : p2pnetworking::DiscoveryMode::Broadcast,
+                        QHostAddress(parser.value(groupOption)));
+    client.setRendezvousUrl(QUrl::fromUserInput(parser.value(rendezvousOption)));
+    client.setRelayOverlay(parser.isSet(overlayOption));
+    client.setMulticastText(parser.isSet(multicastTextOption), QHostAddress(parser.value(multicastTextOption)));
+    // the same profile a ChatWindow sends, so the node shows up like any other user
+    QSharedPointer<Message> profile(new IdentityMessage(client.nickName(), parser.value(nameOption),
+                                                        parser.value(locationOption), "000", QImage()));
+
+    QObject::connect(&client, &p2pnetworking::Client::newParticipant, &a, [&client, profile](const QString &nick) {
+        qInfo().noquote() << "joined:" << nick;
+        client.sendMessage(profile, nick);
+    });
+    QObject::connect(&client, &p2pnetworking::Client::participantLeft, &a, [](const QString &nick) {
+        qInfo().noquote() << "left:" << nick;
+    });
+    QObject::connect(&client, &p2pnetworking::Client::newMessage, &a, [](QSharedPointer<Message> message) {
+        qInfo().noquote() << describe(message);
+    });
+
+    QTimer statsTimer;
+    if (parser.isSet(statsOption)) {
+        QObject::connect(&statsTimer, &QTimer::timeout, &a, [&client]() {
+            p2pnetworking::CompressionStats stats = client.compressionStats();
+            qInfo().noquote() << QString("compression: sent %1 of %2 bytes, received %3 of %4 bytes, %5 bytes saved")
+                    .arg(stats.wireBytesSent).arg(stats.rawBytesSent)
+                    .arg(stats.wireBytesReceived).arg(stats.rawBytesReceived)
+                    .arg(stats.bytesSaved());
+            p2pnetworking::RelayStats relay = client.relayStats();
+            qInfo().noquote() << QString("relay: sent %1 messages, %2 bytes each, delivered %3, forwarded %4 "
+                                         "(%5 bytes), dropped %6 duplicates")
+                    .arg(relay.originated).arg(relay.bytesPerMessage()).arg(relay.delivered)
+                    .arg(relay.forwarded).arg(relay.forwardedBytes).arg(relay.duplicates);
+            QHash<QString, p2pnetworking::RttStats> rtt = client.rttStats();
+            for (auto it = rtt.constBegin(); it != rtt.constEnd(); ++it) {
+                qInfo().noquote() << QString("rtt %1: %2 samples, min %3 us, avg %4 us, p50 %5 us, p99 %6 us")
+                        .arg(it.key()).arg(it.value().count())
+                        .arg(it.value().min()).arg(it.value().mean())
+                        .arg(it.value().percentile(0.5)).arg(it.value().percentile(0.99));
+            }
+        });
+        statsTimer.start(qMax(1, parser.value(statsOption).toInt()) * 1000);
+    }
+
+    // a steady stream of public messages, e.g. to compare the sender's upload between room sizes
+    QTimer sayTimer;
+    if (parser.isSet(sayOption)) {
+        int said = 0;
+        QObject::connect(&sayTimer, &QTimer::timeout, &a, [&client, said]() mutable {
+            client.sendMessage(QSharedPointer<Message>(
+                    new TextMessage(client.nickName(), QString("message %1").arg(++said))));
+        });
+        sayTimer.start(qMax(1, parser.value(sayOption).toInt()) * 1000);
+    }
+
+    client.start();
+    qInfo().noquote() << "started as" << client.nickName();
+    return a.exec();
+}
@@ -0,0 +1,45 @@
+#!/bin/sh
+# Compares the sender's upload per public message between room sizes, with and without the relay
+# overlay. Starts rooms of headless nodes on this host, one of them sending a message a second,
+# and prints what the sender reported after a minute and how many of the other nodes it listed.
+# With the overlay the bytes per message stay flat as the room grows, without it they grow with the
+# number of peers.
+#
+# usage: overlay-bench.sh path/to/p2pchat-headless [sizes...]
+# Rooms of hundreds need a raised open file limit (ulimit -n).
+
+HEADLESS=${1:?usage: $0 path/to/p2pchat-headless [sizes...]}
+shift
+SIZES=${*:-10 50 200}
+DURATION=60
+# nothing listens there, so the rooms stay on this host
+RENDEZVOUS=http://127.0.0.1:9
+
+run_room() {
+  size=$1
+  mode=$2
+  log=$(mktemp)
+  pids=""
+  i=1
+  while [ "$i" -lt "$size" ]; do
+    "$HEADLESS" --name "node$i" --rendezvous "$RENDEZVOUS" $mode >/dev/null 2>&1 &
+    pids="$pids $!"
+    i=$((i + 1))
+  done
+  # the sender joins last, once the others had time to find each other
+  sleep 5
+  "$HEADLESS" --name sender --rendezvous "$RENDEZVOUS" --say 1 --stats "$DURATION" $mode >"$log" 2>&1 &
+  sender=$!
+  sleep $((DURATION + 5))
+  kill $sender $pids 2>/dev/null
+  wait 2>/dev/null
+  # every other node should be listed, in the overlay too where most are only reached by relays
+  listed=$(($(grep -c '^joined:' "$log") - $(grep -c '^left:' "$log")))
+  echo "$size nodes ${mode:-(full mesh)}: $(grep '^relay:' "$log" | tail -n 1), $listed of $((size - 1)) peers listed"
+  rm -f "$log"
+}
+
+for size in $SIZES; do
+  run_room "$size" ""
+  run_room "$size" --overlay
+done
@@ -1,8 +1,44 @@
 #include "htmldelegate.h"
 #include <QAbstractTextDocumentLayout>
+#include <QFutureWatcher>
 #include <QPainter>
+#include <QRegularExpression>
+#include <QtConcurrent>
 
-HTMLDelegate::HTMLDelegate(QObject *parent) : QStyledItemDelegate(parent) {
+const QString HTMLDelegate::ImageScheme = "image";
+
+static const QRegularExpression ImageSource("src=\"(image:[0-9]+)\"");
+
+/**
+ * @brief The ItemDocument class an item's HTML, which takes the delegate's images from it.
+ */
+class ItemDocument : public QTextDocument {
+public:
+    explicit ItemDocument(const HTMLDelegate *delegate) : delegate(delegate) {
+    }
+
+protected:
+    QVariant loadResource(int type, const QUrl &name) override {
+        if (type != QTextDocument::ImageResource || name.scheme() != HTMLDelegate::ImageScheme)
+            return QTextDocument::loadResource(type, name);
+
+        QImage image = delegate->decodedImage(name);
+        if (image.isNull()) {
+            // stretched over the image's size until it is decoded
+            image = QImage(1, 1, QImage::Format_RGB32);
+            image.fill(Qt::lightGray);
+        }
+        return image;
+    }
+
+private:
+    const HTMLDelegate *delegate;
+};
+
+HTMLDelegate::HTMLDelegate(QObject *parent)
+        : QStyledItemDelegate(parent),
+          decoded(DecodedCacheSize),
+          nextImage(0) {
 }
 
 void HTMLDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option,
@@ -10,7 +46,7 @@ void HTMLDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option,
     QStyleOptionViewItem options = option;
     initStyleOption(&options, index);
     painter->save();
-    QTextDocument doc;
+    ItemDocument doc(this);
     doc.setTextWidth(options.rect.width()); // Sets the wrapping width
     doc.setHtml(options.text);
 
@@ -37,8 +73,89 @@ QSize HTMLDelegate::sizeHint(const QStyleOptionViewItem &option, const QModelInd
     QStyleOptionViewItem options = option;
     initStyleOption(&options, index);
 
-    QTextDocument doc;
+    // images carry their size in the HTML, so none is loaded here
+    ItemDocument doc(this);
     doc.setHtml(options.text);
     doc.setTextWidth(options.rect.width());
     return QSize(doc.idealWidth(), doc.size().height());
 }
+
+QUrl HTMLDelegate::addImage(const EncodedImage &image, const QSize &size) {
+    const QUrl url(ImageScheme + ':' + QString::number(nextImage++));
+    images.insert(url, image);
+    sizes.insert(url, size.isValid() ? size : image.size());
+    return url;
+}
+
+bool HTMLDelegate::replaceImage(const QUrl &url, const EncodedImage &image) {
+    if (!images.contains(url))
+        return false;
+
+    images.insert(url, image);
+    decoded.remove(url);
+    requested.remove(url);
+    // painting the items again decodes the new image if it is in view
+    emit imageDecoded();
+    return true;
+}
+
+QString HTMLDelegate::imageHtml(const QUrl &url) const {
+    const QSize size = sizes.value(url);
+    QString html = "<img src=\"" + url.toString() + "\"";
+    if (size.isValid()) {
+        html += QString(" width=\"%1\" height=\"%2\"").arg(size.width()).arg(size.height());
+    }
+    html += ">";
+    return html;
+}
+
+void HTMLDelegate::removeImages(const QString &html) {
+    auto match = ImageSource.globalMatch(html);
+    while (match.hasNext()) {
+        const QUrl url(match.next().captured(1));
+        images.remove(url);
+        sizes.remove(url);
+        decoded.remove(url);
+        requested.remove(url);
+    }
+}
+
+QString HTMLDelegate::exportHtml(const QString &html) const {
+    QString exported = html;
+    auto match = ImageSource.globalMatch(html);
+    while (match.hasNext()) {
+        const QString source = match.next().captured(1);
+        exported.replace(source, "data:image/png;base64," + images.value(QUrl(source)).data().toBase64());
+    }
+    return exported;
+}
+
+QImage HTMLDelegate::decodedImage(const QUrl &url) const {
+    if (QImage *image = decoded.object(url))
+        return *image;
+    if (requested.contains(url) || !images.contains(url))
+        return QImage();
+
+    const EncodedImage image = images.value(url);
+    if (image.isDecoded()) {
+        // an image this side sent, nothing to decode
+        return image.image();
+    }
+
+    requested.insert(url);
+    auto *watcher = new QFutureWatcher<QImage>(const_cast<HTMLDelegate *>(this));
+    connect(watcher, &QFutureWatcher<QImage>::finished, this, [this, watcher, url, image]() {
+        const QImage result = watcher->result();
+        // the item may have been removed or its image replaced while decoding, and an image that
+        // cannot be decoded stays requested so it is not tried again
+        if (images.value(url) == image && !result.isNull()) {
+            requested.remove(url);
+            // an image larger than the whole cache still replaces everything else in it
+            decoded.insert(url, new QImage(result), qBound(1, int(result.sizeInBytes() / 1024), DecodedCacheSize));
+            emit const_cast<HTMLDelegate *>(this)->imageDecoded();
+        }
+        watcher->deleteLater();
+    });
+    watcher->setFuture(QtConcurrent::run([image]() { return image.image(); }));
+    return QImage();
+}
@@ -1,20 +1,97 @@
 #ifndef HTMLDELEGATE_H
 #define HTMLDELEGATE_H
 
+#include "encodedimage.h"
+#include <QCache>
+#include <QHash>
+#include <QSet>
 #include <QStyledItemDelegate>
+#include <QUrl>
 
 /**
  * @brief The HTMLDelegate class draws an item in a view with HTML formatting.
  * see the QStyledItemDelegate documentation for more information.
+ *
+ * Images added with addImage() are shown by an item's HTML as <img src="image:..."> with their width
+ * and height, so laying the item out never decodes them. An image is decoded on a worker thread the
+ * first time an item showing it is painted, a placeholder is drawn until then, and imageDecoded()
+ * asks for a repaint. Decoded images are kept in a bounded cache, so history scrolled far away is
+ * decoded again when it comes back into view. An image can be replaced in place, as the full image
+ * replaces its thumbnail.
  */
 class HTMLDelegate : public QStyledItemDelegate {
+Q_OBJECT
+
 public:
+    /** the URL scheme of the images added with addImage() */
+    static const QString ImageScheme;
+    /** kilobytes of decoded images kept */
+    static const int DecodedCacheSize = 256 * 1024;
+
     HTMLDelegate(QObject *parent = 0);
 
     void paint(QPainter *painter, const QStyleOptionViewItem &option,
                const QModelIndex &index) const override;
 
     QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+
+    /**
+     * @brief addImage add an image for items to show
+     * @param image the image, not decoded yet
+     * @param size the size to show it at, its own size if invalid
+     * @return the image's URL
+     */
+    QUrl addImage(const EncodedImage &image, const QSize &size = QSize());
+
+    /**
+     * @brief replaceImage show another image in place of an added one, at the same size
+     * @param url the added image's URL
+     * @param image the image to show instead
+     * @return false if the image is no longer shown
+     */
+    bool replaceImage(const QUrl &url, const EncodedImage &image);
+
+    /**
+     * @brief imageHtml the HTML for an item to show an added image
+     * @param url the image's URL
+     * @return the HTML
+     */
+    QString imageHtml(const QUrl &url) const;
+
+    /**
+     * @brief removeImages forget the images an item showed, once the item is removed
+     * @param html the item's HTML
+     */
+    void removeImages(const QString &html);
+
+    /**
+     * @brief exportHtml replace an item's references to added images with the images themselves
+     * @param html the item's HTML
+     * @return HTML that shows the images anywhere
+     */
+    QString exportHtml(const QString &html) const;
+
+    /**
+     * @brief decodedImage the decoded image for a URL, requesting the decoding if it is not ready
+     * @param url the image's URL
+     * @return the image, null while it is being decoded
+     */
+    QImage decodedImage(const QUrl &url) const;
+
+signals:
+
+    /**
+     * @brief imageDecoded emitted when an image finished decoding, the items showing it should be
+     * painted again
+     */
+    void imageDecoded();
+
+private:
+    QHash<QUrl, EncodedImage> images; /**< the added images */
+    QHash<QUrl, QSize> sizes; /**< the sizes they are shown at */
+    mutable QCache<QUrl, QImage> decoded; /**< costs in kilobytes */
+    mutable QSet<QUrl> requested; /**< being decoded, or could not be decoded */
+    quint64 nextImage;
 };
 
 #endif // HTMLDELEGATE_H
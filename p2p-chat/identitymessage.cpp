@@ -1,14 +1,28 @@
 #include "identitymessage.h"
-#include <QBuffer>
+
+const QByteArray IdentityMessage::AvatarHashPrefix = "sha256:";
+
+IdentityMessage::IdentityMessage(const QString &sender, const QString &username,
+                                 const QString &location, const QString &timezone, const EncodedImage &image,
+                                 const QDateTime &timestamp, bool inlineAvatar)
+        : Message(sender, timestamp),
+          _username(QString(username).replace(Message::SeparatorHTMLCode, QString(Message::Separator))),
+          _location(QString(location).replace(Message::SeparatorHTMLCode, QString(Message::Separator))),
+          _timezone(timezone),
+          _image(image),
+          _inlineAvatar(inlineAvatar) {
+
+}
 
 IdentityMessage::IdentityMessage(const QString &sender, const QString &username,
-                                 const QString &location, const QString &timezone, const QImage &image,
+                                 const QString &location, const QString &timezone, const QByteArray &avatarHash,
                                  const QDateTime &timestamp)
         : Message(sender, timestamp),
           _username(QString(username).replace(Message::SeparatorHTMLCode, QString(Message::Separator))),
           _location(QString(location).replace(Message::SeparatorHTMLCode, QString(Message::Separator))),
           _timezone(timezone),
-          _image(image) {
+          _avatarHash(avatarHash),
+          _inlineAvatar(false) {
 
 }
 
@@ -22,11 +36,28 @@ QByteArray IdentityMessage::data() const {
     data += Message::Separator;
     data += _timezone;
     data += Message::Separator;
-    data += imageRaw();
+    if (_inlineAvatar) {
+        data += imageRaw();
+    } else if (!avatarHash().isEmpty()) {
+        // only the hash, the avatar itself is fetched by the peers that do not have it yet
+        data += AvatarHashPrefix + avatarHash();
+    }
 
     return data;
 }
 
+bool IdentityMessage::isCompressible() const {
+    return false;
+}
+
+QSharedPointer<Message> IdentityMessage::inlineForm() const {
+    if (_inlineAvatar || _image.isNull()) {
+        return QSharedPointer<Message>();
+    }
+    return QSharedPointer<Message>(
+            new IdentityMessage(sender(), _username, _location, _timezone, _image, timestamp(), true));
+}
+
 QString IdentityMessage::username() const {
     return _username;
 }
@@ -40,14 +71,17 @@ QString IdentityMessage::timezone() const {
 }
 
 QImage IdentityMessage::image() const {
-    return _image;
+    return _image.image();
+}
+
+QByteArray IdentityMessage::avatarHash() const {
+    return _image.isNull() ? _avatarHash : _image.hash();
 }
 
 QByteArray IdentityMessage::imageRaw() const {
-    QByteArray image;
-    QBuffer imageBuffer(&image);
-    imageBuffer.open(QIODevice::WriteOnly);
-    _image.save(&imageBuffer, "PNG");
+    return _image.data();
+}
 
-    return image;
+EncodedImage IdentityMessage::encodedImage() const {
+    return _image;
 }
@@ -1,12 +1,15 @@
 #ifndef IDENTITYMESSAGE_H
 #define IDENTITYMESSAGE_H
 
+#include "encodedimage.h"
 #include <QImage>
 #include <QTimeZone>
 #include "message.h"
 
 /**
- * @brief IdentityMessage represents a user's profile
+ * @brief IdentityMessage represents a user's profile. The avatar travels as its hash, peers fetch it
+ * with an AvatarMessage when it is not in their AvatarCache. Peers from before avatar hashes get
+ * the avatar inline, see inlineForm().
  */
 
 class IdentityMessage : public Message {
@@ -19,12 +22,30 @@ public:
      * @param timezone time zone format sample: +930
      * @param image the avatar of the user
      * @param timestamp the creation or received time of this message
+     * @param inlineAvatar true to send the avatar itself instead of its hash
      */
     IdentityMessage(const QString &sender,
                     const QString &username,
                     const QString &location,
                     const QString &timezone,
-                    const QImage &image,
+                    const EncodedImage &image,
+                    const QDateTime &timestamp = QDateTime::currentDateTime(),
+                    bool inlineAvatar = false);
+
+    /**
+     * @brief IdentityMessage constructor for a profile received with the hash of its avatar only
+     * @param sender the sender of this message
+     * @param username the username of the account
+     * @param location the location of the user
+     * @param timezone time zone format sample: +930
+     * @param avatarHash the hash of the avatar, empty without one
+     * @param timestamp the creation or received time of this message
+     */
+    IdentityMessage(const QString &sender,
+                    const QString &username,
+                    const QString &location,
+                    const QString &timezone,
+                    const QByteArray &avatarHash,
                     const QDateTime &timestamp = QDateTime::currentDateTime());
 
     /**
@@ -33,6 +54,18 @@ public:
      */
     QByteArray data() const override;
 
+    /**
+     * @brief isCompressible a profile is a few short fields and the avatar's hash, too little to compress
+     * @return false
+     */
+    bool isCompressible() const override;
+
+    /**
+     * @brief inlineForm the profile with its avatar inline, for peers from before avatar hashes
+     * @return a copy with the avatar inline, null without an avatar to send
+     */
+    QSharedPointer<Message> inlineForm() const override;
+
     /**
     * @brief retrieve the username text
     * @return the username text
@@ -53,21 +86,39 @@ public:
 
     /**
     * @brief retrieve the user's avatar
-    * @return the avatar image
+    * @return the avatar image, null if only its hash is known
     */
     QImage image() const;
 
     /**
-     * @brief imageRaw retrieves the image raw data inside a QByteArray
+     * @brief avatarHash retrieves the hash of the avatar
+     * @return the hash, empty without an avatar
+     */
+    QByteArray avatarHash() const;
+
+    /**
+     * @brief imageRaw retrieves the image raw data inside a QByteArray, encoded at most once
      * @return image raw data inside a QByteArray
      */
     QByteArray imageRaw() const;
 
+    /**
+     * @brief encodedImage retrieves the image together with its encoded data, to build another
+     * message without encoding the image again
+     * @return the image
+     */
+    EncodedImage encodedImage() const;
+
+    /** put before the avatar's hash where older versions put the avatar */
+    static const QByteArray AvatarHashPrefix;
+
 private:
     const QString _username; /**< the user's name */
     const QString _location; /**< the user's location */
     const QString _timezone; /**< the user's timezone */
-    const QImage _image; /**< the user's avatar */
+    const EncodedImage _image; /**< the user's avatar */
+    const QByteArray _avatarHash; /**< the hash of the avatar, when the avatar itself is not known */
+    const bool _inlineAvatar; /**< send the avatar itself instead of its hash */
 };
 
 #endif // IDENTITYMESSAGE_H
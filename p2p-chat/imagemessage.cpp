@@ -1,11 +1,10 @@
 #include "imagemessage.h"
-#include <QBuffer>
 #include <QDebug>
 
 
 ImageMessage::ImageMessage(const QString &sender,
                            const QString &name,
-                           const QImage &image,
+                           const EncodedImage &image,
                            const QDateTime &timestamp)
         : Message(sender, timestamp),
           _name(QString(name).replace(Message::SeparatorHTMLCode, QString(Message::Separator))),
@@ -16,7 +15,7 @@ ImageMessage::ImageMessage(const QString &sender,
 ImageMessage::ImageMessage(const QString &sender,
                            const QString &chatroomName,
                            const QString &name,
-                           const QImage &image,
+                           const EncodedImage &image,
                            const QDateTime &timestamp)
         : Message(sender, timestamp),
           _chatroomName(QString(chatroomName).replace(Message::SeparatorHTMLCode, QString(Message::Separator))),
@@ -41,21 +40,28 @@ QByteArray ImageMessage::data() const {
     return data;
 }
 
+bool ImageMessage::isBulk() const {
+    return true;
+}
+
+bool ImageMessage::isCompressible() const {
+    return false;
+}
+
 QString ImageMessage::name() const {
     return _name;
 }
 
 QImage ImageMessage::image() const {
-    return _image;
+    return _image.image();
 }
 
 QByteArray ImageMessage::imageRaw() const {
-    QByteArray image;
-    QBuffer imageBuffer(&image);
-    imageBuffer.open(QIODevice::WriteOnly);
-    _image.save(&imageBuffer, "PNG");
+    return _image.data();
+}
 
-    return image;
+EncodedImage ImageMessage::encodedImage() const {
+    return _image;
 }
 
 QString ImageMessage::chatroomName() const {
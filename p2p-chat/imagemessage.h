@@ -1,6 +1,7 @@
 #ifndef IMAGEMESSAGE_H
 #define IMAGEMESSAGE_H
 
+#include "encodedimage.h"
 #include "message.h"
 
 #include <QImage>
@@ -15,7 +16,7 @@ public:
      * @param image the image data of this image of this message
      * @param timestamp the creation or received time of this message
      */
-    ImageMessage(const QString &sender, const QString &name, const QImage &image,
+    ImageMessage(const QString &sender, const QString &name, const EncodedImage &image,
                  const QDateTime &timestamp = QDateTime::currentDateTime());
 
     /**
@@ -26,7 +27,7 @@ public:
      * @param image the image data of this image of this message
      * @param timestamp the creation or received time of this message
      */
-    ImageMessage(const QString &sender, const QString &chatroomName, const QString &name, const QImage &image,
+    ImageMessage(const QString &sender, const QString &chatroomName, const QString &name, const EncodedImage &image,
                  const QDateTime &timestamp = QDateTime::currentDateTime());
 
     /**
@@ -35,6 +36,18 @@ public:
      */
     QByteArray data() const override;
 
+    /**
+     * @brief isBulk images are queued behind interactive traffic
+     * @return true
+     */
+    bool isBulk() const override;
+
+    /**
+     * @brief isCompressible images are sent in an already compressed format
+     * @return false
+     */
+    bool isCompressible() const override;
+
     /**
      * @brief name retrieves the filename of the image
      * @return the filename of this image
@@ -48,11 +61,18 @@ public:
     QImage image() const;
 
     /**
-     * @brief imageRaw retrieves the image raw data inside a QByteArray
+     * @brief imageRaw retrieves the image raw data inside a QByteArray, encoded at most once
      * @return image raw data inside a QByteArray
      */
     QByteArray imageRaw() const;
 
+    /**
+     * @brief encodedImage retrieves the image together with its encoded data, to build another
+     * message without encoding the image again
+     * @return the image
+     */
+    EncodedImage encodedImage() const;
+
     /**
      * @brief chatroomName retrieves the chatroom name (private message)
      * @return the chatroom name or recipient identifier (private message)
@@ -68,7 +88,7 @@ public:
 private:
     const QString _chatroomName; /**< the chatroom name or recipient identifier (private message) */
     const QString _name; /**< the name of this image of this message */
-    const QImage _image; /**< the data of this image of this message */
+    const EncodedImage _image; /**< the data of this image of this message */
 };
 
 #endif // IMAGEMESSAGE_H
@@ -0,0 +1,72 @@
+#include "imagepreviewmessage.h"
+
+
+ImagePreviewMessage::ImagePreviewMessage(const QString &sender,
+                                         const QString &chatroomName,
+                                         const QString &name,
+                                         const QSize &imageSize,
+                                         const EncodedImage &thumbnail,
+                                         const QDateTime &timestamp)
+        : Message(sender, timestamp),
+          _chatroomName(QString(chatroomName).replace(Message::SeparatorHTMLCode, QString(Message::Separator))),
+          _name(QString(name).replace(Message::SeparatorHTMLCode, QString(Message::Separator))),
+          _imageSize(imageSize),
+          _thumbnail(thumbnail) {
+
+}
+
+QSharedPointer<ImagePreviewMessage> ImagePreviewMessage::forImage(const ImageMessage &image) {
+    const QImage full = image.image();
+    const QImage scaled = full.width() > ThumbnailSize || full.height() > ThumbnailSize
+                          ? full.scaled(ThumbnailSize, ThumbnailSize, Qt::KeepAspectRatio, Qt::SmoothTransformation)
+                          : full;
+
+    // JPEG would turn transparent areas black
+    const EncodedImage thumbnail = scaled.hasAlphaChannel() ? EncodedImage::encode(scaled, "PNG")
+                                                            : EncodedImage::encode(scaled, "JPEG", ThumbnailQuality);
+
+    return QSharedPointer<ImagePreviewMessage>::create(image.sender(), image.chatroomName(), image.name(),
+                                                       full.size(), thumbnail);
+}
+
+QByteArray ImagePreviewMessage::data() const {
+    QByteArray data = QByteArray::number(Message::ImagePreviewMessage);
+    data += Message::Separator;
+
+    if (isPrivate()) {
+        data += QString(_chatroomName).replace(Message::Separator, Message::SeparatorHTMLCode) + "/";
+    }
+
+    data += QString(_name).replace(Message::Separator, Message::SeparatorHTMLCode);
+    data += Message::Separator;
+    data += QByteArray::number(_imageSize.width()) + 'x' + QByteArray::number(_imageSize.height());
+    data += Message::Separator;
+
+    data += _thumbnail.data();
+
+    return data;
+}
+
+bool ImagePreviewMessage::isCompressible() const {
+    return false;
+}
+
+QString ImagePreviewMessage::name() const {
+    return _name;
+}
+
+QSize ImagePreviewMessage::imageSize() const {
+    return _imageSize;
+}
+
+EncodedImage ImagePreviewMessage::thumbnail() const {
+    return _thumbnail;
+}
+
+QString ImagePreviewMessage::chatroomName() const {
+    return _chatroomName;
+}
+
+bool ImagePreviewMessage::isPrivate() const {
+    return !_chatroomName.isNull();
+}
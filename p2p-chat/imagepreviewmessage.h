@@ -0,0 +1,92 @@
+#ifndef IMAGEPREVIEWMESSAGE_H
+#define IMAGEPREVIEWMESSAGE_H
+
+#include "encodedimage.h"
+#include "imagemessage.h"
+#include "message.h"
+
+#include <QSize>
+
+/**
+ * @brief The ImagePreviewMessage class a thumbnail of an image, sent ahead of the ImageMessage on the
+ * interactive lane so the receiver can show something while the image itself queues behind other
+ * bulk data. The receiver matches the image to its preview by sender, chatroom and name. Peers that do
+ * not know this message drop it, and still get the image.
+ */
+class ImagePreviewMessage : public Message {
+public:
+    /** the longest side of a thumbnail, in pixels */
+    static const int ThumbnailSize = 160;
+    /** the JPEG quality of a thumbnail */
+    static const int ThumbnailQuality = 60;
+
+    /**
+     * @brief ImagePreviewMessage constructor
+     * @param sender the sender of this message
+     * @param chatroomName the chatroom name or recipient identifier, null for the public room
+     * @param name the name of the image file
+     * @param imageSize the dimensions of the image itself, the thumbnail is shown at this size
+     * @param thumbnail the thumbnail
+     * @param timestamp the creation or received time of this message
+     */
+    ImagePreviewMessage(const QString &sender, const QString &chatroomName, const QString &name,
+                        const QSize &imageSize, const EncodedImage &thumbnail,
+                        const QDateTime &timestamp = QDateTime::currentDateTime());
+
+    /**
+     * @brief forImage create the preview of an image about to be sent
+     * @param image the image message
+     * @return the preview
+     */
+    static QSharedPointer<ImagePreviewMessage> forImage(const ImageMessage &image);
+
+    /**
+     * @brief data convert data to the format required by the network.
+     * @return a QByteArray containing a network compatible representation of this ImagePreviewMessage.
+     */
+    QByteArray data() const override;
+
+    /**
+     * @brief isCompressible the thumbnail is already compressed
+     * @return false
+     */
+    bool isCompressible() const override;
+
+    /**
+     * @brief name retrieves the filename of the image
+     * @return the filename of the image
+     */
+    QString name() const;
+
+    /**
+     * @brief imageSize retrieves the dimensions of the image itself
+     * @return the dimensions
+     */
+    QSize imageSize() const;
+
+    /**
+     * @brief thumbnail retrieves the thumbnail
+     * @return the thumbnail
+     */
+    EncodedImage thumbnail() const;
+
+    /**
+     * @brief chatroomName retrieves the chatroom name (private message)
+     * @return the chatroom name or recipient identifier (private message)
+     */
+    QString chatroomName() const;
+
+    /**
+     * @brief isPrivate check if this message is a private message
+     * @return true is private
+     */
+    bool isPrivate() const;
+
+private:
+    const QString _chatroomName; /**< the chatroom name or recipient identifier (private message) */
+    const QString _name; /**< the name of the image */
+    const QSize _imageSize; /**< the dimensions of the image */
+    const EncodedImage _thumbnail; /**< the thumbnail */
+};
+
+#endif // IMAGEPREVIEWMESSAGE_H
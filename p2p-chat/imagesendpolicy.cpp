@@ -0,0 +1,28 @@
+#include "imagesendpolicy.h"
+#include <QImageWriter>
+
+EncodedImage ImageSendPolicy::apply(const EncodedImage &image) const {
+    if (sendOriginal || image.isNull())
+        return image;
+
+    QImage decoded = image.image();
+    const bool scale = maxDimension > 0 && (decoded.width() > maxDimension || decoded.height() > maxDimension);
+    if (scale) {
+        decoded = decoded.scaled(maxDimension, maxDimension, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+
+    QByteArray target = format;
+    if (target == "webp" && !QImageWriter::supportedImageFormats().contains("webp")) {
+        target = "jpeg";
+    }
+    if (target == "jpeg" && decoded.hasAlphaChannel()) {
+        // JPEG has no transparency, the transparent areas would turn black
+        target = "png";
+    }
+
+    const EncodedImage encoded = EncodedImage::encode(decoded, target.constData(), quality);
+    if (encoded.isNull() || (!scale && encoded.data().size() >= image.data().size())) {
+        return image;
+    }
+    return encoded;
+}
@@ -0,0 +1,31 @@
+#ifndef IMAGESENDPOLICY_H
+#define IMAGESENDPOLICY_H
+
+#include "encodedimage.h"
+
+#include <QByteArray>
+
+/**
+ * @brief The ImageSendPolicy struct how an image is prepared before it is sent. An image larger than
+ * maxDimension is scaled down, and the image is encoded as format at quality, unless that would not
+ * make it smaller. A photo straight off a phone or a PNG screenshot becomes a fraction of its size.
+ * Applying the policy decodes and encodes the image, so it belongs on a worker thread.
+ */
+struct ImageSendPolicy {
+    static const int DefaultMaxDimension = 2048;
+    static const int DefaultQuality = 80;
+
+    int maxDimension = DefaultMaxDimension; /**< the longest side after scaling, 0 to never scale */
+    QByteArray format = "jpeg"; /**< "jpeg" or "webp", webp falls back to jpeg without the plugin */
+    int quality = DefaultQuality; /**< 0 to 100 */
+    bool sendOriginal = false; /**< send the file as it is */
+
+    /**
+     * @brief apply prepare an image for sending
+     * @param image the image as loaded
+     * @return the image to send, the one given if the policy would not make it smaller
+     */
+    EncodedImage apply(const EncodedImage &image) const;
+};
+
+#endif // IMAGESENDPOLICY_H
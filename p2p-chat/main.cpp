@@ -4,6 +4,9 @@
 
 int main(int argc, char *argv[]) {
     QApplication a(argc, argv);
+    // where QSettings keeps the preferences
+    QCoreApplication::setOrganizationName("p2pchat");
+    QCoreApplication::setApplicationName("p2pchat");
 
     ChatWindow w;
     w.show();
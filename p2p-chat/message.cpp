@@ -9,10 +9,26 @@ QString Message::sender() const {
     return _sender;
 }
 
+void Message::setSender(const QString &sender) {
+    _sender = sender;
+}
+
 bool Message::isEmpty() const {
     return _sender.isEmpty();
 }
 
+bool Message::isBulk() const {
+    return false;
+}
+
+QSharedPointer<Message> Message::inlineForm() const {
+    return QSharedPointer<Message>();
+}
+
+bool Message::isCompressible() const {
+    return true;
+}
+
 QDateTime Message::timestamp() const {
     return _timestamp;
 }
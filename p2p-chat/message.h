@@ -3,6 +3,8 @@
 
 #include <QByteArray>
 #include <QDateTime>
+#include <QMetaType>
+#include <QSharedPointer>
 
 /**
  * @brief The Message class represents a message passed between peers.
@@ -27,6 +29,13 @@ public:
      */
     QString sender() const;
 
+    /**
+     * @brief setSender attribute a received message to the participant it came from, which the
+     * network layer may know by another name than the connection it arrived on.
+     * @param sender the sender's identity.
+     */
+    void setSender(const QString &sender);
+
     /**
      * @brief data convert the message to the format expected for transmission over the network.
      * @return a QByteArray containing the data to send across the network.
@@ -39,6 +48,27 @@ public:
      */
     virtual bool isEmpty() const;
 
+    /**
+     * @brief isBulk test if this message carries bulk data (images, files) that should queue behind
+     * interactive traffic such as text and control messages
+     * @return true if this message is bulk data
+     */
+    virtual bool isBulk() const;
+
+    /**
+     * @brief isCompressible test if the network data of this message is worth compressing, false for
+     * messages that mostly carry already compressed data such as PNG or JPEG images
+     * @return true if this message may be compressed on the wire
+     */
+    virtual bool isCompressible() const;
+
+    /**
+     * @brief inlineForm the message as sent to peers from before avatar hashes, which expect every
+     * image inline
+     * @return a copy carrying its images inline, null if this message is understood as it is
+     */
+    virtual QSharedPointer<Message> inlineForm() const;
+
     /**
      * @brief timestamp retrieve the creation or received time of this message.
      * @return the creation or receive time of the message.
@@ -52,6 +82,9 @@ public:
     static const int FileMessage = 3;
     static const int ImageMessage = 4;
     static const int PrivateMessage = 5;
+    static const int FileTransferMessage = 6;
+    static const int ImagePreviewMessage = 7;
+    static const int AvatarMessage = 8;
     // The separator character is used to delimit data. It is reserved, make sure you do not allow
     // your users to send it (unless you HTML encode it).
     static const char Separator = '|';
@@ -62,4 +95,7 @@ private:
     QDateTime _timestamp; /**< the creation or received time of this message. */
 };
 
+// Messages are handed from the network threads to the UI thread through queued signals.
+Q_DECLARE_METATYPE(QSharedPointer<Message>)
+
 #endif // MESSAGE_H
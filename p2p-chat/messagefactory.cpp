@@ -4,7 +4,11 @@
 #include "actionmessage.h"
 #include "filemessage.h"
 #include "imagemessage.h"
+#include "imagepreviewmessage.h"
+#include "avatarcache.h"
+#include "avatarmessage.h"
 #include "privatemessage.h"
+#include "filetransfermessage.h"
 
 #include <QDebug>
 #include <QFile>
@@ -30,8 +34,15 @@ QSharedPointer<Message> MessageFactory::create(const QString &sender, const QByt
             dataList[2] = data.mid(index2 + 1, index3 - index2 - 1);
             dataList[3] = data.right(data.length() - index3 - 1);
 
+            // the avatar's hash, or the avatar itself from peers that predate the avatar cache
+            if (dataList[3].startsWith(IdentityMessage::AvatarHashPrefix)) {
+                QByteArray hash = dataList[3].mid(IdentityMessage::AvatarHashPrefix.size());
+                return QSharedPointer<Message>(
+                        new IdentityMessage(sender, dataList[0], dataList[1], dataList[2],
+                                            AvatarCache::isHash(hash) ? hash : QByteArray()));
+            }
             return QSharedPointer<Message>(
-                    new IdentityMessage(sender, dataList[0], dataList[1], dataList[2], QImage::fromData(dataList[3])));
+                    new IdentityMessage(sender, dataList[0], dataList[1], dataList[2], EncodedImage::fromData(dataList[3])));
         }
         case Message::ActionMessage: {
             auto dataList = data.split(Message::Separator);
@@ -75,10 +86,50 @@ QSharedPointer<Message> MessageFactory::create(const QString &sender, const QByt
                 // private message
                 return QSharedPointer<Message>(
                         new ImageMessage(sender, name.left(index), name.right(name.length() - index - 1),
-                                         QImage::fromData(imageData)));
+                                         EncodedImage::fromData(imageData)));
             } else {
-                return QSharedPointer<Message>(new ImageMessage(sender, name, QImage::fromData(imageData)));
+                return QSharedPointer<Message>(new ImageMessage(sender, name, EncodedImage::fromData(imageData)));
+            }
+        }
+        case Message::ImagePreviewMessage: {
+            // [chatroom/]name|WIDTHxHEIGHT|thumbnail - the thumbnail is last and may contain separators
+            int index1 = data.indexOf(Message::Separator);
+            int index2 = data.indexOf(Message::Separator, index1 + 1);
+            if (index1 == -1 || index2 == -1) {
+                return nullptr;
+            }
+
+            QString name = data.left(index1);
+            QList<QByteArray> size = data.mid(index1 + 1, index2 - index1 - 1).split('x');
+            QSize imageSize = size.length() == 2 ? QSize(size[0].toInt(), size[1].toInt()) : QSize();
+            EncodedImage thumbnail = EncodedImage::fromData(data.mid(index2 + 1));
+
+            // process private message
+            const int index = name.indexOf('/');
+            return QSharedPointer<Message>(
+                    new ImagePreviewMessage(sender, index != -1 ? name.left(index) : QString(),
+                                            name.right(name.length() - index - 1), imageSize, thumbnail));
+        }
+        case Message::AvatarMessage: {
+            // REQUEST|hash or AVATAR|hash|image - the image is last and may contain separators
+            int index1 = data.indexOf(Message::Separator);
+            int index2 = data.indexOf(Message::Separator, index1 + 1);
+            if (index1 == -1) {
+                return nullptr;
+            }
+
+            QByteArray kind = data.left(index1);
+            if (kind == "REQUEST") {
+                return QSharedPointer<Message>(new AvatarMessage(sender, data.mid(index1 + 1)));
+            } else if (kind == "AVATAR" && index2 != -1) {
+                EncodedImage avatar = EncodedImage::fromData(data.mid(index2 + 1));
+                // an avatar that does not match its hash is dropped
+                if (avatar.isNull() || avatar.hash() != data.mid(index1 + 1, index2 - index1 - 1)) {
+                    return nullptr;
+                }
+                return QSharedPointer<Message>(new AvatarMessage(sender, avatar));
             }
+            return nullptr;
         }
         case Message::PrivateMessage: {
             int separatorPosition = data.indexOf(Message::Separator);
@@ -87,6 +138,34 @@ QSharedPointer<Message> MessageFactory::create(const QString &sender, const QByt
 
             return QSharedPointer<Message>(new PrivateMessage(sender, receiver, QString::fromUtf8(message)));
         }
+        case Message::FileTransferMessage: {
+            // STAGE|id|position|content - the content is last and may contain separators
+            int index1 = data.indexOf(Message::Separator);
+            int index2 = data.indexOf(Message::Separator, index1 + 1);
+            int index3 = data.indexOf(Message::Separator, index2 + 1);
+            if (index1 == -1 || index2 == -1 || index3 == -1) {
+                return nullptr;
+            }
+
+            QByteArray stageName = data.left(index1);
+            FileTransferMessage::Stage stage;
+            if (stageName == "OFFER") {
+                stage = FileTransferMessage::OFFER;
+            } else if (stageName == "CHUNK") {
+                stage = FileTransferMessage::CHUNK;
+            } else if (stageName == "DONE") {
+                stage = FileTransferMessage::DONE;
+            } else if (stageName == "CANCEL") {
+                stage = FileTransferMessage::CANCEL;
+            } else {
+                return nullptr;
+            }
+            quint32 transferId = data.mid(index1 + 1, index2 - index1 - 1).toUInt();
+            qint64 position = data.mid(index2 + 1, index3 - index2 - 1).toLongLong();
+
+            return QSharedPointer<Message>(
+                    new FileTransferMessage(sender, stage, transferId, position, data.mid(index3 + 1)));
+        }
         default:
             return nullptr;
     }
@@ -0,0 +1,130 @@
+#include "httpconnection.h"
+
+#include <QTcpSocket>
+
+namespace p2prendezvous {
+
+static QByteArray reasonPhrase(int status) {
+  switch (status) {
+  case 200:
+    return "OK";
+  case 304:
+    return "Not Modified";
+  case 400:
+    return "Bad Request";
+  case 404:
+    return "Not Found";
+  case 405:
+    return "Method Not Allowed";
+  case 413:
+    return "Payload Too Large";
+  case 503:
+    return "Service Unavailable";
+  default:
+    return "Unknown";
+  }
+}
+
+HttpConnection::HttpConnection(QTcpSocket *socket, QObject *parent)
+    : QObject(parent), socket(socket), bodySize(-1), waiting(false), keepAlive(true) {
+  socket->setParent(this);
+  connect(socket, &QTcpSocket::readyRead, this, &HttpConnection::readRequest);
+  connect(socket, &QTcpSocket::disconnected, this, &HttpConnection::deleteLater);
+  // not restarted by partial data, so a request sent a byte at a time cannot hold the connection
+  idleTimer.setSingleShot(true);
+  connect(&idleTimer, &QTimer::timeout, socket, &QTcpSocket::abort);
+  idleTimer.start(IdleTimeout);
+}
+
+bool HttpConnection::isWaiting() const {
+  return waiting;
+}
+
+void HttpConnection::readRequest() {
+  if (waiting)
+    return; // read once the current request is answered
+  buffer += socket->readAll();
+
+  if (bodySize < 0) {
+    const int end = buffer.indexOf("\r\n\r\n");
+    if (end < 0) {
+      if (buffer.size() > MaxHeadSize)
+        fail(413);
+      return;
+    }
+    if (end > MaxHeadSize || !parseHead(buffer.left(end))) {
+      fail(end > MaxHeadSize ? 413 : 400);
+      return;
+    }
+    buffer.remove(0, end + 4);
+    bool ok = true;
+    const QByteArray length = current.headers.value("content-length");
+    bodySize = length.isEmpty() ? 0 : length.toInt(&ok);
+    if (!ok || bodySize < 0 || bodySize > MaxBodySize) {
+      fail(!ok || bodySize < 0 ? 400 : 413);
+      return;
+    }
+  }
+  if (buffer.size() < bodySize)
+    return;
+
+  current.body = buffer.left(bodySize);
+  buffer.remove(0, bodySize);
+  bodySize = -1;
+  waiting = true;
+  idleTimer.stop(); // the server decides how long to hold it
+  emit request(this, current);
+}
+
+bool HttpConnection::parseHead(const QByteArray &head) {
+  const QList<QByteArray> lines = head.split('\n');
+  const QList<QByteArray> requestLine = lines.first().trimmed().split(' ');
+  if (requestLine.size() != 3 || !requestLine.at(2).startsWith("HTTP/1."))
+    return false;
+
+  current = HttpRequest();
+  current.method = requestLine.at(0);
+  current.url = QUrl::fromEncoded(requestLine.at(1));
+  for (int i = 1; i < lines.size(); ++i) {
+    const int colon = lines.at(i).indexOf(':');
+    if (colon <= 0)
+      return false;
+    current.headers.insert(lines.at(i).left(colon).trimmed().toLower(),
+                           lines.at(i).mid(colon + 1).trimmed());
+  }
+  // HTTP/1.1 keeps the connection open unless told otherwise, 1.0 closes it unless told otherwise
+  const QByteArray connection = current.headers.value("connection").toLower();
+  keepAlive = requestLine.at(2) == "HTTP/1.1" ? connection != "close" : connection == "keep-alive";
+  return current.url.isValid();
+}
+
+void HttpConnection::respond(int status, const QByteArray &body,
+                             const QList<QPair<QByteArray, QByteArray>> &headers) {
+  if (!waiting)
+    return;
+  waiting = false;
+
+  QByteArray response = "HTTP/1.1 " + QByteArray::number(status) + ' ' + reasonPhrase(status)
+                        + "\r\nContent-Length: " + QByteArray::number(body.size())
+                        + (keepAlive ? "\r\nConnection: keep-alive" : "\r\nConnection: close");
+  for (const auto &header : headers)
+    response += "\r\n" + header.first + ": " + header.second;
+  response += "\r\n\r\n";
+  response += body;
+  socket->write(response);
+
+  // also bounds how long a closing connection waits for the peer to take the response
+  idleTimer.start(IdleTimeout);
+  if (!keepAlive)
+    socket->disconnectFromHost();
+  else if (!buffer.isEmpty() || socket->bytesAvailable() > 0)
+    readRequest(); // a pipelined request
+}
+
+void HttpConnection::fail(int status) {
+  waiting = true;
+  keepAlive = false;
+  respond(status);
+}
+
+} // namespace p2prendezvous
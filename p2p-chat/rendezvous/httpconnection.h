@@ -0,0 +1,84 @@
+#ifndef HTTPCONNECTION_H
+#define HTTPCONNECTION_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QPair>
+#include <QTimer>
+#include <QUrl>
+
+class QTcpSocket;
+
+namespace p2prendezvous {
+
+/**
+ * @brief The HttpRequest struct one parsed request. Header names are lower case.
+ */
+struct HttpRequest {
+  QByteArray method;
+  QUrl url;
+  QHash<QByteArray, QByteArray> headers;
+  QByteArray body;
+};
+
+/**
+ * @brief The HttpConnection class just enough HTTP/1.1 for the rendezvous API: requests with a
+ * Content-Length body, keep-alive, one request at a time. The next request is not read until the
+ * current one is answered, which is what lets a long-polled request wait without any buffering.
+ */
+class HttpConnection : public QObject {
+  Q_OBJECT
+
+public:
+  /** requests with a longer head or body are refused and the connection closed */
+  static const int MaxHeadSize = 16 * 1024;
+  static const int MaxBodySize = 64 * 1024;
+  /** a connection that has not sent a whole request this long after connecting or after its last
+   * answer is closed, in milliseconds; a request being held is not affected */
+  static const int IdleTimeout = 30000;
+
+  /**
+   * @brief HttpConnection constructor, takes ownership of the socket.
+   * @param socket a connected socket.
+   * @param parent the owner.
+   */
+  HttpConnection(QTcpSocket *socket, QObject *parent = nullptr);
+
+  /**
+   * @brief respond answer the current request.
+   * @param status the HTTP status code.
+   * @param body the response body, may be empty.
+   * @param headers extra headers, Content-Length and Connection are added.
+   */
+  void respond(int status, const QByteArray &body = QByteArray(),
+               const QList<QPair<QByteArray, QByteArray>> &headers = {});
+
+  /**
+   * @brief isWaiting test if a request was received and not answered yet.
+   */
+  bool isWaiting() const;
+
+signals:
+  void request(p2prendezvous::HttpConnection *connection, const p2prendezvous::HttpRequest &request);
+
+private slots:
+  void readRequest();
+
+private:
+  bool parseHead(const QByteArray &head);
+  void fail(int status);
+
+  QTcpSocket *socket;
+  QTimer idleTimer;
+  QByteArray buffer;
+  HttpRequest current;
+  int bodySize;   /**< the Content-Length of the current request, -1 while reading the head */
+  bool waiting;   /**< a request was handed out and not answered */
+  bool keepAlive; /**< the current request allows another one on the same connection */
+};
+
+} // namespace p2prendezvous
+
+#endif
@@ -0,0 +1,273 @@
+#include "loadgenerator.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QTcpSocket>
+#include <QTextStream>
+
+namespace p2prendezvous {
+
+/** nodes connected per connectTimer tick, so the server's backlog is not overrun */
+static const int ConnectBatch = 200;
+static const int ConnectTick = 100;
+/** like the chat's rendezvous client */
+static const int PollWait = 25;
+static const qint64 RefreshInterval = 30000;
+static const int ReconnectDelay = 1000;
+/** a change not received by then is forgotten, in milliseconds */
+static const qint64 ChangeMemory = 60000;
+
+/**
+ * @brief The LoadClient class one keep-alive connection to the server. A node posts its
+ * announcement, then long-polls, refreshing the announcement between polls when it is due. The
+ * poster only posts what it is given.
+ */
+class LoadClient {
+public:
+  LoadClient(LoadGenerator *generator, int node) : generator(generator), node(node),
+      socket(new QTcpSocket(generator)), refreshedAt(-RefreshInterval), busy(false) {
+    QObject::connect(socket, &QTcpSocket::connected, generator, [this]() { next(); });
+    QObject::connect(socket, &QTcpSocket::readyRead, generator, [this]() { readResponse(); });
+    // refused, reset or closed by the server alike
+    QObject::connect(socket, &QTcpSocket::stateChanged, generator,
+                     [this](QAbstractSocket::SocketState state) {
+                       if (state == QAbstractSocket::UnconnectedState)
+                         failed();
+                     });
+  }
+
+  ~LoadClient() {
+    QObject::disconnect(socket, nullptr, generator, nullptr);
+    delete socket;
+  }
+
+  void connectToServer() {
+    buffer.clear();
+    busy = false;
+    socket->connectToHost(generator->server, generator->port);
+  }
+
+  bool isConnected() const {
+    return socket->state() == QAbstractSocket::ConnectedState;
+  }
+
+  void post(const QByteArray &announcement) {
+    queue << announcement;
+    if (!busy && isConnected())
+      next();
+  }
+
+private:
+  enum Request { Post, Poll };
+
+  void next() {
+    if (node >= 0 && generator->clock.elapsed() - refreshedAt >= RefreshInterval) {
+      queue.clear();
+      queue << generator->announcement(node);
+    }
+    if (!queue.isEmpty()) {
+      // the sender is the name the announcement starts with, as in the chat
+      const QByteArray message = queue.takeFirst();
+      QJsonObject body;
+      body.insert("sender", QString::fromUtf8(message.left(message.indexOf('|'))));
+      body.insert("messages", QJsonArray() << QString::fromUtf8(message));
+      const QByteArray json = QJsonDocument(body).toJson(QJsonDocument::Compact);
+      send(Post, "POST /post HTTP/1.1\r\nHost: rendezvous\r\nContent-Type: application/json\r\n"
+                 "Content-Length: " + QByteArray::number(json.size()) + "\r\n\r\n" + json);
+    } else if (node >= 0) {
+      send(Poll, "GET /list?since=" + (cursor.isEmpty() ? QByteArray("0") : cursor) + "&wait="
+                     + QByteArray::number(PollWait) + " HTTP/1.1\r\nHost: rendezvous\r\n\r\n");
+    }
+  }
+
+  void send(Request request, const QByteArray &data) {
+    pending = request;
+    busy = true;
+    socket->write(data);
+  }
+
+  void readResponse() {
+    buffer += socket->readAll();
+    while (busy) {
+      const int end = buffer.indexOf("\r\n\r\n");
+      if (end < 0)
+        return;
+      const QList<QByteArray> lines = buffer.left(end).split('\n');
+      const QList<QByteArray> statusLine = lines.first().split(' ');
+      int length = 0;
+      for (const QByteArray &line : lines) {
+        if (line.toLower().startsWith("content-length:"))
+          length = line.mid(15).trimmed().toInt();
+      }
+      if (statusLine.size() < 2 || buffer.size() < end + 4 + length)
+        return;
+      const int status = statusLine.at(1).toInt();
+      const QByteArray body = buffer.mid(end + 4, length);
+      buffer.remove(0, end + 4 + length);
+      busy = false;
+      handle(status, body);
+    }
+  }
+
+  void handle(int status, const QByteArray &body) {
+    if (pending == Post) {
+      if (status != 200)
+        generator->countError();
+      ++generator->period.posts;
+      if (node >= 0)
+        refreshedAt = generator->clock.elapsed();
+    } else if (status == 304) {
+      ++generator->period.unchanged;
+    } else if (status == 200) {
+      ++generator->period.changes;
+      const QJsonObject answer = QJsonDocument::fromJson(body).object();
+      cursor = answer.value("cursor").toString().toLatin1();
+      foreach (const QJsonValue &value, answer.value("messages").toArray())
+        generator->received(value.toObject().value("message").toString().toUtf8());
+    } else {
+      generator->countError();
+    }
+    next();
+  }
+
+  void failed() {
+    generator->countError();
+    QTimer::singleShot(ReconnectDelay, generator, [this]() { connectToServer(); });
+  }
+
+  LoadGenerator *generator;
+  const int node; /**< the simulated node, -1 for the poster */
+  QTcpSocket *socket;
+  QByteArray buffer;
+  QByteArray cursor;
+  QList<QByteArray> queue; /**< announcements to post */
+  qint64 refreshedAt;      /**< when the node's announcement was last posted, on the clock */
+  Request pending;
+  bool busy;               /**< a request was sent and its response is not complete */
+};
+
+LoadGenerator::LoadGenerator(const QHostAddress &server, quint16 port, int nodes,
+                             int changesPerSecond, QObject *parent)
+    : QObject(parent), server(server), port(port), nodeCount(nodes),
+      changesPerSecond(changesPerSecond), poster(nullptr), changeBudget(0) {
+  for (int i = 0; i < nodes; ++i)
+    ports << quint16(20000 + QRandomGenerator::global()->bounded(40000));
+  connectTimer.setInterval(ConnectTick);
+  changeTimer.setInterval(100);
+  reportTimer.setInterval(1000);
+  stopTimer.setSingleShot(true);
+  connect(&connectTimer, &QTimer::timeout, this, &LoadGenerator::connectMore);
+  connect(&changeTimer, &QTimer::timeout, this, &LoadGenerator::change);
+  connect(&reportTimer, &QTimer::timeout, this, &LoadGenerator::report);
+  connect(&stopTimer, &QTimer::timeout, this, &LoadGenerator::stop);
+}
+
+LoadGenerator::~LoadGenerator() {
+  qDeleteAll(nodes);
+  delete poster;
+}
+
+void LoadGenerator::start(int seconds) {
+  clock.start();
+  poster = new LoadClient(this, -1);
+  poster->connectToServer();
+  connectTimer.start();
+  changeTimer.start();
+  reportTimer.start();
+  if (seconds > 0)
+    stopTimer.start(seconds * 1000);
+}
+
+void LoadGenerator::connectMore() {
+  for (int i = 0; i < ConnectBatch && nodes.size() < nodeCount; ++i) {
+    LoadClient *client = new LoadClient(this, nodes.size());
+    nodes << client;
+    client->connectToServer();
+  }
+  if (nodes.size() == nodeCount)
+    connectTimer.stop();
+}
+
+QByteArray LoadGenerator::announcement(int node) const {
+  // name|port|ip, each node with an address of its own in 10.0.0.0/8
+  return "load" + QByteArray::number(node) + '|' + QByteArray::number(ports.at(node)) + "|10."
+         + QByteArray::number((node >> 16) & 0xff) + '.' + QByteArray::number((node >> 8) & 0xff)
+         + '.' + QByteArray::number(node & 0xff);
+}
+
+void LoadGenerator::change() {
+  if (nodes.isEmpty() || !poster->isConnected())
+    return;
+  changeBudget += changesPerSecond / 10.0;
+  for (; changeBudget >= 1; changeBudget -= 1) {
+    const int node = QRandomGenerator::global()->bounded(nodes.size());
+    ports[node] = quint16(20000 + QRandomGenerator::global()->bounded(40000));
+    const QByteArray message = announcement(node);
+    postedAt.insert(message, clock.elapsed());
+    poster->post(message);
+  }
+}
+
+void LoadGenerator::received(const QByteArray &message) {
+  auto it = postedAt.constFind(message);
+  if (it == postedAt.constEnd())
+    return;
+  const qint64 latency = clock.elapsed() - it.value();
+  ++period.delivered;
+  period.latencySum += latency;
+  period.latencyMax = qMax(period.latencyMax, latency);
+}
+
+void LoadGenerator::countError() {
+  ++period.errors;
+}
+
+void LoadGenerator::report() {
+  int connected = 0;
+  foreach (LoadClient *client, nodes)
+    connected += client->isConnected() ? 1 : 0;
+
+  QTextStream(stdout) << QString("%1 s: %2/%3 nodes connected, %4 posts, %5 polls with news, "
+                                 "%6 polls unchanged, %7 changes delivered (mean %8 ms, max %9 ms), "
+                                 "%10 errors\n")
+                             .arg(clock.elapsed() / 1000).arg(connected).arg(nodeCount)
+                             .arg(period.posts).arg(period.changes).arg(period.unchanged)
+                             .arg(period.delivered)
+                             .arg(period.delivered ? period.latencySum / qint64(period.delivered) : 0)
+                             .arg(period.latencyMax).arg(period.errors);
+
+  total.posts += period.posts;
+  total.changes += period.changes;
+  total.unchanged += period.unchanged;
+  total.delivered += period.delivered;
+  total.latencySum += period.latencySum;
+  total.latencyMax = qMax(total.latencyMax, period.latencyMax);
+  total.errors += period.errors;
+  period = Counters();
+
+  const qint64 forgotten = clock.elapsed() - ChangeMemory;
+  for (auto it = postedAt.begin(); it != postedAt.end();) {
+    if (it.value() < forgotten)
+      it = postedAt.erase(it);
+    else
+      ++it;
+  }
+}
+
+void LoadGenerator::stop() {
+  report();
+  connectTimer.stop();
+  changeTimer.stop();
+  reportTimer.stop();
+  QTextStream(stdout) << QString("total: %1 posts, %2 polls with news, %3 polls unchanged, "
+                                 "%4 changes delivered (mean %5 ms, max %6 ms), %7 errors\n")
+                             .arg(total.posts).arg(total.changes).arg(total.unchanged)
+                             .arg(total.delivered)
+                             .arg(total.delivered ? total.latencySum / qint64(total.delivered) : 0)
+                             .arg(total.latencyMax).arg(total.errors);
+  emit finished();
+}
+
+} // namespace p2prendezvous
@@ -0,0 +1,95 @@
+#ifndef LOADGENERATOR_H
+#define LOADGENERATOR_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QHostAddress>
+#include <QList>
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+
+class QTcpSocket;
+
+namespace p2prendezvous {
+
+class LoadClient;
+
+/**
+ * @brief The LoadGenerator class puts a rendezvous server under the load of a large chat: many
+ * simulated nodes that each post their announcement, long-poll the list and refresh the
+ * announcement before it expires, while a steady stream of nodes changes port as if restarting.
+ * It reports every second how many requests were answered and how long a change took to reach
+ * the nodes. Each node holds one connection, so the open file limit of both processes must allow
+ * for it.
+ */
+class LoadGenerator : public QObject {
+  Q_OBJECT
+
+public:
+  /**
+   * @brief LoadGenerator constructor
+   * @param server the server address.
+   * @param port the server port.
+   * @param nodes the number of simulated nodes.
+   * @param changesPerSecond how many nodes change their announcement each second.
+   * @param parent the owner.
+   */
+  LoadGenerator(const QHostAddress &server, quint16 port, int nodes, int changesPerSecond,
+                QObject *parent = nullptr);
+  ~LoadGenerator() override;
+
+  /**
+   * @brief start connect the nodes, a few hundred at a time, and run until stopped.
+   * @param seconds how long to run, forever if 0.
+   */
+  void start(int seconds);
+
+signals:
+  void finished();
+
+private slots:
+  void connectMore();
+  void change();
+  void report();
+  void stop();
+
+private:
+  friend class LoadClient;
+
+  /** the statistics of one reporting period or of the whole run */
+  struct Counters {
+    quint64 posts = 0;
+    quint64 changes = 0;    /**< polls answered with news */
+    quint64 unchanged = 0;  /**< polls answered 304 */
+    quint64 delivered = 0;  /**< announcements received that a change was timed for */
+    qint64 latencySum = 0;  /**< from posting a change to receiving it, in milliseconds */
+    qint64 latencyMax = 0;
+    quint64 errors = 0;
+  };
+
+  QByteArray announcement(int node) const;
+  void received(const QByteArray &message);
+  void countError();
+
+  QHostAddress server;
+  quint16 port;
+  int nodeCount;
+  int changesPerSecond;
+  QList<LoadClient *> nodes;
+  LoadClient *poster;       /**< posts the changes, so they do not wait for a node's poll */
+  QVector<quint16> ports;   /**< the port each node announces, bumped by a change */
+  QHash<QByteArray, qint64> postedAt; /**< when each changed announcement was posted */
+  QElapsedTimer clock;
+  QTimer connectTimer;
+  QTimer changeTimer;
+  QTimer reportTimer;
+  QTimer stopTimer;
+  double changeBudget; /**< changes due but not made yet */
+  Counters period;
+  Counters total;
+};
+
+} // namespace p2prendezvous
+
+#endif
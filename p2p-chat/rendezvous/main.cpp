@@ -0,0 +1,63 @@
+#include "loadgenerator.h"
+#include "rendezvousserver.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QHostAddress>
+
+int main(int argc, char *argv[]) {
+  QCoreApplication a(argc, argv);
+  QCoreApplication::setApplicationName("p2pchat-rendezvous");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+      "The central rendezvous server of the chat, or with --load a load test of one.");
+  parser.addHelpOption();
+  QCommandLineOption portOption(QStringList() << "p" << "port",
+                                "The port to listen on, or to load.", "port", "8080");
+  QCommandLineOption addressOption(QStringList() << "a" << "address",
+                                   "The address to listen on, or to load.", "address",
+                                   "127.0.0.1");
+  QCommandLineOption ttlOption("ttl", "Drop announcements not refreshed within <seconds>.",
+                               "seconds",
+                               QString::number(p2prendezvous::RendezvousServer::DefaultTtl));
+  QCommandLineOption loadOption("load",
+                                "Instead of serving, load a running server with <nodes> simulated "
+                                "nodes, each holding a connection.",
+                                "nodes");
+  QCommandLineOption changesOption(
+      "changes", "With --load, how many nodes change their announcement each second.", "count",
+      "10");
+  QCommandLineOption durationOption("duration", "With --load, stop after <seconds>.", "seconds",
+                                    "60");
+  parser.addOption(portOption);
+  parser.addOption(addressOption);
+  parser.addOption(ttlOption);
+  parser.addOption(loadOption);
+  parser.addOption(changesOption);
+  parser.addOption(durationOption);
+  parser.process(a);
+
+  const QHostAddress address(parser.value(addressOption));
+  const quint16 port = quint16(parser.value(portOption).toUInt());
+
+  if (parser.isSet(loadOption)) {
+    p2prendezvous::LoadGenerator generator(address, port,
+                                           qMax(1, parser.value(loadOption).toInt()),
+                                           qMax(0, parser.value(changesOption).toInt()));
+    QObject::connect(&generator, &p2prendezvous::LoadGenerator::finished, &a,
+                     &QCoreApplication::quit);
+    generator.start(qMax(0, parser.value(durationOption).toInt()));
+    return a.exec();
+  }
+
+  p2prendezvous::RendezvousServer server(qMax(1, parser.value(ttlOption).toInt()));
+  if (!server.listen(address, port)) {
+    qCritical().noquote() << "cannot listen:" << server.errorString();
+    return 1;
+  }
+  qInfo().noquote() << QString("listening on http://%1:%2")
+                           .arg(server.serverAddress().toString())
+                           .arg(server.serverPort());
+  return a.exec();
+}
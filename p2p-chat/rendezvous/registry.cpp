@@ -0,0 +1,66 @@
+#include "registry.h"
+
+namespace p2prendezvous {
+
+Registry::Registry(qint64 ttl) : ttl(ttl), lastCursor(0) {
+}
+
+bool Registry::announce(const QString &sender, const QString &message, qint64 now) {
+  auto it = entries.find(message);
+  if (it != entries.end()) {
+    it->expires = now + ttl;
+    if (it->sender == sender)
+      return false;
+    byCursor.remove(it->cursor);
+    it->sender = sender;
+    it->cursor = ++lastCursor;
+    byCursor.insert(it->cursor, message);
+    return true;
+  }
+
+  Entry entry{sender, message, ++lastCursor, now + ttl};
+  entries.insert(message, entry);
+  byCursor.insert(entry.cursor, message);
+  byExpiry.insert(entry.expires, message);
+  return true;
+}
+
+int Registry::expire(qint64 now) {
+  int expired = 0;
+  while (!byExpiry.isEmpty() && byExpiry.firstKey() <= now) {
+    const QString message = byExpiry.first();
+    byExpiry.erase(byExpiry.begin());
+    auto it = entries.find(message);
+    if (it == entries.end())
+      continue;
+    if (it->expires > now) { // refreshed since it was filed
+      byExpiry.insert(it->expires, message);
+      continue;
+    }
+    byCursor.remove(it->cursor);
+    entries.erase(it);
+    ++expired;
+  }
+  return expired;
+}
+
+QVector<const Registry::Entry *> Registry::changedSince(quint64 cursor) const {
+  QVector<const Entry *> changed;
+  for (auto it = byCursor.upperBound(cursor); it != byCursor.end(); ++it)
+    changed << &entries.find(it.value()).value();
+  return changed;
+}
+
+quint64 Registry::cursor() const {
+  return lastCursor;
+}
+
+bool Registry::contains(const QString &message) const {
+  return entries.contains(message);
+}
+
+int Registry::size() const {
+  return entries.size();
+}
+
+} // namespace p2prendezvous
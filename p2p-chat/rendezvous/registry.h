@@ -0,0 +1,68 @@
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include <QHash>
+#include <QMap>
+#include <QString>
+#include <QVector>
+
+namespace p2prendezvous {
+
+/**
+ * @brief The Registry class the live announcements, hashed by their text. Each change, a new
+ * announcement or one whose sender changed, takes the next cursor, so the changes after any cursor
+ * are a range of an ordered index. Refreshing an announcement only extends its lifetime: the
+ * periodic refreshes of thousands of nodes cost a hash lookup each and wake nobody up.
+ */
+class Registry {
+public:
+  struct Entry {
+    QString sender;
+    QString message;
+    quint64 cursor; /**< when it last changed */
+    qint64 expires; /**< msecs since the epoch */
+  };
+
+  /**
+   * @brief Registry constructor
+   * @param ttl how long an announcement lives without a refresh, in milliseconds.
+   */
+  explicit Registry(qint64 ttl);
+
+  /**
+   * @brief announce add or refresh an announcement.
+   * @param now the current time in msecs since the epoch.
+   * @return true if it is new or changed, false if it was only refreshed.
+   */
+  bool announce(const QString &sender, const QString &message, qint64 now);
+  /**
+   * @brief expire drop the announcements that were not refreshed in time.
+   * @param now the current time in msecs since the epoch.
+   * @return the number dropped.
+   */
+  int expire(qint64 now);
+
+  /**
+   * @brief changedSince the live announcements that changed after a cursor, oldest change first.
+   * The pointers are valid until the registry is next changed.
+   */
+  QVector<const Entry *> changedSince(quint64 cursor) const;
+  /**
+   * @brief cursor the cursor of the latest change, 0 before the first.
+   */
+  quint64 cursor() const;
+  bool contains(const QString &message) const;
+  int size() const;
+
+private:
+  qint64 ttl;
+  quint64 lastCursor;
+  QHash<QString, Entry> entries;       /**< by message */
+  QMap<quint64, QString> byCursor;     /**< the message of each live cursor */
+  /** one item per entry, at or before its expiry: a refresh does not move it, the sweep does */
+  QMultiMap<qint64, QString> byExpiry;
+};
+
+} // namespace p2prendezvous
+
+#endif
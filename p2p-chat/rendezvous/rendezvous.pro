@@ -0,0 +1,34 @@
+#-------------------------------------------------
+#
+# A self-hostable central rendezvous server, and with --load a load test of one. Needs only QtCore
+# and QtNetwork.
+#
+#-------------------------------------------------
+
+QT       += core network
+QT       -= gui
+
+CONFIG += console
+CONFIG -= app_bundle
+
+TARGET = p2pchat-rendezvous
+TEMPLATE = app
+
+# The following define makes your compiler emit warnings if you use
+# any feature of Qt which has been marked as deprecated (the exact warnings
+# depend on your compiler). Please consult the documentation of the
+# deprecated API in order to know how to port your code away from it.
+DEFINES += QT_DEPRECATED_WARNINGS
+
+SOURCES += \
+    main.cpp \
+    httpconnection.cpp \
+    registry.cpp \
+    rendezvousserver.cpp \
+    loadgenerator.cpp
+
+HEADERS += \
+    httpconnection.h \
+    registry.h \
+    rendezvousserver.h \
+    loadgenerator.h
@@ -0,0 +1,188 @@
+#include "rendezvousserver.h"
+
+#include <QDateTime>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTcpSocket>
+#include <QUrlQuery>
+
+namespace p2prendezvous {
+
+static const QByteArray JsonType = "application/json";
+
+static QByteArray etag(quint64 cursor) {
+  return '"' + QByteArray::number(cursor) + '"';
+}
+
+RendezvousServer::RendezvousServer(int ttl, QObject *parent)
+    : QTcpServer(parent), registry(qint64(ttl) * 1000), fullListCursor(0), fullListSize(0) {
+  // the default backlog of 30 is too short for thousands of clients reconnecting at once
+  setMaxPendingConnections(1024);
+  sweepTimer.setInterval(1000);
+  connect(&sweepTimer, &QTimer::timeout, this, &RendezvousServer::sweep);
+  sweepTimer.start();
+  notifyTimer.setSingleShot(true);
+  notifyTimer.setInterval(NotifyDelay);
+  connect(&notifyTimer, &QTimer::timeout, this, &RendezvousServer::notifyWaiting);
+}
+
+void RendezvousServer::incomingConnection(qintptr socketDescriptor) {
+  QTcpSocket *socket = new QTcpSocket;
+  if (!socket->setSocketDescriptor(socketDescriptor)) {
+    delete socket;
+    return;
+  }
+  HttpConnection *connection = new HttpConnection(socket, this);
+  connect(connection, &HttpConnection::request, this, &RendezvousServer::handleRequest);
+}
+
+void RendezvousServer::handleRequest(HttpConnection *connection, const HttpRequest &request) {
+  const QString path = request.url.path();
+  if (path.endsWith(QLatin1String("/list")))
+    list(connection, request);
+  else if (path.endsWith(QLatin1String("/post")))
+    post(connection, request);
+  else
+    connection->respond(404);
+}
+
+void RendezvousServer::list(HttpConnection *connection, const HttpRequest &request) {
+  if (request.method != "GET") {
+    connection->respond(405);
+    return;
+  }
+  const QUrlQuery query(request.url);
+  if (!query.hasQueryItem(QStringLiteral("since"))) {
+    // clients of the original API ask for everything several times a second
+    if (fullList.isNull() || fullListCursor != registry.cursor()
+        || fullListSize != registry.size()) {
+      QJsonArray all;
+      foreach (const Registry::Entry *entry, registry.changedSince(0)) {
+        QJsonObject object;
+        object.insert("sender", entry->sender);
+        object.insert("message", entry->message);
+        all.append(object);
+      }
+      fullList = QJsonDocument(all).toJson(QJsonDocument::Compact);
+      fullListCursor = registry.cursor();
+      fullListSize = registry.size();
+    }
+    connection->respond(200, fullList, {qMakePair(QByteArray("Content-Type"), JsonType)});
+    return;
+  }
+
+  quint64 since = query.queryItemValue(QStringLiteral("since")).toULongLong();
+  // a cursor from before a restart of this server
+  if (since > registry.cursor())
+    since = 0;
+  const int wait = qBound(0, query.queryItemValue(QStringLiteral("wait")).toInt(), MaxWait);
+  if (since < registry.cursor()) {
+    connection->respond(200, answerSince(since),
+                        {qMakePair(QByteArray("Content-Type"), JsonType),
+                         qMakePair(QByteArray("ETag"), etag(registry.cursor()))});
+  } else if (wait > 0) {
+    waiting.insert(QDateTime::currentMSecsSinceEpoch() + wait * 1000, Waiting{connection, since});
+  } else {
+    respondNotModified(connection);
+  }
+}
+
+void RendezvousServer::post(HttpConnection *connection, const HttpRequest &request) {
+  const qint64 now = QDateTime::currentMSecsSinceEpoch();
+  bool changed = false;
+  bool accepted = true;
+  if (request.method == "GET") {
+    const QUrlQuery query(request.url);
+    accepted = announce(query.queryItemValue(QStringLiteral("sender"), QUrl::FullyDecoded),
+                        query.queryItemValue(QStringLiteral("message"), QUrl::FullyDecoded), now,
+                        &changed);
+  } else if (request.method == "POST") {
+    const QJsonObject body = QJsonDocument::fromJson(request.body).object();
+    const QJsonArray messages = body.value("messages").toArray();
+    if (messages.isEmpty() || messages.size() > MaxMessagesPerPost) {
+      connection->respond(400);
+      return;
+    }
+    const QString sender = body.value("sender").toString();
+    foreach (const QJsonValue &message, messages)
+      accepted = announce(sender, message.toString(), now, &changed) && accepted;
+  } else {
+    connection->respond(405);
+    return;
+  }
+
+  if (!accepted)
+    connection->respond(registry.size() >= MaxAnnouncements ? 503 : 400);
+  else
+    connection->respond(200);
+  if (changed && !notifyTimer.isActive())
+    notifyTimer.start();
+}
+
+bool RendezvousServer::announce(const QString &sender, const QString &message, qint64 now,
+                                bool *changed) {
+  if (message.isEmpty() || message.size() > MaxMessageSize || sender.size() > MaxMessageSize)
+    return false;
+  // when full, only what is already known may be refreshed
+  if (registry.size() >= MaxAnnouncements && !registry.contains(message))
+    return false;
+  if (registry.announce(sender, message, now))
+    *changed = true;
+  return true;
+}
+
+QByteArray RendezvousServer::answerSince(quint64 since) const {
+  QJsonArray messages;
+  foreach (const Registry::Entry *entry, registry.changedSince(since)) {
+    QJsonObject object;
+    object.insert("sender", entry->sender);
+    object.insert("message", entry->message);
+    messages.append(object);
+  }
+  QJsonObject answer;
+  answer.insert("cursor", QString::number(registry.cursor()));
+  answer.insert("messages", messages);
+  return QJsonDocument(answer).toJson(QJsonDocument::Compact);
+}
+
+void RendezvousServer::respondNotModified(HttpConnection *connection) {
+  connection->respond(304, QByteArray(), {qMakePair(QByteArray("ETag"), etag(registry.cursor()))});
+}
+
+void RendezvousServer::notifyWaiting() {
+  // most waiting clients are up to date and share the same cursor, so most share one answer
+  QHash<quint64, QByteArray> answers;
+  const QList<QPair<QByteArray, QByteArray>> headers = {
+      qMakePair(QByteArray("Content-Type"), JsonType),
+      qMakePair(QByteArray("ETag"), etag(registry.cursor()))};
+  // answering may start a pipelined request on the same connection, which may wait again
+  QMultiMap<qint64, Waiting> pending;
+  pending.swap(waiting);
+  for (auto it = pending.cbegin(); it != pending.cend(); ++it) {
+    if (!it->connection)
+      continue;
+    if (it->since >= registry.cursor()) {
+      waiting.insert(it.key(), it.value());
+      continue;
+    }
+    auto answer = answers.find(it->since);
+    if (answer == answers.end())
+      answer = answers.insert(it->since, answerSince(it->since));
+    it->connection->respond(200, answer.value(), headers);
+  }
+}
+
+void RendezvousServer::sweep() {
+  const qint64 now = QDateTime::currentMSecsSinceEpoch();
+  registry.expire(now);
+  while (!waiting.isEmpty() && waiting.firstKey() <= now) {
+    Waiting first = waiting.first();
+    waiting.erase(waiting.begin());
+    if (first.connection)
+      respondNotModified(first.connection);
+  }
+}
+
+} // namespace p2prendezvous
@@ -0,0 +1,96 @@
+#ifndef RENDEZVOUSSERVER_H
+#define RENDEZVOUSSERVER_H
+
+#include "httpconnection.h"
+#include "registry.h"
+#include <QMultiMap>
+#include <QPointer>
+#include <QTcpServer>
+#include <QTimer>
+
+namespace p2prendezvous {
+
+/**
+ * @brief The RendezvousServer class a self-hosted central rendezvous server, with the original
+ * API and the long-poll API of the chat's rendezvous client:
+ *
+ * GET  /list                      every live announcement, as the original API:
+ *                                 [{"sender", "message"}]
+ * GET  /list?since=<c>&wait=<s>   the announcements changed after cursor c, held up to s seconds
+ *                                 until there is one: {"cursor", "messages": [{"sender",
+ *                                 "message"}]}, or 304 if none arrived. The cursor is also the ETag.
+ * GET  /post?sender=&message=     one announcement, as the original API
+ * POST /post                      {"sender", "messages": [...]}, up to MaxMessagesPerPost
+ *
+ * Announcements live in a Registry and expire unless posted again within the TTL. Waiting list
+ * requests are kept by deadline and answered together, at most once per NotifyDelay however many
+ * announcements arrive, and requests with the same cursor share one encoded answer.
+ */
+class RendezvousServer : public QTcpServer {
+  Q_OBJECT
+
+public:
+  /** the longest a list request is held, in seconds */
+  static const int MaxWait = 60;
+  /** the announcement TTL unless another is given, in seconds */
+  static const int DefaultTtl = 120;
+  /** posts are refused with 503 beyond this many live announcements */
+  static const int MaxAnnouncements = 100000;
+  static const int MaxMessagesPerPost = 16;
+  static const int MaxMessageSize = 512;
+  /** waiting requests are answered this long after the first change, in milliseconds */
+  static const int NotifyDelay = 50;
+
+  /**
+   * @brief RendezvousServer constructor
+   * @param ttl the announcement lifetime, in seconds.
+   * @param parent the owner.
+   */
+  explicit RendezvousServer(int ttl = DefaultTtl, QObject *parent = nullptr);
+
+private slots:
+  void handleRequest(p2prendezvous::HttpConnection *connection,
+                     const p2prendezvous::HttpRequest &request);
+  /**
+   * @brief sweep answer the waiting requests whose wait ran out and drop expired announcements.
+   */
+  void sweep();
+  /**
+   * @brief notifyWaiting answer every waiting request, there is news for all of them.
+   */
+  void notifyWaiting();
+
+protected:
+  void incomingConnection(qintptr socketDescriptor) override;
+
+private:
+  struct Waiting {
+    QPointer<HttpConnection> connection;
+    quint64 since;
+  };
+
+  void list(HttpConnection *connection, const HttpRequest &request);
+  void post(HttpConnection *connection, const HttpRequest &request);
+  /**
+   * @brief announce add or refresh one announcement.
+   * @return false if it was refused.
+   */
+  bool announce(const QString &sender, const QString &message, qint64 now, bool *changed);
+  /**
+   * @brief answerSince the body of the answer to a list request for the changes after a cursor.
+   */
+  QByteArray answerSince(quint64 since) const;
+  void respondNotModified(HttpConnection *connection);
+
+  Registry registry;
+  QMultiMap<qint64, Waiting> waiting; /**< by deadline, msecs since the epoch */
+  QTimer sweepTimer;
+  QTimer notifyTimer;
+  QByteArray fullList; /**< the answer for the original API, while the registry is unchanged */
+  quint64 fullListCursor;
+  int fullListSize;
+};
+
+} // namespace p2prendezvous
+
+#endif
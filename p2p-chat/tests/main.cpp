@@ -0,0 +1,35 @@
+#include "tst_filetransfer.h"
+#include "tst_framedecoder.h"
+#include "tst_outboundqueue.h"
+#include "tst_registry.h"
+#include "tst_relay.h"
+#include "tst_timerwheel.h"
+
+#include <QCoreApplication>
+#include <QtTest>
+
+// Runs every test class, or only the one named with -class, the remaining arguments go to each
+// class as usual.
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+
+  QStringList arguments = app.arguments();
+  QString only;
+  const int classOption = arguments.indexOf("-class");
+  if (classOption >= 0 && classOption + 1 < arguments.size()) {
+    only = arguments.at(classOption + 1);
+    arguments.erase(arguments.begin() + classOption, arguments.begin() + classOption + 2);
+  }
+
+  QList<QObject *> tests;
+  tests << new FileTransferTest << new FrameDecoderTest << new OutboundQueueTest
+        << new RegistryTest << new RelayTest << new TimerWheelTest;
+
+  int status = 0;
+  foreach (QObject *test, tests) {
+    if (only.isEmpty() || only == test->metaObject()->className())
+      status |= QTest::qExec(test, arguments);
+  }
+  qDeleteAll(tests);
+  return status;
+}
@@ -0,0 +1,44 @@
+#-------------------------------------------------
+#
+# Unit tests and benchmarks of the core library, one Qt Test class per file, all run by one
+# executable. "make check" runs them, "-class <name>" runs a single class.
+#
+#-------------------------------------------------
+
+QT       += core gui network testlib
+QT       -= widgets
+
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+TARGET = p2pchat-tests
+TEMPLATE = app
+
+# The following define makes your compiler emit warnings if you use
+# any feature of Qt which has been marked as deprecated (the exact warnings
+# depend on your compiler). Please consult the documentation of the
+# deprecated API in order to know how to port your code away from it.
+DEFINES += QT_DEPRECATED_WARNINGS
+
+include(../core/core.pri)
+
+# The rendezvous server's registry needs only QtCore and is built in directly.
+SOURCES += ../rendezvous/registry.cpp
+HEADERS += ../rendezvous/registry.h
+
+SOURCES += \
+    main.cpp \
+    tst_filetransfer.cpp \
+    tst_framedecoder.cpp \
+    tst_outboundqueue.cpp \
+    tst_registry.cpp \
+    tst_relay.cpp \
+    tst_timerwheel.cpp
+
+HEADERS += \
+    tst_filetransfer.h \
+    tst_framedecoder.h \
+    tst_outboundqueue.h \
+    tst_registry.h \
+    tst_relay.h \
+    tst_timerwheel.h
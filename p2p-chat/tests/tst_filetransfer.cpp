@@ -0,0 +1,79 @@
+#include "tst_filetransfer.h"
+
+#include "Networking/connection.h"
+#include "Networking/filetransfer.h"
+#include <QRandomGenerator>
+#include <QTcpServer>
+#include <QTemporaryFile>
+#include <QtTest>
+
+using namespace p2pnetworking;
+
+namespace {
+
+/**
+ * @brief The LoopbackServer class accepts one connection, the receiving end of the transfer.
+ */
+class LoopbackServer : public QTcpServer {
+public:
+  PeerConnection *accepted = nullptr;
+  bool ready = false;
+
+protected:
+  void incomingConnection(qintptr socketDescriptor) override {
+    accepted = new PeerConnection(this);
+    accepted->setGreetingMessage("receiver");
+    QObject::connect(accepted, &PeerConnection::readyForUse, [this]() { ready = true; });
+    accepted->setSocketDescriptor(socketDescriptor);
+  }
+};
+
+} // namespace
+
+void FileTransferTest::initTestCase() {
+  qRegisterMetaType<QSharedPointer<Message>>();
+}
+
+void FileTransferTest::multiChunkFile() {
+  // several 64 KB chunks and a partial one, random so compression does not shrink them
+  QTemporaryFile source;
+  QVERIFY(source.open());
+  QByteArray content(5 * 64 * 1024 + 123, Qt::Uninitialized);
+  for (int i = 0; i < content.size(); ++i)
+    content[i] = char(QRandomGenerator::global()->generate());
+  QCOMPARE(source.write(content), qint64(content.size()));
+  source.close();
+
+  LoopbackServer server;
+  QVERIFY(server.listen(QHostAddress::LocalHost));
+  PeerConnection sender;
+  sender.setGreetingMessage("sender");
+  QSignalSpy senderReady(&sender, &PeerConnection::readyForUse);
+  sender.dial(QHostAddress::LocalHost, server.serverPort());
+  QTRY_VERIFY(server.ready);
+  QTRY_COMPARE(senderReady.count(), 1);
+
+  FileTransferManager outgoing;
+  FileTransferManager incoming;
+  PeerConnection *receiver = server.accepted;
+  connect(receiver, &PeerConnection::newMessage, &incoming,
+          [&incoming, receiver](QSharedPointer<Message> message) {
+            if (auto transfer = qSharedPointerDynamicCast<FileTransferMessage>(message))
+              incoming.handleMessage(receiver, transfer);
+          });
+  QSignalSpy received(&incoming, &FileTransferManager::fileReceived);
+
+  QSharedPointer<FileMessage> file(
+      new FileMessage("sender", QString(), "random.bin", source.fileName(), content.size()));
+  QVERIFY(outgoing.startTransfer(file, "sender", QList<PeerConnection *>() << &sender));
+  QTRY_COMPARE_WITH_TIMEOUT(received.count(), 1, 10000);
+
+  auto message = qSharedPointerDynamicCast<FileMessage>(
+      received.at(0).at(0).value<QSharedPointer<Message>>());
+  QVERIFY(message);
+  QCOMPARE(message->filename(), QString("random.bin"));
+  QCOMPARE(message->size(), qint64(content.size()));
+  QFile result(message->localPath());
+  QVERIFY(result.open(QIODevice::ReadOnly));
+  QVERIFY(result.readAll() == content);
+}
@@ -0,0 +1,22 @@
+#ifndef TST_FILETRANSFER_H
+#define TST_FILETRANSFER_H
+
+#include <QObject>
+
+/**
+ * @brief The FileTransferTest class streams files between two connections over loopback, through
+ * their real outbound queues.
+ */
+class FileTransferTest : public QObject {
+  Q_OBJECT
+
+private slots:
+  void initTestCase();
+  /**
+   * @brief multiChunkFile a file of several chunks arrives whole, DONE must not overtake the
+   * chunks still queued ahead of it.
+   */
+  void multiChunkFile();
+};
+
+#endif
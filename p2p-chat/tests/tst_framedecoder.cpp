@@ -0,0 +1,113 @@
+#include "tst_framedecoder.h"
+
+#include "Networking/connection.h"
+#include "Networking/framedecoder.h"
+#include "Networking/messageframes.h"
+#include <QBuffer>
+#include <QRandomGenerator>
+#include <QtTest>
+
+using namespace p2pnetworking;
+
+namespace {
+
+QByteArray randomBytes(int size) {
+  QByteArray bytes(size, Qt::Uninitialized);
+  for (int i = 0; i < size; ++i)
+    bytes[i] = char(QRandomGenerator::global()->generate());
+  return bytes;
+}
+
+// Decode everything buffered so far into payloads; false on a protocol error.
+bool drain(FrameDecoder &decoder, QList<QByteArray> *payloads) {
+  FrameDecoder::Status status;
+  while ((status = decoder.next()) == FrameDecoder::FrameReady) {
+    const QByteArray payload = decoder.payload();
+    payloads->append(QByteArray(payload.constData(), payload.size()));
+  }
+  return status != FrameDecoder::ProtocolError;
+}
+
+} // namespace
+
+void FrameDecoderTest::fragmentedStream() {
+  QList<QByteArray> sent;
+  QByteArray stream;
+  // empty, small, around a segment, and larger than one read
+  foreach (int size, QList<int>() << 0 << 1 << 17 << 1459 << 1460 << 70000 << MaxBufferSize + 1) {
+    sent << randomBytes(size);
+    stream += MessageFrames::frame("MESG", sent.last());
+  }
+
+  FrameDecoder decoder(MaxFrameSize, MaxBufferSize);
+  QList<QByteArray> received;
+  int offset = 0;
+  while (offset < stream.size()) {
+    // single bytes mixed with larger pieces, so cuts land inside tags, lengths and payloads
+    QRandomGenerator *random = QRandomGenerator::global();
+    const int piece = qMin(stream.size() - offset, random->bounded(2) ? 1 : random->bounded(1, 8192));
+    decoder.append(stream.constData() + offset, piece);
+    offset += piece;
+    QVERIFY(drain(decoder, &received));
+  }
+  QVERIFY(!decoder.hasPartialFrame());
+  QCOMPARE(received.size(), sent.size());
+  for (int i = 0; i < sent.size(); ++i)
+    QVERIFY(received.at(i) == sent.at(i));
+}
+
+void FrameDecoderTest::frameLargerThanOneRead() {
+  const QByteArray payload = randomBytes(3 * 1024 * 1024);
+  QByteArray stream = MessageFrames::frame("MESG", payload);
+  QBuffer device(&stream);
+  QVERIFY(device.open(QIODevice::ReadOnly));
+
+  FrameDecoder decoder(4 * 1024 * 1024, 64 * 1024);
+  QList<QByteArray> received;
+  int reads = 0;
+  while (device.bytesAvailable() > 0) {
+    QVERIFY(decoder.readFrom(&device) > 0);
+    ++reads;
+    QVERIFY(drain(decoder, &received));
+  }
+  QVERIFY(reads > 1);
+  QCOMPARE(received.size(), 1);
+  QVERIFY(received.first() == payload);
+
+  FrameDecoder strict(payload.size() - 1, 64 * 1024);
+  const QByteArray header = stream.left(32);
+  strict.append(header.constData(), header.size());
+  QCOMPARE(strict.next(), FrameDecoder::ProtocolError);
+}
+
+void FrameDecoderTest::throughput_data() {
+  QTest::addColumn<int>("frameSize");
+  QTest::addColumn<int>("segmentSize");
+  QTest::newRow("chat messages") << 200 << 1460;
+  QTest::newRow("file chunks") << 64 * 1024 << 1460;
+  QTest::newRow("file chunks, large reads") << 64 * 1024 << 64 * 1024;
+}
+
+void FrameDecoderTest::throughput() {
+  QFETCH(int, frameSize);
+  QFETCH(int, segmentSize);
+
+  const QByteArray frame = MessageFrames::frame("MESG", randomBytes(frameSize));
+  QByteArray stream;
+  while (stream.size() < 8 * 1024 * 1024)
+    stream += frame;
+  const int frames = stream.size() / frame.size();
+
+  FrameDecoder decoder(MaxFrameSize, MaxBufferSize);
+  int decoded = 0;
+  QBENCHMARK {
+    decoded = 0;
+    for (int offset = 0; offset < stream.size(); offset += segmentSize) {
+      decoder.append(stream.constData() + offset, qMin(segmentSize, stream.size() - offset));
+      while (decoder.next() == FrameDecoder::FrameReady)
+        ++decoded;
+    }
+  }
+  QCOMPARE(decoded, frames);
+  QVERIFY(!decoder.hasPartialFrame());
+}
@@ -0,0 +1,30 @@
+#ifndef TST_FRAMEDECODER_H
+#define TST_FRAMEDECODER_H
+
+#include <QObject>
+
+/**
+ * @brief The FrameDecoderTest class feeds the frame decoder a stream cut at arbitrary points, the
+ * way TCP delivers it.
+ */
+class FrameDecoderTest : public QObject {
+  Q_OBJECT
+
+private slots:
+  /**
+   * @brief fragmentedStream frames split across any number of appends decode whole and in order.
+   */
+  void fragmentedStream();
+  /**
+   * @brief frameLargerThanOneRead a frame larger than the read bound is assembled over several
+   * reads, and one larger than the frame limit is an error.
+   */
+  void frameLargerThanOneRead();
+  /**
+   * @brief throughput decoding a stream of message sized frames arriving in segment sized pieces.
+   */
+  void throughput_data();
+  void throughput();
+};
+
+#endif
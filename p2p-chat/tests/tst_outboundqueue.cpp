@@ -0,0 +1,89 @@
+#include "tst_outboundqueue.h"
+
+#include "Networking/framedecoder.h"
+#include "Networking/messageframes.h"
+#include "Networking/outboundqueue.h"
+#include <QtTest>
+
+using namespace p2pnetworking;
+
+namespace {
+
+const int PartSize = 16 * 1024;
+
+// Write up to size bytes from the queue, in pieces of a socket write.
+QByteArray write(OutboundQueue &queue, qint64 size) {
+  QByteArray written;
+  int sliceSize = 0;
+  const char *slice;
+  while (written.size() < size && (slice = queue.peek(4096, &sliceSize))) {
+    sliceSize = int(qMin<qint64>(sliceSize, size - written.size()));
+    written.append(slice, sliceSize);
+    queue.consume(sliceSize);
+  }
+  return written;
+}
+
+struct Frame {
+  FrameDecoder::FrameType type;
+  QByteArray payload;
+};
+
+QList<Frame> decode(const QByteArray &stream) {
+  FrameDecoder decoder(64 * 1024 * 1024, 1024 * 1024);
+  decoder.append(stream.constData(), stream.size());
+  QList<Frame> frames;
+  while (decoder.next() == FrameDecoder::FrameReady) {
+    const QByteArray payload = decoder.payload();
+    frames.append({decoder.type(), QByteArray(payload.constData(), payload.size())});
+  }
+  return frames;
+}
+
+} // namespace
+
+void OutboundQueueTest::wholeFrames() {
+  const QByteArray bulk = MessageFrames::frame("MESG", QByteArray(1024 * 1024, 'b'));
+  const QByteArray pong = MessageFrames::frame("PONG", "1");
+  OutboundQueue queue;
+  queue.enqueue(bulk, OutboundQueue::BulkLane);
+  QByteArray stream = write(queue, PartSize);
+  queue.enqueue(pong, OutboundQueue::ControlLane);
+  stream += write(queue, bulk.size() + pong.size());
+
+  QVERIFY(queue.isEmpty());
+  QVERIFY(stream == bulk + pong);
+}
+
+void OutboundQueueTest::parts() {
+  const QByteArray bulk = MessageFrames::frame("MESG", QByteArray(1024 * 1024, 'b'));
+  const QByteArray pong = MessageFrames::frame("PONG", "1");
+  OutboundQueue queue;
+  queue.setPartSize(PartSize);
+  queue.enqueue(bulk, OutboundQueue::BulkLane);
+  QByteArray stream = write(queue, 100);
+  queue.enqueue(pong, OutboundQueue::ControlLane);
+  stream += write(queue, 2 * bulk.size());
+  QVERIFY(queue.isEmpty());
+  QCOMPARE(queue.queuedBytes(), qint64(0));
+
+  const QList<Frame> frames = decode(stream);
+  QVERIFY(frames.size() > 2);
+  // the PONG follows the part that was on the wire when it was queued
+  QCOMPARE(frames.at(0).type, FrameDecoder::PartFrame);
+  QCOMPARE(frames.at(1).type, FrameDecoder::PongFrame);
+  QVERIFY(frames.at(1).payload == "1");
+
+  QByteArray reassembled;
+  for (int i = 0; i < frames.size(); ++i) {
+    if (i == 1)
+      continue;
+    const Frame &part = frames.at(i);
+    QCOMPARE(part.type, FrameDecoder::PartFrame);
+    QVERIFY(part.payload.size() <= PartSize + 1);
+    const bool last = i == frames.size() - 1;
+    QCOMPARE(part.payload.at(0), last ? OutboundQueue::LastPartFlag : OutboundQueue::MorePartsFlag);
+    reassembled += part.payload.mid(1);
+  }
+  QVERIFY(reassembled == bulk);
+}
@@ -0,0 +1,24 @@
+#ifndef TST_OUTBOUNDQUEUE_H
+#define TST_OUTBOUNDQUEUE_H
+
+#include <QObject>
+
+/**
+ * @brief The OutboundQueueTest class checks how long a control frame waits behind bulk data.
+ */
+class OutboundQueueTest : public QObject {
+  Q_OBJECT
+
+private slots:
+  /**
+   * @brief wholeFrames without a part size a control frame waits for the whole bulk frame.
+   */
+  void wholeFrames();
+  /**
+   * @brief parts with a part size a control frame waits for one part at most, and the parts
+   * reassemble into the original frame.
+   */
+  void parts();
+};
+
+#endif
@@ -0,0 +1,75 @@
+#include "tst_registry.h"
+
+#include "rendezvous/registry.h"
+#include <QtTest>
+
+using namespace p2prendezvous;
+
+namespace {
+
+const qint64 Ttl = 1000;
+
+QStringList messages(const QVector<const Registry::Entry *> &entries) {
+  QStringList list;
+  foreach (const Registry::Entry *entry, entries)
+    list << entry->message;
+  return list;
+}
+
+} // namespace
+
+void RegistryTest::refreshWakesNobody() {
+  Registry registry(Ttl);
+  QCOMPARE(registry.cursor(), quint64(0));
+  QVERIFY(registry.announce("alice", "alice|4000|10.0.0.1", 0));
+  const quint64 cursor = registry.cursor();
+  QVERIFY(cursor > 0);
+
+  QVERIFY(!registry.announce("alice", "alice|4000|10.0.0.1", 500));
+  QCOMPARE(registry.cursor(), cursor);
+  QVERIFY(registry.changedSince(cursor).isEmpty());
+
+  QVERIFY(registry.announce("bob", "alice|4000|10.0.0.1", 600));
+  QVERIFY(registry.cursor() > cursor);
+  const QVector<const Registry::Entry *> changed = registry.changedSince(cursor);
+  QCOMPARE(changed.size(), 1);
+  QCOMPARE(changed.first()->sender, QString("bob"));
+  QCOMPARE(registry.size(), 1);
+}
+
+void RegistryTest::changedSince() {
+  Registry registry(Ttl);
+  registry.announce("a", "a|1|10.0.0.1", 0);
+  const quint64 first = registry.cursor();
+  registry.announce("b", "b|1|10.0.0.2", 0);
+  registry.announce("c", "c|1|10.0.0.3", 0);
+
+  QCOMPARE(messages(registry.changedSince(0)),
+           QStringList() << "a|1|10.0.0.1" << "b|1|10.0.0.2" << "c|1|10.0.0.3");
+  QCOMPARE(messages(registry.changedSince(first)),
+           QStringList() << "b|1|10.0.0.2" << "c|1|10.0.0.3");
+
+  // a change moves the announcement behind the others
+  registry.announce("a2", "a|1|10.0.0.1", 0);
+  QCOMPARE(messages(registry.changedSince(first)),
+           QStringList() << "b|1|10.0.0.2" << "c|1|10.0.0.3" << "a|1|10.0.0.1");
+  QVERIFY(registry.changedSince(registry.cursor()).isEmpty());
+}
+
+void RegistryTest::expiry() {
+  Registry registry(Ttl);
+  registry.announce("a", "a|1|10.0.0.1", 0);
+  registry.announce("b", "b|1|10.0.0.2", 0);
+  registry.announce("a", "a|1|10.0.0.1", 900);
+
+  QCOMPARE(registry.expire(Ttl - 1), 0);
+  QCOMPARE(registry.expire(Ttl), 1);
+  QVERIFY(registry.contains("a|1|10.0.0.1"));
+  QVERIFY(!registry.contains("b|1|10.0.0.2"));
+  QCOMPARE(messages(registry.changedSince(0)), QStringList() << "a|1|10.0.0.1");
+
+  QCOMPARE(registry.expire(900 + Ttl - 1), 0);
+  QCOMPARE(registry.expire(900 + Ttl), 1);
+  QCOMPARE(registry.size(), 0);
+  QVERIFY(registry.changedSince(0).isEmpty());
+}
@@ -0,0 +1,30 @@
+#ifndef TST_REGISTRY_H
+#define TST_REGISTRY_H
+
+#include <QObject>
+
+/**
+ * @brief The RegistryTest class checks the rendezvous server's registry of announcements: which
+ * announcements take a new cursor, and when they expire.
+ */
+class RegistryTest : public QObject {
+  Q_OBJECT
+
+private slots:
+  /**
+   * @brief refreshWakesNobody a refresh keeps the cursor, a new sender moves the announcement to
+   * a new one.
+   */
+  void refreshWakesNobody();
+  /**
+   * @brief changedSince the changes after a cursor come oldest first, without the older ones.
+   */
+  void changedSince();
+  /**
+   * @brief expiry an announcement lives for the ttl after its last refresh, and leaves no change
+   * behind when it expires.
+   */
+  void expiry();
+};
+
+#endif
@@ -0,0 +1,76 @@
+#include "tst_relay.h"
+
+#include "Networking/framedecoder.h"
+#include "Networking/messageframes.h"
+#include "Networking/relay.h"
+#include <QtTest>
+
+using namespace p2pnetworking;
+
+namespace {
+
+// The payload of the one frame in a stream.
+QByteArray payloadOf(const QByteArray &frame, FrameDecoder::FrameType type) {
+  FrameDecoder decoder(1024 * 1024, 1024 * 1024);
+  decoder.append(frame.constData(), frame.size());
+  if (decoder.next() != FrameDecoder::FrameReady || decoder.type() != type)
+    return QByteArray();
+  const QByteArray payload = decoder.payload();
+  return QByteArray(payload.constData(), payload.size());
+}
+
+} // namespace
+
+// The seen set is shared by the whole process, every case uses ids of its own.
+
+void RelayTest::firstSighting() {
+  const QByteArray id = Relay::newId();
+  QCOMPARE(id.size(), 32);
+  QVERIFY(Relay::firstSighting(id));
+  QVERIFY(!Relay::firstSighting(id));
+  QVERIFY(!Relay::firstSighting(id));
+  QVERIFY(Relay::firstSighting(Relay::newId()));
+}
+
+void RelayTest::seenCapacity() {
+  const QByteArray id = Relay::newId();
+  QVERIFY(Relay::firstSighting(id));
+  for (int i = 1; i < Relay::SeenCapacity; ++i)
+    QVERIFY(Relay::firstSighting(Relay::newId()));
+  QVERIFY(!Relay::firstSighting(id));
+
+  for (int i = 0; i < 2 * Relay::SeenCapacity; ++i)
+    Relay::firstSighting(Relay::newId());
+  QVERIFY(Relay::firstSighting(id));
+}
+
+void RelayTest::frames() {
+  const QByteArray id = Relay::newId();
+  const QByteArray inner = MessageFrames::frame("MESG", "0|hello|with|separators");
+  const QByteArray relayed = Relay::frame(id, QByteArray(), inner);
+
+  QByteArray parsedId, origin, parsedInner;
+  QVERIFY(Relay::parse(payloadOf(relayed, FrameDecoder::RelayFrame), &parsedId, &origin,
+                       &parsedInner));
+  QVERIFY(parsedId == id);
+  QVERIFY(origin.isEmpty());
+  QVERIFY(parsedInner == inner);
+
+  const QByteArray named = Relay::withOrigin(relayed, "alice@10.0.0.1");
+  QVERIFY(Relay::parse(payloadOf(named, FrameDecoder::RelayFrame), &parsedId, &origin,
+                       &parsedInner));
+  QVERIFY(parsedId == id);
+  QVERIFY(origin == "alice@10.0.0.1");
+  QVERIFY(parsedInner == inner);
+
+  QVERIFY(!Relay::parse("too short", &parsedId, &origin, &parsedInner));
+  QVERIFY(!Relay::parse(id + "|no second separator", &parsedId, &origin, &parsedInner));
+  QVERIFY(Relay::withOrigin("RELY|3|bad", "alice") == "RELY|3|bad");
+
+  // a presence announcement is a RELY frame around an empty HERE frame, already marked seen
+  const QByteArray presence = Relay::presenceFrame();
+  QVERIFY(Relay::parse(payloadOf(presence, FrameDecoder::RelayFrame), &parsedId, &origin,
+                       &parsedInner));
+  QVERIFY(!Relay::firstSighting(parsedId));
+  QVERIFY(parsedInner == MessageFrames::frame("HERE", QByteArray()));
+}
@@ -0,0 +1,29 @@
+#ifndef TST_RELAY_H
+#define TST_RELAY_H
+
+#include <QObject>
+
+/**
+ * @brief The RelayTest class checks the relay overlay's frames and the set of message ids it has
+ * seen, which makes every node deliver and forward a message once.
+ */
+class RelayTest : public QObject {
+  Q_OBJECT
+
+private slots:
+  /**
+   * @brief firstSighting an id is new once, then a duplicate.
+   */
+  void firstSighting();
+  /**
+   * @brief seenCapacity an id is remembered for at least SeenCapacity later ids, and forgotten
+   * after two generations of them.
+   */
+  void seenCapacity();
+  /**
+   * @brief frames a RELY frame parses back into its parts, and withOrigin() only changes the origin.
+   */
+  void frames();
+};
+
+#endif
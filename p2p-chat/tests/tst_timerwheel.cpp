@@ -0,0 +1,144 @@
+#include "tst_timerwheel.h"
+
+#include "Networking/timerwheel.h"
+#include <QElapsedTimer>
+#include <QHash>
+#include <QTimerEvent>
+#include <QtTest>
+#include <memory>
+#include <vector>
+
+using namespace p2pnetworking;
+
+namespace {
+
+const int TimerCount = 500;
+const int RunTime = 3000;
+// the scheduling slack of a loaded machine on top of the promised lateness
+const int Slack = 100;
+
+// periods of 200 ms to 1.2 s, spread so expiries rarely coincide
+int periodFor(int timer) {
+  return 200 + timer * 37 % 1000;
+}
+
+/**
+ * @brief The QtTimers class periodic timers the way connections ran them before the wheel, a Qt
+ * timer each.
+ */
+class QtTimers : public QObject {
+public:
+  int wakeups = 0;
+  qint64 maxLateness = 0;
+
+  void start() {
+    clock.start();
+    for (int i = 0; i < TimerCount; ++i) {
+      timers.insert(startTimer(periodFor(i)), i);
+      due << periodFor(i);
+    }
+  }
+
+  void stop() {
+    foreach (int id, timers.keys())
+      killTimer(id);
+    timers.clear();
+  }
+
+protected:
+  void timerEvent(QTimerEvent *event) override {
+    ++wakeups;
+    const int timer = timers.value(event->timerId(), -1);
+    if (timer < 0)
+      return;
+    maxLateness = qMax(maxLateness, clock.elapsed() - due[timer]);
+    due[timer] = clock.elapsed() + periodFor(timer);
+  }
+
+private:
+  QElapsedTimer clock;
+  QHash<int, int> timers; /**< timer id to timer */
+  QVector<qint64> due;
+};
+
+/**
+ * @brief The WakeupCounter class counts the timer events delivered to the object it filters.
+ */
+class WakeupCounter : public QObject {
+public:
+  int wakeups = 0;
+
+protected:
+  bool eventFilter(QObject *, QEvent *event) override {
+    if (event->type() == QEvent::Timer)
+      ++wakeups;
+    return false;
+  }
+};
+
+} // namespace
+
+void TimerWheelTest::rearm_data() {
+  QTest::addColumn<bool>("wheel");
+  QTest::newRow("Qt timer") << false;
+  QTest::newRow("timer wheel") << true;
+}
+
+void TimerWheelTest::rearm() {
+  QFETCH(bool, wheel);
+
+  if (wheel) {
+    WheelTimer timer([]() {});
+    QBENCHMARK {
+      for (int i = 0; i < 1000; ++i)
+        timer.start(30 * 1000);
+    }
+    timer.stop();
+  } else {
+    QObject target;
+    int id = 0;
+    QBENCHMARK {
+      for (int i = 0; i < 1000; ++i) {
+        if (id)
+          target.killTimer(id);
+        id = target.startTimer(30 * 1000);
+      }
+    }
+    target.killTimer(id);
+  }
+}
+
+void TimerWheelTest::wakeups() {
+  QtTimers qt;
+  qt.start();
+  QTest::qWait(RunTime);
+  qt.stop();
+
+  WakeupCounter counter;
+  TimerWheel::forCurrentThread()->installEventFilter(&counter);
+  QElapsedTimer clock;
+  clock.start();
+  qint64 maxLateness = 0;
+  std::vector<std::unique_ptr<WheelTimer>> timers;
+  std::vector<qint64> due;
+  for (int i = 0; i < TimerCount; ++i) {
+    due.push_back(periodFor(i));
+    timers.emplace_back(new WheelTimer([&, i]() {
+      maxLateness = qMax(maxLateness, clock.elapsed() - due[i]);
+      due[i] = clock.elapsed() + periodFor(i);
+      timers[i]->start(periodFor(i));
+    }));
+    timers.back()->start(periodFor(i));
+  }
+  QTest::qWait(RunTime);
+  timers.clear();
+  TimerWheel::forCurrentThread()->removeEventFilter(&counter);
+
+  qInfo("%d periodic timers for %d ms: %d wakeups with a Qt timer each, %d with the wheel",
+        TimerCount, RunTime, qt.wakeups, counter.wakeups);
+  qInfo("latest expiry: %lld ms with Qt timers, %lld ms with the wheel (resolution %d ms)",
+        qt.maxLateness, maxLateness, TimerWheel::Resolution);
+  QVERIFY(counter.wakeups > 0);
+  QVERIFY(counter.wakeups < qt.wakeups);
+  QVERIFY(maxLateness <= TimerWheel::Resolution + Slack);
+}
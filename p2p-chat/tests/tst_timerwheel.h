@@ -0,0 +1,27 @@
+#ifndef TST_TIMERWHEEL_H
+#define TST_TIMERWHEEL_H
+
+#include <QObject>
+
+/**
+ * @brief The TimerWheelTest class compares connection timeouts on the shared timer wheel with the
+ * Qt timer per connection they replaced.
+ */
+class TimerWheelTest : public QObject {
+  Q_OBJECT
+
+private slots:
+  /**
+   * @brief rearm the cost of re-arming a timeout, as done on every read that leaves a partial frame.
+   */
+  void rearm_data();
+  void rearm();
+  /**
+   * @brief wakeups event loop wakeups and expiry latency of many periodic timers, like the ping
+   * timers of a busy node. Reports both and checks that the wheel wakes less, and fires no later
+   * than its resolution promises.
+   */
+  void wakeups();
+};
+
+#endif